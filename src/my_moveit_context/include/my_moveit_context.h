@@ -24,8 +24,28 @@ class MyMoveitContext {
   MyMoveitContext(const planning_scene_monitor::PlanningSceneMonitorPtr& psm,
                   const moveit::core::RobotModelPtr& robot_model);
 
+  /** \brief Create a context that plans in a plain planning scene, without a
+    monitor and without a node handle. Planner configurations are not read
+    from the parameter server in this mode; the context uses the default
+    configuration for planner_id_, which is then usually replaced through
+    changePlanner anyway. Constraint approximations are not loaded.
+    @param scene The planning scene to plan in. The caller is responsible for
+    not modifying it while a context is being created.
+    @param robot_model The model of the robot in the scene.
+  */
+  MyMoveitContext(const planning_scene::PlanningScenePtr& scene,
+                  const moveit::core::RobotModelPtr& robot_model);
+
   void createPlanningContext(const moveit_msgs::MotionPlanRequest& req);
 
+  /** \brief Point the existing planning context at a new request and the
+    current scene, keeping its state space and simple setup. Creates the
+    context if there is none yet.
+    @param req The request with the new start state and goal constraints.
+    @return false if the request could not be applied.
+  */
+  bool updatePlanningContext(const moveit_msgs::MotionPlanRequest& req);
+
   ompl_interface::ModelBasedPlanningContextPtr getPlanningContext();
 
   /** \brief Get the planner that is set into the context at class
@@ -40,7 +60,11 @@ class MyMoveitContext {
   void setSimplifySolution(bool simplify_solution);
 
  private:
-  ros::NodeHandle nh_;
+  /** \brief Only created when planning through a planning scene monitor.*/
+  std::shared_ptr<ros::NodeHandle> nh_;
+
+  /** \brief The scene used when there is no planning scene monitor.*/
+  planning_scene::PlanningScenePtr scene_;
 
   /** \brief Default robot being used.*/
   const std::string group_name_ = "panda_arm";
@@ -59,12 +83,37 @@ class MyMoveitContext {
   void setPlanningContextParams(
       ompl_interface::ModelBasedPlanningContextPtr& context);
 
+  /** \brief Set the scene, start state and constraints of the request on
+   * context_ and configure it. Resets context_ on failure.*/
+  void bindRequest(const moveit_msgs::MotionPlanRequest& req,
+                   const planning_scene::PlanningSceneConstPtr& lscene);
+
   std::unique_ptr<ompl_interface::OMPLInterface> getOMPLInterface(
       const moveit::core::RobotModelConstPtr& model, const ros::NodeHandle& nh);
 
   planning_interface::PlannerConfigurationSettings getPlannerConfigSettings(
       const planning_interface::PlannerConfigurationMap& pconfig_map,
       const std::string& planner_id);
+
+  /** \brief The planner configuration used when there is no parameter server
+   * to read ompl_planning.yaml from.*/
+  planning_interface::PlannerConfigurationSettings getDefaultConfigSettings(
+      const std::string& planner_id);
+};
+
+/** \brief A planning context that can be configured without a node handle.
+ * ModelBasedPlanningContext::configure takes a node handle only to look up the
+ * constraint approximations, so this repeats the remaining steps of the
+ * configuration.*/
+class StandalonePlanningContext
+    : public ompl_interface::ModelBasedPlanningContext {
+ public:
+  StandalonePlanningContext(
+      const std::string& name,
+      const ompl_interface::ModelBasedPlanningContextSpecification& spec)
+      : ompl_interface::ModelBasedPlanningContext(name, spec) {}
+
+  void configureStandalone();
 };
 
 #endif
\ No newline at end of file
@@ -1,15 +1,31 @@
 #include "my_moveit_context.h"
 
+#include <moveit/ompl_interface/detail/state_validity_checker.h>
+
 constexpr char LOGNAME[] = "my_moveit_context";
 
 MyMoveitContext::MyMoveitContext(
     const planning_scene_monitor::PlanningSceneMonitorPtr& psm,
     const moveit::core::RobotModelPtr& robot_model)
-    : psm_(psm), robot_model_(robot_model) {}
+    : nh_(std::make_shared<ros::NodeHandle>()),
+      psm_(psm),
+      robot_model_(robot_model) {}
+
+MyMoveitContext::MyMoveitContext(
+    const planning_scene::PlanningScenePtr& scene,
+    const moveit::core::RobotModelPtr& robot_model)
+    : scene_(scene), robot_model_(robot_model) {}
 
 void MyMoveitContext::createPlanningContext(
     const moveit_msgs::MotionPlanRequest& req) {
-  planning_scene_monitor::LockedPlanningSceneRO lscene(psm_);
+  // the monitor's read lock is held for the whole set up, same as before
+  std::unique_ptr<planning_scene_monitor::LockedPlanningSceneRO> monitor_lock;
+  planning_scene::PlanningSceneConstPtr lscene = scene_;
+  if (psm_) {
+    monitor_lock =
+        std::make_unique<planning_scene_monitor::LockedPlanningSceneRO>(psm_);
+    lscene = *monitor_lock;
+  }
 
   ompl_interface::ModelBasedStateSpaceSpecification space_spec(robot_model_,
                                                                group_name_);
@@ -17,35 +33,77 @@ void MyMoveitContext::createPlanningContext(
       std::make_shared<ompl_interface::JointModelStateSpace>(space_spec);
   state_space->computeLocations();
 
-  std::unique_ptr<ompl_interface::OMPLInterface> ompl_interface =
-      getOMPLInterface(robot_model_, nh_);
+  constraint_samplers::ConstraintSamplerManagerPtr csm =
+      std::make_shared<constraint_samplers::ConstraintSamplerManager>();
+
+  ompl_interface::ModelBasedPlanningContextSpecification context_spec;
+  if (nh_) {
+    std::unique_ptr<ompl_interface::OMPLInterface> ompl_interface =
+        getOMPLInterface(robot_model_, *nh_);
 
-  planning_interface::PlannerConfigurationMap pconfig_map =
-      ompl_interface->getPlannerConfigurations();
+    planning_interface::PlannerConfigurationMap pconfig_map =
+        ompl_interface->getPlannerConfigurations();
 
-  planning_interface::PlannerConfigurationSettings pconfig_settings =
-      getPlannerConfigSettings(pconfig_map, planner_id_);
+    planning_interface::PlannerConfigurationSettings pconfig_settings =
+        getPlannerConfigSettings(pconfig_map, planner_id_);
 
-  ompl_interface::PlanningContextManager planning_context_manager =
-      ompl_interface->getPlanningContextManager();
+    ompl_interface::PlanningContextManager planning_context_manager =
+        ompl_interface->getPlanningContextManager();
 
-  ompl_interface::ModelBasedPlanningContextSpecification context_spec;
-  context_spec.config_ = pconfig_settings.config;
-  context_spec.planner_selector_ =
-      planning_context_manager.getPlannerSelector();
-  context_spec.constraint_sampler_manager_ =
-      std::make_shared<constraint_samplers::ConstraintSamplerManager>();
+    context_spec.config_ = pconfig_settings.config;
+    context_spec.planner_selector_ =
+        planning_context_manager.getPlannerSelector();
+  } else {
+    ompl_interface::PlanningContextManager planning_context_manager(
+        robot_model_, csm);
+    context_spec.config_ = getDefaultConfigSettings(planner_id_).config;
+    context_spec.planner_selector_ =
+        planning_context_manager.getPlannerSelector();
+  }
+  context_spec.constraint_sampler_manager_ = csm;
   context_spec.state_space_ = state_space;
 
   ompl::geometric::SimpleSetupPtr ompl_simple_setup =
       std::make_shared<ompl::geometric::SimpleSetup>(state_space);
   context_spec.ompl_simple_setup_ = ompl_simple_setup;
 
-  context_ = std::make_shared<ompl_interface::ModelBasedPlanningContext>(
-      group_name_, context_spec);
+  std::shared_ptr<StandalonePlanningContext> standalone_context;
+  if (nh_) {
+    context_ = std::make_shared<ompl_interface::ModelBasedPlanningContext>(
+        group_name_, context_spec);
+  } else {
+    standalone_context =
+        std::make_shared<StandalonePlanningContext>(group_name_, context_spec);
+    context_ = standalone_context;
+  }
 
   setPlanningContextParams(context_);
+  bindRequest(req, lscene);
+}
 
+bool MyMoveitContext::updatePlanningContext(
+    const moveit_msgs::MotionPlanRequest& req) {
+  if (!context_) {
+    createPlanningContext(req);
+    return static_cast<bool>(context_);
+  }
+
+  std::unique_ptr<planning_scene_monitor::LockedPlanningSceneRO> monitor_lock;
+  planning_scene::PlanningSceneConstPtr lscene = scene_;
+  if (psm_) {
+    monitor_lock =
+        std::make_unique<planning_scene_monitor::LockedPlanningSceneRO>(psm_);
+    lscene = *monitor_lock;
+  }
+
+  context_->clear();
+  bindRequest(req, lscene);
+  return static_cast<bool>(context_);
+}
+
+void MyMoveitContext::bindRequest(
+    const moveit_msgs::MotionPlanRequest& req,
+    const planning_scene::PlanningSceneConstPtr& lscene) {
   moveit::core::RobotStatePtr start_state =
       lscene->getCurrentStateUpdated(req.start_state);
 
@@ -59,6 +117,7 @@ void MyMoveitContext::createPlanningContext(
     ROS_ERROR_NAMED(LOGNAME, "context_->setPathConstraints() error: %d",
                     error_code.val);
     context_ = ompl_interface::ModelBasedPlanningContextPtr();
+    return;
   }
 
   if (!context_->setGoalConstraints(req.goal_constraints, req.path_constraints,
@@ -66,11 +125,18 @@ void MyMoveitContext::createPlanningContext(
     ROS_ERROR_NAMED(LOGNAME, "context_->setGoalConstraints() error %d",
                     error_code.val);
     context_ = ompl_interface::ModelBasedPlanningContextPtr();
+    return;
   }
 
+  std::shared_ptr<StandalonePlanningContext> standalone_context =
+      std::dynamic_pointer_cast<StandalonePlanningContext>(context_);
   bool use_constraints_approximation = true;
   try {
-    context_->configure(nh_, use_constraints_approximation);
+    if (standalone_context) {
+      standalone_context->configureStandalone();
+    } else {
+      context_->configure(*nh_, use_constraints_approximation);
+    }
     ROS_INFO_NAMED(LOGNAME, "%s: New planning context_ is set.",
                    context_->getName().c_str());
     error_code.val = moveit_msgs::MoveItErrorCodes::SUCCESS;
@@ -139,4 +205,44 @@ MyMoveitContext::getPlannerConfigSettings(
   return pc->second;
 }
 
+planning_interface::PlannerConfigurationSettings
+MyMoveitContext::getDefaultConfigSettings(const std::string& planner_id) {
+  // planner ids have the form group[planner], e.g. panda_arm[RRTConnect]
+  std::string planner = "RRTConnect";
+  std::size_t open = planner_id.find('[');
+  std::size_t close = planner_id.find(']');
+  if (open != std::string::npos && close != std::string::npos &&
+      close > open + 1) {
+    planner = planner_id.substr(open + 1, close - open - 1);
+  }
+
+  planning_interface::PlannerConfigurationSettings pconfig_settings;
+  pconfig_settings.name = planner_id;
+  pconfig_settings.group = group_name_;
+  pconfig_settings.config["type"] = "geometric::" + planner;
+  ROS_INFO_NAMED(LOGNAME, "Using default configuration for planner %s.",
+                 planner_id.c_str());
+  return pconfig_settings;
+}
+
 std::string MyMoveitContext::getPlannerId() { return planner_id_; }
+
+void StandalonePlanningContext::configureStandalone() {
+  setConstraintsApproximations(ompl_interface::ConstraintsLibraryPtr());
+  complete_initial_robot_state_.update();
+  ompl_simple_setup_->getStateSpace()->setStateSamplerAllocator(
+      std::bind(&StandalonePlanningContext::allocPathConstrainedSampler, this,
+                std::placeholders::_1));
+
+  ompl::base::ScopedState<> ompl_start_state(spec_.state_space_);
+  spec_.state_space_->copyToOMPLState(ompl_start_state.get(),
+                                      getCompleteInitialRobotState());
+  ompl_simple_setup_->setStartState(ompl_start_state);
+  ompl_simple_setup_->setStateValidityChecker(
+      std::make_shared<ompl_interface::StateValidityChecker>(this));
+
+  useConfig();
+  if (ompl_simple_setup_->getGoal()) {
+    ompl_simple_setup_->setup();
+  }
+}
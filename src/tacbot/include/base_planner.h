@@ -9,7 +9,9 @@
 #include <math.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -37,6 +39,10 @@
 #include <Eigen/Dense>
 
 // Local libraries, helper functions, and utilities
+#include "contact_path_shortcutter.h"
+#include "joint_trajectory_spline.h"
+#include "manipulability_sampler.h"
+#include "planning_scene_handle.h"
 #include "utilities.h"
 #include "visualizer_data.h"
 
@@ -50,6 +56,17 @@ class BasePlanner {
    * subscribers.*/
   virtual void init();
 
+  /** \brief Initialize the planner without any ROS communication. The robot
+    model is built from the given files and the planner holds a plain
+    PlanningScene instead of a PlanningSceneMonitor, so no parameter server,
+    topics or services are needed. Only ros::Time::init() is called so that
+    message time stamps can be filled in.
+    @param urdf_path Path to the robot's URDF, already expanded from xacro.
+    @param srdf_path Path to the robot's SRDF.
+  */
+  virtual void init(const std::string& urdf_path,
+                    const std::string& srdf_path);
+
   /** \brief Set the start state in the request message to the current state of
     the robot.
     @param req The motion planning request.
@@ -76,6 +93,33 @@ class BasePlanner {
 
   virtual bool parameterizePlan(planning_interface::MotionPlanResponse& res);
 
+  /** \brief Replace the densely sampled, time parameterized trajectory of the
+     response by the waypoints that are needed to reproduce it with cubic
+     Hermite segments, see JointTrajectorySpline::selectKnots. The trajectory
+     that is published, visualized and executed then only holds these knots.
+     Must be called after parameterizePlan.
+      @param res The motion planning response holding the parameterized
+     trajectory.
+      @param position_tolerance Largest joint position error, in rad.
+      @param velocity_tolerance Largest joint velocity error, in rad/s.
+      @return bool Whether or not there was a trajectory to compress.
+  */
+  virtual bool compressPlan(planning_interface::MotionPlanResponse& res,
+                            double position_tolerance = 1e-3,
+                            double velocity_tolerance = 1e-2);
+
+  /** \brief Shortcut the solution path of the last plan by objective cost and
+     write the result back into the response. Uses the planner's optimization
+     objective when one has been set, so that shortcuts that increase contact
+     are rejected, and falls back to the context's objective otherwise. Must be
+     called after generatePlan and before parameterizePlan.
+      @param res The motion planning response holding the solved trajectory.
+      @param time_budget Time in seconds that may be spent shortcutting.
+      @return bool Whether or not there was a solution path to shortcut.
+  */
+  virtual bool shortcutPlan(planning_interface::MotionPlanResponse& res,
+                            double time_budget = 1.0);
+
   /** \brief Create a sample joint goal state, in joint space, for the robot to
     reach.
       @return moveit_msgs::Constraints The goal state and restrictions as
@@ -102,10 +146,17 @@ class BasePlanner {
     context_ = context;
   }
 
+  /** \brief Getter for the planning scene monitor. Null when the planner was
+    initialized without ROS.*/
   planning_scene_monitor::PlanningSceneMonitorPtr getPlanningSceneMonitor() {
     return psm_;
   }
 
+  /** \brief Getter for the planning scene, with or without a monitor.*/
+  planning_scene::PlanningScenePtr getPlanningScene() {
+    return scene_handle_.getPlanningScene();
+  }
+
   std::vector<std::string> getJointNames() {
     return joint_model_group_->getActiveJointModelNames();
   }
@@ -135,8 +186,58 @@ class BasePlanner {
 
   bool calculateEEPath();
 
+  /** \brief Whether field and contact cost queries may be interpolated from a
+   * FieldGridCache instead of always being evaluated exactly.*/
+  void setUseFieldGrid(bool use_field_grid) { use_field_grid_ = use_field_grid; }
+
+  /** \brief Whether uniform samples are biased away from singular
+   * configurations by a ManipulabilitySampler. Off by default, since it
+   * replaces the sampler of the planning context for every planner. Takes
+   * effect from the next changePlanner().*/
+  void setUseManipulabilitySampler(bool use_manip_sampler) {
+    use_manip_sampler_ = use_manip_sampler;
+  }
+
+  void setManipulabilitySamplerOptions(
+      const ManipulabilitySampler::Options& options) {
+    manip_sampler_options_ = options;
+  }
+
  protected:
-  ros::NodeHandle nh_;
+  /** \brief Whether the cost functions bound by changePlanner can be called
+   * from several threads at once. Planners whose costs write to shared state,
+   * such as the visualization data, should return false.*/
+  virtual bool isCostThreadSafe() const { return true; }
+
+  /** \brief The set up that is shared by the ROS and the file based
+   * initialization, once the robot model and the planning scene exist.*/
+  void initCommon();
+
+  /** \brief Add or update a collision object in the planning scene directly.
+   * Used when there is no monitor that collision objects could be published
+   * to.*/
+  void addCollisionObject(const moveit_msgs::CollisionObject& collision_object);
+
+  /** \brief Install the manipulability biased sampler on the state space of
+   * the simple setup, or restore the default sampler if it is disabled. A
+   * request with path constraints keeps the sampler of the planning
+   * context.*/
+  void setStateSampler(const ompl::geometric::SimpleSetupPtr& simple_setup);
+
+  /** \brief Incremented whenever the obstacles or the allowed collisions of
+   * the planning scene change, so that cached field values can be dropped.
+   * Read by the planner threads while the scene is changed from others.*/
+  std::atomic<std::size_t> scene_version_{0};
+
+  /** \brief Off by default, the grid only pays off once most queries land in
+   * cells whose vertices have already been evaluated.*/
+  bool use_field_grid_ = false;
+
+  bool use_manip_sampler_ = false;
+
+  /** \brief The state space the manipulability sampler is installed on.*/
+  std::weak_ptr<ompl::base::StateSpace> manip_sampler_space_;
+  ManipulabilitySampler::Options manip_sampler_options_;
 
   /** \brief Default robot being used.*/
   const std::string group_name_ = "panda_arm";
@@ -163,6 +264,7 @@ class BasePlanner {
   const moveit::core::JointModelGroup* joint_model_group_;
   robot_model_loader::RobotModelLoaderPtr robot_model_loader_;
   planning_scene_monitor::PlanningSceneMonitorPtr psm_;
+  PlanningSceneHandle scene_handle_;
   moveit::core::RobotModelPtr robot_model_;
   kinematics_metrics::KinematicsMetricsPtr kinematics_metrics_;
   moveit::core::RobotStatePtr robot_state_;
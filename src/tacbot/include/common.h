@@ -48,6 +48,17 @@ class MotionGenerator {
   franka::JointPositions operator()(const franka::RobotState& robot_state,
                                     franka::Duration period);
 
+  /**
+   * @return Maximum joint velocities, scaled by the speed factor.
+   */
+  std::array<double, 7> getMaxVelocity() const;
+
+  /**
+   * @return Maximum joint accelerations, the smaller of the start and goal
+   * limits, scaled by the speed factor.
+   */
+  std::array<double, 7> getMaxAcceleration() const;
+
  private:
   using Vector7d = Eigen::Matrix<double, 7, 1, Eigen::ColMajor>;
   using Vector7i = Eigen::Matrix<int, 7, 1, Eigen::ColMajor>;
@@ -0,0 +1,135 @@
+#ifndef TACBOT_CONTACT_DETECTOR_H
+#define TACBOT_CONTACT_DETECTOR_H
+
+// C++
+#include <array>
+#include <cstddef>
+
+// Franka
+#include <franka/model.h>
+#include <franka/robot_state.h>
+
+namespace tacbot {
+
+/** \class Detects contacts from inside the control loop with a generalized
+ * momentum observer. The observer compares the change of the robot's
+ * momentum M(q) dq with the measured joint torques and the torques predicted
+ * by the franka::Model, and its residual converges to the external joint
+ * torques with the bandwidth of the observer gain. Unlike the raw measured
+ * torques, the residual does not depend on the pose or the speed of the
+ * robot, so per-joint thresholds can be much lower.
+ *
+ * An external force on a link only causes torques on the joints between the
+ * base and that link, so the contact is put on the link after the most distal
+ * joint whose residual is above its threshold.
+ */
+class ContactDetector {
+ public:
+  struct Options {
+    /** \brief Observer gain, in 1/s. Higher gains track the external torques
+     * faster, but let through more sensor noise.*/
+    double gain = 50.0;
+
+    /** \brief Residual above which a joint counts as loaded, in Nm.*/
+    std::array<double, 7> thresholds{{12.0, 12.0, 10.0, 10.0, 6.0, 6.0, 4.0}};
+
+    /** \brief Consecutive cycles a residual has to stay above its threshold,
+     * to reject single noisy samples.*/
+    std::size_t min_cycles = 3;
+  };
+
+  struct Contact {
+    bool detected = false;
+
+    /** \brief Index of the link, 0 for the link moved by the first joint.*/
+    std::size_t link = 0;
+
+    /** \brief Estimated location of the contact in the base frame, the middle
+     * of the link.*/
+    std::array<double, 3> point{};
+
+    std::array<double, 7> residual{};
+  };
+
+  ContactDetector() = default;
+  explicit ContactDetector(const Options& options) : options_(options) {}
+
+  void setOptions(const Options& options) { options_ = options; }
+  const Options& getOptions() const { return options_; }
+
+  /** \brief Forget the contact and restart the observer on the next
+   * update.*/
+  void reset();
+
+  /** \brief Forget the contact, but keep the observer running.*/
+  void clearContact() {
+    cycles_above_.fill(0);
+    contact_ = Contact();
+  }
+
+  /** \brief Advance the observer by one control cycle. Does not allocate, so
+    it can be called from the control callback. The first call after a reset,
+    or with a period of zero, only initializes the observer.
+    @param period The period of the cycle, in seconds.
+    @return Whether a contact has been detected, now or since the last reset.
+  */
+  bool update(const franka::RobotState& robot_state,
+              const franka::Model& model, double period);
+
+  /** \brief Advance the observer with dynamics the caller has computed, for
+    callers without a franka::Model, e.g. a ros_control controller that holds
+    a franka_hw::FrankaModelHandle. Otherwise as the update above.
+    @param mass The mass matrix, column major.
+    @param pose Called with a franka::Frame when a contact is detected, to
+    locate it. Returns the pose of the frame, column major.
+  */
+  template <typename PoseFunction>
+  bool update(const franka::RobotState& robot_state,
+              const std::array<double, 49>& mass,
+              const std::array<double, 7>& coriolis,
+              const std::array<double, 7>& gravity, double period,
+              const PoseFunction& pose) {
+    int link = updateObserver(robot_state, mass, coriolis, gravity, period);
+    if (link >= 0) {
+      locateContact(static_cast<std::size_t>(link),
+                    pose(static_cast<franka::Frame>(link)),
+                    pose(static_cast<franka::Frame>(link + 1)));
+    }
+    return contact_.detected;
+  }
+
+  const Contact& getContact() const { return contact_; }
+  const std::array<double, 7>& getResidual() const { return residual_; }
+
+ private:
+  /** \brief The generalized momentum M(q) dq.*/
+  static std::array<double, 7> momentum(const std::array<double, 49>& mass,
+                                        const std::array<double, 7>& dq);
+
+  /** \brief Advance the residual by one cycle.
+    @return The link of a contact detected in this cycle, -1 if there is
+    none.
+  */
+  int updateObserver(const franka::RobotState& robot_state,
+                     const std::array<double, 49>& mass,
+                     const std::array<double, 7>& coriolis,
+                     const std::array<double, 7>& gravity, double period);
+
+  /** \brief Record a contact on the link, which lies between the frames at
+   * start and end.*/
+  void locateContact(std::size_t link, const std::array<double, 16>& start,
+                     const std::array<double, 16>& end);
+
+  Options options_;
+  bool initialized_ = false;
+
+  std::array<double, 49> last_mass_{};
+  std::array<double, 7> integral_{};
+  std::array<double, 7> residual_{};
+  std::array<std::size_t, 7> cycles_above_{};
+
+  Contact contact_;
+};
+
+}  // namespace tacbot
+#endif
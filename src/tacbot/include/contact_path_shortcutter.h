@@ -0,0 +1,154 @@
+#ifndef TACBOT_CONTACT_PATH_SHORTCUTTER_H
+#define TACBOT_CONTACT_PATH_SHORTCUTTER_H
+
+// C++
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// OMPL
+#include <ompl/base/OptimizationObjective.h>
+#include <ompl/base/SpaceInformation.h>
+#include <ompl/geometric/PathGeometric.h>
+#include <ompl/util/RandomNumbers.h>
+
+namespace tacbot {
+
+/** \brief Summary of a single shortcutting run. Costs are reported in the units
+ * of the optimization objective that was used to accept the shortcuts.*/
+struct ShortcutStats {
+  double initial_cost = 0.0;
+  double final_cost = 0.0;
+  double elapsed = 0.0;
+  std::size_t rounds = 0;
+  std::size_t attempts = 0;
+  std::size_t accepted = 0;
+  std::size_t initial_states = 0;
+  std::size_t final_states = 0;
+
+  /** \brief Cost reduction achieved per second of shortcutting time.*/
+  double improvementPerSecond() const {
+    return elapsed > 0.0 ? (initial_cost - final_cost) / elapsed : 0.0;
+  }
+};
+
+/** \class Shortcuts a geometric path by trying many candidate shortcuts in
+ * parallel and accepting them by objective cost rather than by validity alone.
+ * OMPL's PathSimplifier only checks that a shortcut is collision free, which
+ * for contact planning can trade a long contact-free detour for a short segment
+ * that pushes straight through an obstacle. Here a shortcut between states i
+ * and j is accepted only if its motion is valid and its cost is better than the
+ * cost of the path segment it replaces.
+ *
+ * Each round, every worker thread samples its own candidate pairs and
+ * evaluates them against a cache of the per-edge costs. The non-overlapping
+ * candidates with the largest gain are then applied on the calling thread and
+ * the edge cache is updated, so no path state is ever shared between writers.
+ * The workers are started once and wait between rounds, since a round only
+ * holds a few candidates per thread.
+ */
+class ContactPathShortcutter {
+ public:
+  struct Options {
+    /** \brief Wall clock budget for the whole run, in seconds.*/
+    double time_budget = 1.0;
+
+    /** \brief Number of worker threads. Zero uses the hardware concurrency.*/
+    std::size_t num_threads = 0;
+
+    /** \brief Number of candidate shortcuts each worker evaluates per round.*/
+    std::size_t candidates_per_thread = 8;
+
+    /** \brief Stop early after this many rounds without an accepted shortcut.*/
+    std::size_t max_idle_rounds = 10;
+
+    /** \brief Set when the objective's cost function is not re-entrant, for
+     * example when it records visualization data. Motion validity is still
+     * checked in parallel, but cost evaluations are serialized.*/
+    bool serialize_cost = false;
+
+    /** \brief Re-interpolate the shortcut path back to its original number of
+     * states so that downstream time parameterization and control see the
+     * same waypoint density as before.*/
+    bool reinterpolate = true;
+  };
+
+  ContactPathShortcutter(const ompl::base::SpaceInformationPtr& si,
+                         const ompl::base::OptimizationObjectivePtr& objective,
+                         const Options& options);
+  ~ContactPathShortcutter();
+
+  /** \brief Shortcut the path in place.
+    @param path The path to shortcut. Its states are owned by the path and are
+    freed here when they are removed.
+    @return ShortcutStats The cost before and after and the time it took.
+  */
+  ShortcutStats shortcut(ompl::geometric::PathGeometric& path);
+
+ private:
+  /** \brief Threads that wait for the next round instead of being started and
+   * joined for every round.*/
+  class WorkerPool {
+   public:
+    /** \brief Starts num_threads - 1 threads, the calling thread is the first
+     * worker of every round.*/
+    explicit WorkerPool(std::size_t num_threads);
+    ~WorkerPool();
+
+    /** \brief Run task(t) for every worker t and return once all are done.*/
+    void run(const std::function<void(std::size_t)>& task);
+
+   private:
+    void work(std::size_t t);
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_condition_;
+    std::condition_variable done_condition_;
+    const std::function<void(std::size_t)>* task_ = nullptr;
+    std::size_t round_ = 0;
+    std::size_t pending_ = 0;
+    bool stopping_ = false;
+  };
+
+  struct Candidate {
+    std::size_t from = 0;
+    std::size_t to = 0;
+    double gain = 0.0;
+    ompl::base::Cost cost;
+  };
+
+  /** \brief Evaluate random candidate shortcuts on one worker thread.*/
+  void evaluateCandidates(const std::vector<ompl::base::State*>& states,
+                          ompl::RNG& rng, std::vector<Candidate>& accepted,
+                          std::size_t& attempts);
+
+  ompl::base::Cost motionCost(const ompl::base::State* s1,
+                              const ompl::base::State* s2);
+
+  /** \brief Sum of the cached edge costs in [from, to).*/
+  ompl::base::Cost segmentCost(std::size_t from, std::size_t to) const;
+
+  ompl::base::Cost pathCost() const;
+
+  ompl::base::SpaceInformationPtr si_;
+  ompl::base::OptimizationObjectivePtr objective_;
+  Options options_;
+
+  /** \brief One random number generator per worker thread.*/
+  std::vector<ompl::RNG> rngs_;
+
+  std::unique_ptr<WorkerPool> pool_;
+
+  /** \brief The cost of the motion from state i to state i + 1.*/
+  std::vector<ompl::base::Cost> edge_costs_;
+
+  std::mutex cost_mutex_;
+};
+
+}  // namespace tacbot
+#endif
@@ -55,6 +55,14 @@ class ContactPerception {
 
   void addSphere(const tacbot::ObstacleGroup& obstacle);
 
+  /** \brief Build the collision object for a spherical obstacle. It does not
+     need a node handle, so it can also be used to add the obstacle to a
+     planning scene directly.
+      @param obstacle - The obstacle with its name, center and radius.
+      @return moveit_msgs::CollisionObject - The sphere in the robot base frame.*/
+  static moveit_msgs::CollisionObject sphereToCollisionObject(
+      const tacbot::ObstacleGroup& obstacle);
+
   /** \brief Add a cylinder primitive to the center of the point cloud table.
    * This is used to contrast any non-contact planner with the contact planner.
    */
@@ -7,7 +7,11 @@
 
 // C++
 #include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <mutex>
+#include <unordered_map>
 #include <vector>
 
 // MoveIt
@@ -46,7 +50,11 @@
 // Local libraries, helper functions, and utilities
 #include "base_planner.h"
 #include "contact_perception.h"
+#include "execution_monitor.h"
+#include "field_engine.h"
+#include "field_grid_cache.h"
 #include "manipulability_measures.h"
+#include "planner_registry.h"
 #include "utilities.h"
 #include "visualizer_data.h"
 
@@ -72,7 +80,13 @@ class ContactPlanner : public BasePlanner {
 
   /** \brief Initialize the planning scene, monitoring, publishers and
    * subscribers.*/
-  void init();
+  void init() override;
+
+  /** \brief Initialize the planner from robot description files, without
+   * ROS. There is no ContactPerception in this mode, obstacles are simulated
+   * and added to the planning scene directly.*/
+  void init(const std::string& urdf_path,
+            const std::string& srdf_path) override;
 
   /** \brief Changes the planner from the default one that is native to the
      moveit environment, such as RRT, to one that has been specifically created
@@ -93,25 +107,69 @@ class ContactPlanner : public BasePlanner {
     @param pt_on_rob If we are not using simulated obstacles then this point is
     used in the ContactPerception class to obstain obstacles close enough to
     this point.
+    @param record_vis Whether to store the obstacles in the visualization
+    data for the current sample.
     @return std::vector<Eigen::Vector3d> A vector of obstacle positions.
   */
-  std::vector<Eigen::Vector3d> getObstacles(const Eigen::Vector3d& pt_on_rob);
+  std::vector<Eigen::Vector3d> getObstacles(const Eigen::Vector3d& pt_on_rob,
+                                            bool record_vis = true);
+
+  /** \brief Wait for the controller to finish or abort the execution of the
+    last plan. The controller publishes its progress through the monitor, so
+    a failure is seen as soon as it happens rather than at the next poll. A
+    contact reported by the controller is added to the obstacles right away.
+    @param monitor An opened execution monitor.
+    @param timeout Longest time to wait, in seconds.
+    @param status The last status of the execution.
+    @param on_contact Called once with the status that first reports a
+    contact, while the robot is still moving, e.g. to retarget it.
+    @return bool Whether the execution finished without failing.
+  */
+  bool monitorExecution(
+      const ExecutionMonitor& monitor, double timeout, ExecutionStatus& status,
+      const std::function<void(const ExecutionStatus&)>& on_contact = nullptr);
+
+  /** \brief Add a simulated obstacle where the controller has detected a
+    contact, so that the next plan avoids or expects it.
+    @param status An execution status with a contact.
+    @param radius Radius of the obstacle around the contact point, in m.
+  */
+  void addContactObstacle(const ExecutionStatus& status, double radius = 0.05);
 
   void analyzePlanResponse(BenchMarkData& benchmark_data);
   void setObstacleScene(std::size_t option);
   void setGoalState(std::size_t option);
 
+  /** \brief Levels of detail and point budget of the robot surface points.
+   * Takes effect right away, the fields cached for the old points are
+   * dropped.*/
+  void setSurfaceOptions(const FieldEngine::Options& options) {
+    field_engine_.setOptions(options);
+    field_memo_.clear();
+    scene_version_++;
+  }
+
   void setObjectiveName(std::string objective_name) {
     objective_name_ = objective_name;
   }
 
   /** \brief The class that handles point cloud processing of the surrounding
-   * environment and transfers this information to the planner.*/
+   * environment and transfers this information to the planner. Only created
+   * by the ROS initialization.*/
   std::shared_ptr<ContactPerception> contact_perception_;
 
+ protected:
+  /** \brief The field objectives record every evaluated state into the
+   * visualization data, so their costs have to be evaluated one at a time.*/
+  bool isCostThreadSafe() const override { return false; }
+
  private:
+  /** \brief The planners and objectives that changePlanner() can select.*/
+  static const PlannerRegistry<ContactPlanner>& registry();
+
   std::string objective_name_ = "FieldAlign";
 
+
   /** \brief The number of samples that have been processed by the contact
    * planner class. As TRRT or other class generates random samples, this class
    * processes these samples and with each sample this counter gets
@@ -136,7 +194,72 @@ class ContactPlanner : public BasePlanner {
   Eigen::VectorXd getRobtPtsVecDiffAvg(
       const std::vector<std::vector<Eigen::Vector3d>>& near_state_rob_pts,
       const std::vector<std::vector<Eigen::Vector3d>>& rand_state_rob_pts,
-      const std::vector<Eigen::Vector3d>& link_to_obs_vec);
+      const std::vector<Eigen::Vector3d>& link_to_obs_vec,
+      bool record_vis = true);
+
+  /** \brief The surface points and repulsion of a robot state, kept so that
+   * the extension step and the costing of the same state share them.*/
+  struct FieldSample {
+    bool has_pts = false;
+    Eigen::MatrixXd jacobian;
+    std::vector<std::vector<Eigen::Vector3d>> rob_pts;
+    std::vector<BoundingSphere> link_spheres;
+    std::size_t num_pts = 0;
+    std::vector<Eigen::Vector3d> link_to_obs_vec;
+    bool has_field = false;
+    bool has_validity = false;
+    bool valid = true;
+  };
+
+  /** \brief Look up or compute the field sample of a state. The repulsion,
+    the expensive part, is only computed when it is asked for, and is zero
+    without being computed for invalid states and for states that no
+    obstacle is within reach of.
+    @param state The planner state.
+    @param with_field Whether the repulsion per link is needed.
+    @param computed Set if the repulsion was computed exactly by this call
+    rather than taken from the memo or the field grid. Visualization data is
+    only recorded in that case.
+    @return FieldSample& Valid until the next call to trimFieldMemo().
+  */
+  FieldSample& getFieldSample(const ompl::base::State* state, bool with_field,
+                              bool& computed);
+
+  /** \brief Bound the memo. Called at the start of every field evaluation so
+   * that references returned within one evaluation stay valid.*/
+  void trimFieldMemo();
+
+  /** \brief Whether any obstacle is within the reach of the field from one of
+   * the link spheres. Answered from the spatial hash of the field engine.*/
+  bool isObstacleNear(const std::vector<BoundingSphere>& link_spheres) const;
+
+  /** \brief Checks the validity of the states that the field is evaluated
+   * at, the space information of the current planning context.*/
+  ompl::base::SpaceInformationPtr field_si_;
+
+  /** \brief Exact per-link repulsion at a configuration, flattened for the
+   * field grid. Grid vertices are not planner samples and are not recorded.*/
+  FieldGridCache::Evaluator gridEvaluator();
+
+  /** \brief Repulsion per link, interpolated over the joint space. Samples
+   * that are interpolated are not recorded in the visualization data.*/
+  FieldGridCache field_grid_;
+
+  /** \brief States are memoized by their joint values rounded to this
+   * resolution, in rad, so that states the planner reaches again along
+   * slightly different paths share their sample.*/
+  static constexpr double FIELD_MEMO_RESOLUTION = 1e-4;
+  static constexpr std::size_t MAX_FIELD_MEMO_SIZE = 4096;
+
+  using FieldMemoKey = std::vector<std::int64_t>;
+  struct FieldMemoKeyHash {
+    std::size_t operator()(const FieldMemoKey& key) const;
+  };
+  std::unordered_map<FieldMemoKey, FieldSample, FieldMemoKeyHash> field_memo_;
+
+  /** \brief Robot state that the surface points of new samples are computed
+   * on, so the memo does not have to keep a state per sample.*/
+  moveit::core::RobotStatePtr field_state_;
 
   Eigen::VectorXd obstacleFieldCartesian(const ompl::base::State* near_state,
                                          const ompl::base::State* rand_state);
@@ -187,36 +310,32 @@ class ContactPlanner : public BasePlanner {
   */
   Eigen::Vector3d scaleToDist(Eigen::Vector3d vec);
 
-  /** \brief Obtain a set of points from a specific mesh of a robot link.
-    @param robot_state The robot state at given joint state.
-    @param link_model The model of the link for which to extract pts.
-    @param link_pts The points on the link model.
-    @param num_pts The accumulated number of points. Keeps getting incremented
-    each time this function is called.
-  */
-  void extractPtsFromModel(const moveit::core::RobotStatePtr& robot_state,
-                           const moveit::core::LinkModel* link_model,
-                           std::vector<Eigen::Vector3d>& link_pts,
-                           std::size_t& num_pts);
-
   /** \brief Obtain points on a robot surface. This is used to understand how
     far away the robot is from obstacles.
     @param robot_state The robot state that specifies the joint configuration
     which will be used to understand the tf for the points on the robot surface.
     @param rob_pts The points on the robot surface.
+    @param link_spheres A bounding sphere per link of rob_pts.
     @return std::size_t The total number of points extracted from the robot
     surface.
   */
   std::size_t getPtsOnRobotSurface(
       const moveit::core::RobotStatePtr& robot_state,
-      std::vector<std::vector<Eigen::Vector3d>>& rob_pts);
+      std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+      std::vector<BoundingSphere>& link_spheres);
 
   /** \brief
     @param rob_pts The Points on the robot surface.
+    @param link_spheres Bounding spheres of the links. Links that no obstacle
+    can reach get a zero vector without their points being visited.
     @return std::vector<Eigen::Vector3d> A set of repulsive vectors per link.
   */
   std::vector<Eigen::Vector3d> getLinkToObsVec(
-      const std::vector<std::vector<Eigen::Vector3d>>& rob_pts);
+      const std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+      const std::vector<BoundingSphere>& link_spheres, bool record_vis = true);
+
+  /** \brief Surface points, link bounding spheres and the obstacle index.*/
+  FieldEngine field_engine_;
 
   void addSphericalObstacle(const Eigen::Vector3d& center, double radius);
 
@@ -0,0 +1,50 @@
+#ifndef TACBOT_CONTROL_BACKEND_H
+#define TACBOT_CONTROL_BACKEND_H
+
+// C++
+#include <functional>
+
+// Franka
+#include <franka/control_types.h>
+#include <franka/duration.h>
+#include <franka/robot.h>
+#include <franka/robot_state.h>
+
+namespace tacbot {
+
+/** \class The part of franka::Robot that the execution routines use: reading
+ * the state and running a joint velocity control loop. It lets the routines
+ * run against a simulated robot as well as the real one.
+ */
+class ControlBackend {
+ public:
+  using JointVelocityCallback = std::function<franka::JointVelocities(
+      const franka::RobotState&, franka::Duration)>;
+
+  virtual ~ControlBackend() = default;
+
+  virtual franka::RobotState readOnce() = 0;
+
+  /** \brief Same contract as franka::Robot::control: the callback is called
+   * once per cycle, with the time since the previous call, until it returns
+   * a command marked with franka::MotionFinished.*/
+  virtual void control(JointVelocityCallback callback) = 0;
+};
+
+/** \brief Forwards to a real robot.*/
+class FrankaBackend : public ControlBackend {
+ public:
+  explicit FrankaBackend(franka::Robot* robot) : robot_(robot) {}
+
+  franka::RobotState readOnce() override { return robot_->readOnce(); }
+
+  void control(JointVelocityCallback callback) override {
+    robot_->control(callback);
+  }
+
+ private:
+  franka::Robot* robot_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,141 @@
+#ifndef TACBOT_CONTROL_LOG_H
+#define TACBOT_CONTROL_LOG_H
+
+// C++
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace tacbot {
+
+/** \class A lock-free queue with a single producer and a single consumer.
+ * The storage is allocated once, at construction, so that pushing from a real
+ * time thread never touches the heap. When the queue is full, push fails and
+ * the item is dropped instead of waiting for the consumer.
+ */
+template <typename T>
+class SpscRingBuffer {
+ public:
+  /** \brief The capacity is rounded up to a power of two.*/
+  explicit SpscRingBuffer(std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    buffer_.resize(size);
+    mask_ = size - 1;
+  }
+
+  /** \brief Called by the producer only.
+    @return false if the queue is full.
+  */
+  bool push(const T& item) {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    const std::size_t tail = tail_.load(std::memory_order_acquire);
+    if (head - tail == buffer_.size()) {
+      return false;
+    }
+    buffer_[head & mask_] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** \brief Called by the consumer only.
+    @return false if the queue is empty.
+  */
+  bool pop(T& item) {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    const std::size_t head = head_.load(std::memory_order_acquire);
+    if (tail == head) {
+      return false;
+    }
+    item = buffer_[tail & mask_];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  std::size_t capacity() const { return buffer_.size(); }
+
+ private:
+  std::vector<T> buffer_;
+  std::size_t mask_ = 0;
+
+  // the two indices are written by different threads, keep them on separate
+  // cache lines
+  alignas(64) std::atomic<std::size_t> head_{0};
+  alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+/** \brief One cycle of the robot's control loop.*/
+struct ControlSample {
+  /** \brief Time since the start of the motion, and the period of the cycle,
+   * in seconds.*/
+  double time = 0.0;
+  double period = 0.0;
+
+  std::array<double, 7> q{};
+  std::array<double, 7> dq{};
+  std::array<double, 7> ddq_d{};
+  std::array<double, 7> tau_J{};
+
+  /** \brief The value returned by the control callback, e.g. joint
+   * velocities.*/
+  std::array<double, 7> command{};
+};
+
+/** \class Records control loop telemetry without blocking the control loop.
+ * The callback pushes samples into a SpscRingBuffer and a writer thread
+ * drains them into a CSV file, so the length of a recording is only bounded
+ * by the disk. If the writer falls behind by more than the capacity of the
+ * buffer, samples are dropped and counted rather than delaying the callback.
+ */
+class ControlLogger {
+ public:
+  /** \brief The default capacity holds about 16 seconds at 1 kHz.*/
+  explicit ControlLogger(std::size_t capacity = 1 << 14);
+  ~ControlLogger();
+
+  ControlLogger(const ControlLogger&) = delete;
+  ControlLogger& operator=(const ControlLogger&) = delete;
+
+  /** \brief Open the file and start the writer thread. Samples left over
+    from the previous recording are discarded.
+    @param path The CSV file to write to. It is overwritten.
+    @return false if the file could not be opened or a recording is already
+    running.
+  */
+  bool start(const std::string& path);
+
+  /** \brief Write out the remaining samples and close the file.*/
+  void stop();
+
+  bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+  /** \brief Queue a sample. Safe to call from the control callback: it does
+   * not lock, allocate or do any I/O. Does nothing when not running.*/
+  void record(const ControlSample& sample);
+
+  /** \brief Number of samples dropped because the buffer was full.*/
+  std::size_t getDropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /** \brief Body of the writer thread.*/
+  void drain();
+
+  void write(const ControlSample& sample);
+
+  SpscRingBuffer<ControlSample> buffer_;
+  std::atomic<bool> running_{false};
+  std::atomic<std::size_t> dropped_{0};
+  std::thread writer_;
+  std::ofstream file_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,127 @@
+#ifndef TACBOT_CYCLE_TIMING_H
+#define TACBOT_CYCLE_TIMING_H
+
+// C++
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace tacbot {
+
+/** \class A histogram of durations in nanoseconds with a bounded relative
+ * error, in the manner of HdrHistogram. Each power of two is split into 32
+ * linear buckets, so a recorded value is off by at most about 3%. The buckets
+ * are a fixed array: recording never allocates and takes a few instructions,
+ * which makes it cheap enough for every cycle of the control loop.
+ */
+class LatencyHistogram {
+ public:
+  /** \brief Record one duration. Values above about 134 ms are counted in
+   * the last bucket, but still update the maximum.*/
+  void record(std::uint64_t value);
+
+  void reset();
+
+  std::uint64_t getCount() const { return count_; }
+  std::uint64_t getMax() const { return max_; }
+  double getMean() const;
+
+  /** \brief The smallest value that at least percentile % of the recorded
+   * values are less than or equal to, up to the resolution of the buckets.
+    @param percentile In [0, 100].
+  */
+  std::uint64_t getValueAtPercentile(double percentile) const;
+
+ private:
+  static constexpr int SUB_BUCKET_BITS = 5;
+  static constexpr int MAX_EXPONENT = 26;
+  static constexpr std::size_t BUCKET_COUNT =
+      ((MAX_EXPONENT - SUB_BUCKET_BITS) << SUB_BUCKET_BITS) +
+      (2 << SUB_BUCKET_BITS);
+
+  static std::size_t bucketIndex(std::uint64_t value);
+  /** \brief The largest value that falls into the bucket.*/
+  static std::uint64_t bucketUpperBound(std::size_t index);
+
+  std::array<std::uint64_t, BUCKET_COUNT> counts_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t max_ = 0;
+  double sum_ = 0.0;
+};
+
+/** \class Per-cycle timing of a control callback. For every cycle it records
+ * how long the callback took to compute its command, how far the time since
+ * the previous cycle was from the nominal period, and whether the callback
+ * ran over its budget. libfranka reports a period longer than the nominal one
+ * when cycles were lost, those are counted as missed. The timer is reset
+ * before a motion and reported after it, outside of the control loop.
+ */
+class CycleTimer {
+ public:
+  /** \class Times one cycle, from construction to destruction, so that
+   * every return path of a callback is covered.*/
+  class Scope {
+   public:
+    /**
+      @param period The period libfranka passed to the callback, in seconds.
+    */
+    Scope(CycleTimer& timer, double period) : timer_(timer) {
+      timer_.begin(period);
+    }
+    ~Scope() { timer_.end(); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    CycleTimer& timer_;
+  };
+
+  /**
+    @param budget Compute time per cycle above which a cycle counts as over
+    budget, in seconds.
+    @param nominal_period The period of the control loop, in seconds.
+  */
+  explicit CycleTimer(double budget = 0.001, double nominal_period = 0.001);
+
+  /** \brief Clear the statistics, before a new motion.*/
+  void reset();
+
+  void begin(double period);
+  void end();
+
+  void setBudget(double budget);
+  double getBudget() const;
+
+  std::uint64_t getCycles() const { return compute_time_.getCount(); }
+  std::uint64_t getOverBudget() const { return over_budget_; }
+  std::uint64_t getMissedCycles() const { return missed_cycles_; }
+  const LatencyHistogram& getComputeTime() const { return compute_time_; }
+  const LatencyHistogram& getJitter() const { return jitter_; }
+
+  /** \brief Write a one line summary of the last motion.
+    @param name The name of the control routine.
+  */
+  void report(const std::string& name, std::ostream& out) const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::uint64_t budget_ns_;
+  std::uint64_t nominal_period_ns_;
+
+  Clock::time_point cycle_start_;
+  Clock::time_point last_cycle_start_;
+  bool has_last_cycle_ = false;
+
+  LatencyHistogram compute_time_;
+  LatencyHistogram jitter_;
+  std::uint64_t over_budget_ = 0;
+  std::uint64_t missed_cycles_ = 0;
+};
+
+}  // namespace tacbot
+#endif
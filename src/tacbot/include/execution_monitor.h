@@ -0,0 +1,125 @@
+#ifndef TACBOT_EXECUTION_MONITOR_H
+#define TACBOT_EXECUTION_MONITOR_H
+
+// C++
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+namespace tacbot {
+
+/** \brief The state of trajectory execution, as seen by the control loop.*/
+struct ExecutionStatus {
+  enum State : std::int32_t {
+    IDLE = 0,
+    RUNNING = 1,
+    FINISHED = 2,
+    FAILED = -1,
+  };
+
+  State state = IDLE;
+
+  /** \brief Index of the trajectory point the robot is moving away from.*/
+  std::uint32_t pt_idx = 0;
+
+  /** \brief Time since the start of the motion, in seconds.*/
+  double time = 0.0;
+
+  std::array<double, 7> q{};
+  std::array<double, 7> tau_measured{};
+
+  /** \brief Difference between the measured and the expected joint torques,
+   * e.g. the robot's estimate of the external torques.*/
+  std::array<double, 7> tau_residual{};
+
+  /** \brief Link the controller has detected a contact on, -1 if there is
+   * none, and the estimated location of the contact in the base frame.*/
+  std::int32_t contact_link = -1;
+  std::array<double, 3> contact_point{};
+};
+
+/** \class Hands the ExecutionStatus from the control loop to the planner
+ * through a block of POSIX shared memory, so that both can run in one process
+ * or in two without any ROS transport in between.
+ *
+ * The block is a seqlock: the control loop, the only writer, never waits for
+ * a reader, and readers retry when they catch the writer in the middle of an
+ * update. Readers that wait for a new status sleep on a futex on the sequence
+ * number, which the writer only signals when somebody is waiting. A failure
+ * detected by the controller therefore reaches the planner within
+ * microseconds, instead of at the next poll.
+ */
+class ExecutionMonitor {
+ public:
+  ExecutionMonitor() = default;
+  ~ExecutionMonitor();
+
+  ExecutionMonitor(const ExecutionMonitor&) = delete;
+  ExecutionMonitor& operator=(const ExecutionMonitor&) = delete;
+
+  /** \brief Map the shared memory block.
+    @param name Name of the block, e.g. "/tacbot_execution".
+    @param create Whether to create the block. The side that creates it,
+    usually the control side, removes it again when it is closed. Only one
+    side may create a block of a given name, a second one would reset it
+    under the writer of the first and remove it when closed.
+    @return false if the block could not be created or mapped, or was not
+    created by an ExecutionMonitor.
+  */
+  bool open(const std::string& name, bool create);
+
+  void close();
+
+  bool isOpen() const { return block_ != nullptr; }
+
+  /** \brief Write a new status. Only one thread may publish, it does not
+   * lock, allocate or block, so it can be called from the control loop.*/
+  void publish(const ExecutionStatus& status);
+
+  /** \brief Read the latest status.
+    @return The sequence number of the status, to be passed to waitForUpdate.
+  */
+  std::uint32_t read(ExecutionStatus& status) const;
+
+  /** \brief Wait until a status newer than the given sequence number has been
+    published, and read it.
+    @param sequence The sequence number returned by the last read.
+    @param timeout Longest time to wait, in seconds.
+    @return false on timeout.
+  */
+  bool waitForUpdate(std::uint32_t& sequence, double timeout,
+                     ExecutionStatus& status) const;
+
+  /** \brief Wait until the execution has finished or failed.
+    @param timeout Longest time to wait, in seconds.
+    @return false on timeout.
+  */
+  bool waitForCompletion(double timeout, ExecutionStatus& status) const;
+
+ private:
+  static_assert(std::is_trivially_copyable<ExecutionStatus>::value,
+                "the status is copied word by word");
+  static constexpr std::size_t WORD_COUNT =
+      (sizeof(ExecutionStatus) + sizeof(std::uint64_t) - 1) /
+      sizeof(std::uint64_t);
+
+  struct SharedBlock {
+    std::uint64_t magic;
+    /** \brief Odd while the writer is updating the status.*/
+    alignas(64) std::atomic<std::uint32_t> sequence;
+    std::atomic<std::uint32_t> waiters;
+    /** \brief The status, as atomic words so that a torn read is a retry
+     * instead of a data race.*/
+    alignas(64) std::atomic<std::uint64_t> words[WORD_COUNT];
+  };
+
+  SharedBlock* block_ = nullptr;
+  std::string name_;
+  bool owner_ = false;
+};
+
+}  // namespace tacbot
+#endif
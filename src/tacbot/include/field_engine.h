@@ -0,0 +1,254 @@
+#ifndef TACBOT_FIELD_ENGINE_H
+#define TACBOT_FIELD_ENGINE_H
+
+// C++
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// MoveIt
+#include <moveit/robot_model/joint_model_group.h>
+#include <moveit/robot_model/link_model.h>
+#include <moveit/robot_state/robot_state.h>
+
+// Eigen
+#include <Eigen/Core>
+
+#include "planner_registry.h"
+
+namespace tacbot {
+
+struct BoundingSphere {
+  Eigen::Vector3d center = Eigen::Vector3d::Zero();
+  double radius = 0.0;
+
+  /** \brief Grow the sphere so that it also encloses the other one.*/
+  void merge(const BoundingSphere& other);
+};
+
+/** \class The parts of the obstacle field computation that the contact and the
+ * perception planners share. It keeps the surface points of every link in the
+ * link's own frame, so a robot state only costs a transform per point, and a
+ * bounding sphere per link. The obstacle points are hashed into a grid whose
+ * cells are as large as the reach of the field, so whether any obstacle is
+ * close enough to a link to repel it is answered from a few cells without
+ * looking at the link's surface points.
+ *
+ * The surface points of a link are stored in farthest point order, so that
+ * every prefix of them covers the whole link evenly. A level of detail is a
+ * prefix length: links in contact use the dense prefix, links that are farther
+ * away use a short one, and point j is the same point on the link at every
+ * level, which keeps the correspondences between states and the goal state
+ * that the field relies on.
+ *
+ * evaluateBatch() computes the repulsion of many states in one call, e.g. of
+ * a whole trajectory. The forward kinematics of all states run on one robot
+ * state, and the obstacles around a link are looked up once for a run of
+ * consecutive states rather than once per point and state. The distances from
+ * a point to those obstacles are then a single matrix expression.
+ */
+class FieldEngine {
+ public:
+  struct Options {
+    /** \brief Point spacing of each level of detail, finest first. The finest
+     * spacing is also the distance at which mesh vertices are merged, so the
+     * default keeps it at the spacing the planners have always used.*/
+    std::vector<double> lod_spacings = {0.05, 0.1};
+
+    /** \brief Upper bound on the number of points placed per robot state,
+     * zero for no bound. Links farthest from the obstacles are made coarser
+     * first when the bound is exceeded.*/
+    std::size_t max_pts = 0;
+  };
+
+  /** \brief The repulsion of a batch of robot states, a column per state.*/
+  struct FieldBatch {
+    /** \brief Average repulsion vector of each link, rows 3 * i to 3 * i + 2
+     * belong to link i.*/
+    Eigen::MatrixXd link_vecs;
+
+    /** \brief Sum of the magnitudes of the link repulsion vectors.*/
+    Eigen::VectorXd costs;
+
+    std::size_t numLinks() const { return link_vecs.rows() / 3; }
+
+    Eigen::Vector3d linkVec(std::size_t state, std::size_t link) const {
+      return link_vecs.block<3, 1>(3 * link, state);
+    }
+  };
+
+  FieldEngine();
+  explicit FieldEngine(const Options& options);
+
+  /** \brief Changing the options drops the precomputed surfaces.*/
+  void setOptions(const Options& options);
+
+  const Options& getOptions() const { return options_; }
+
+  /** \brief Set the obstacle points and rebuild the spatial hash.*/
+  void setObstacles(const std::vector<Eigen::Vector3d>& obstacles);
+
+  /** \brief Set the field shaping. The hash cell size follows the reach.*/
+  void setFieldParams(const FieldParams& params);
+
+  const FieldParams& getFieldParams() const { return params_; }
+
+  /** \brief Distance from an obstacle point beyond which it does not repel.*/
+  double getReach() const;
+
+  bool hasObstacles() const { return num_obstacles_ > 0; }
+
+  /** \brief The surface points of one link, in the link's frame and in
+   * farthest point order.*/
+  struct LinkSurface {
+    std::vector<Eigen::Vector3d> local_pts;
+
+    /** \brief Number of leading points that make up each level of detail.*/
+    std::vector<std::size_t> level_counts;
+
+    BoundingSphere local_sphere;
+  };
+
+  /** \brief Order the points of a link so that every level of detail is a
+    prefix of them.
+    @param pts The points of the link, in the link's frame.
+    @param lod_spacings Point spacing of each level of detail, finest first.
+    The finest level is all of the points.
+    @return LinkSurface The ordered points and the prefix length of each
+    level.
+  */
+  static LinkSurface buildLinkSurface(const std::vector<Eigen::Vector3d>& pts,
+                                      const std::vector<double>& lod_spacings);
+
+  /** \brief Pick the level of detail of every link and apply the point
+    budget of the options.
+    @param surfaces The surfaces of the links.
+    @param link_spheres The bounding sphere of each link at the robot state.
+    @return std::vector<std::size_t> The number of leading points to place on
+    each link.
+  */
+  std::vector<std::size_t> choosePtCounts(
+      const std::vector<const LinkSurface*>& surfaces,
+      const std::vector<BoundingSphere>& link_spheres) const;
+
+  /** \brief Obtain points on a robot surface, grouped per link the same way
+    the planners group their repulsion vectors. The level of detail of each
+    link is picked from its distance to the nearest obstacle.
+    @param robot_state The robot state at which to place the points.
+    @param joint_model_group The group whose links are sampled.
+    @param dof Number of actuated joints. Links past the last joint are merged
+    into one group, they do not have meshes of their own.
+    @param rob_pts The points on the robot surface per link.
+    @param link_spheres A sphere per link that encloses its points.
+    @param full_detail Place every point of every link regardless of the
+    obstacles and the budget.
+    @return std::size_t The total number of points.
+  */
+  std::size_t getPtsOnRobotSurface(
+      const moveit::core::RobotState& robot_state,
+      const moveit::core::JointModelGroup* joint_model_group, std::size_t dof,
+      std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+      std::vector<BoundingSphere>& link_spheres, bool full_detail = false);
+
+  /** \brief The points of the goal state, per link, that the repulsion is
+   * blended with when the field params use the goal attractor.*/
+  void setAttractorPts(const std::vector<std::vector<Eigen::Vector3d>>& pts) {
+    attractor_pts_ = pts;
+  }
+
+  /** \brief Evaluate the repulsion of every link for many states at once,
+    against the obstacles given to setObstacles(). Each state gets the same
+    result as averaging the scaled point to obstacle vectors state by state.
+    @param seed_state Provides the values of the joints outside of the group.
+    @param joint_model_group The group whose joints are set.
+    @param dof Number of actuated joints.
+    @param joint_values The group's joint values of one state after the
+    other, num_states times the number of variables of the group.
+    @param num_states Number of states.
+    @param batch The repulsion per link and the cost of each state.
+  */
+  void evaluateBatch(const moveit::core::RobotState& seed_state,
+                     const moveit::core::JointModelGroup* joint_model_group,
+                     std::size_t dof, const double* joint_values,
+                     std::size_t num_states, FieldBatch& batch);
+
+  /** \brief The part of evaluateBatch() after the forward kinematics.
+    @param rob_pts The surface points of each state, per link.
+    @param link_spheres The link spheres of each state.
+    @param batch The repulsion per link and the cost of each state.
+  */
+  void evaluatePtsBatch(
+      const std::vector<std::vector<std::vector<Eigen::Vector3d>>>& rob_pts,
+      const std::vector<std::vector<BoundingSphere>>& link_spheres,
+      FieldBatch& batch) const;
+
+  /** \brief Whether any obstacle point is within the reach of the field from
+   * the sphere, in which case the link's points have to be evaluated.*/
+  bool isObstacleNear(const BoundingSphere& sphere) const;
+
+  /** \brief Distance to the closest obstacle point, searching no farther than
+    max_dist.
+    @return The distance, or infinity if there is none within max_dist.
+  */
+  double nearestObstacleDistance(const Eigen::Vector3d& pt,
+                                 double max_dist) const;
+
+ private:
+  /** \brief The link whose frame the points of a link group are stored in,
+   * and whether the group is made of the links fixed to it.*/
+  struct LinkSlot {
+    const moveit::core::LinkModel* link_model = nullptr;
+    bool use_fixed_links = false;
+  };
+
+  using LinkSurfacePtr = std::shared_ptr<const LinkSurface>;
+
+  /** \brief The surface stays valid for as long as the caller holds on to
+   * it, even if setOptions() drops the precomputed surfaces meanwhile.*/
+  LinkSurfacePtr getLinkSurface(const LinkSlot& slot);
+
+  void appendShapePts(const moveit::core::LinkModel* link_model,
+                      const Eigen::Isometry3d& link_to_slot,
+                      std::vector<Eigen::Vector3d>& local_pts) const;
+
+  /** \brief The obstacle points within range of the sphere, one per
+   * column.*/
+  Eigen::Matrix3Xd gatherObstacles(const BoundingSphere& sphere,
+                                   double range) const;
+
+  /** \brief Sum of the scaled vectors from the obstacles to a point, with the
+   * goal attractor blended in when it is given.*/
+  Eigen::Vector3d repulsionSum(const Eigen::Vector3d& pt,
+                               const Eigen::Matrix3Xd& obstacles,
+                               const Eigen::Vector3d* att_pt) const;
+
+  /** \brief Consecutive states of a batch that share the obstacle lookup of
+   * a link.*/
+  static constexpr std::size_t BATCH_RUN_LENGTH = 8;
+
+  std::int64_t cellKey(long x, long y, long z) const;
+  long cellIdx(double coord) const;
+
+  void rebuildIndex();
+
+  Options options_;
+  FieldParams params_;
+
+  std::vector<Eigen::Vector3d> obstacles_;
+  std::size_t num_obstacles_ = 0;
+  double cell_size_ = 0.1;
+  std::unordered_map<std::int64_t, std::vector<Eigen::Vector3d>> cells_;
+
+  std::vector<std::vector<Eigen::Vector3d>> attractor_pts_;
+
+  /** \brief Filled on first use. Guarded since cost evaluations may place
+   * robot points from several threads.*/
+  std::map<const moveit::core::LinkModel*, LinkSurfacePtr> surfaces_;
+  std::mutex surfaces_mutex_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,109 @@
+#ifndef TACBOT_FIELD_GRID_CACHE_H
+#define TACBOT_FIELD_GRID_CACHE_H
+
+// C++
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Eigen
+#include <Eigen/Core>
+
+namespace tacbot {
+
+/** \class A sparse grid over the joint space that caches the value of an
+ * expensive function of the configuration, such as the obstacle field or the
+ * contact cost, at the grid vertices. Sampling planners concentrate their
+ * samples in narrow passages next to obstacles, so the same cells are queried
+ * over and over and their vertices only have to be evaluated once.
+ *
+ * A query is answered by interpolating over the Kuhn simplex of its cell, which
+ * needs dim + 1 vertices rather than the 2^dim corners of the cell. The first
+ * query in a simplex also evaluates the function exactly at the simplex's
+ * centroid, which bounds the interpolation error in the whole simplex where the
+ * function is locally convex or concave. If that bound exceeds the tolerance,
+ * for example because the simplex straddles the surface of an obstacle, every
+ * query in the simplex is rejected and the caller evaluates the configuration
+ * exactly. A simplex on which the function is close to linear is trusted
+ * however much the vertex values differ. Around saddle points the errors at
+ * the centroid can cancel, so the bound is an estimate there.
+ *
+ * Only the vertex map is guarded, evaluations run outside of the lock, so the
+ * cache can be shared by threads that evaluate costs concurrently.
+ */
+class FieldGridCache {
+ public:
+  struct Options {
+    /** \brief Edge length of a grid cell, in radians.*/
+    double resolution = 0.05;
+
+    /** \brief Largest interpolation error in a simplex, per component, for
+     * which interpolation in the simplex is trusted.*/
+    double tolerance = 0.1;
+
+    /** \brief The cache is cleared when it grows beyond this many vertices or
+     * checked simplices.*/
+    std::size_t max_vertices = 200000;
+  };
+
+  struct Stats {
+    std::size_t interpolated = 0;
+    std::size_t rejected = 0;
+    std::size_t vertex_hits = 0;
+    std::size_t vertex_evaluations = 0;
+    std::size_t simplex_checks = 0;
+  };
+
+  /** \brief Exact evaluation of the cached function at a configuration.*/
+  using Evaluator = std::function<Eigen::VectorXd(const std::vector<double>&)>;
+
+  FieldGridCache();
+  explicit FieldGridCache(const Options& options);
+
+  /** \brief Interpolate the function at a configuration from the grid.
+    @param q The configuration.
+    @param evaluator Used to fill in grid vertices that are not cached yet.
+    @param value The interpolated value, only set on success.
+    @return false if interpolation is off by more than the tolerance in the
+    simplex of q, in which case q should be evaluated exactly.
+  */
+  bool interpolate(const std::vector<double>& q, const Evaluator& evaluator,
+                   Eigen::VectorXd& value);
+
+  /** \brief Drop all vertices if the scene changed since they were computed.
+    @param scene_version Counter that is incremented on every scene change.
+  */
+  void setSceneVersion(std::size_t scene_version);
+
+  void clear();
+
+  void setOptions(const Options& options);
+
+  Stats getStats() const;
+
+ private:
+  using Vertex = std::vector<long>;
+
+  struct VertexHash {
+    std::size_t operator()(const Vertex& vertex) const;
+  };
+
+  /** \brief The cached value at a vertex, evaluated on a miss. Returned by
+   * value since another thread may clear the map.*/
+  Eigen::VectorXd vertexValue(const Vertex& vertex, const Evaluator& evaluator);
+
+  Options options_;
+  std::size_t scene_version_ = 0;
+  Stats stats_;
+  std::unordered_map<Vertex, Eigen::VectorXd, VertexHash> vertices_;
+
+  /** \brief Whether interpolation is trusted in a simplex, keyed by the lower
+   * corner of its cell followed by the order in which it walks the axes.*/
+  std::unordered_map<Vertex, bool, VertexHash> simplices_;
+  mutable std::mutex mutex_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,72 @@
+#ifndef TACBOT_GRIPPER_EXECUTOR_H
+#define TACBOT_GRIPPER_EXECUTOR_H
+
+// C++
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+// Franka
+#include <franka/gripper.h>
+
+namespace tacbot {
+
+/** \class Runs the commands of a franka::Gripper on a worker thread, so that
+ * the arm can move while the gripper opens or closes. Each command returns a
+ * future for its result: the value of the gripper call, or the exception it
+ * threw. The commands are run one after the other in the order they were
+ * given.
+ */
+class GripperExecutor {
+ public:
+  /** \brief The gripper must outlive the executor.*/
+  explicit GripperExecutor(franka::Gripper* gripper);
+
+  /** \brief Waits for the commands that have been given to finish.*/
+  ~GripperExecutor();
+
+  GripperExecutor(const GripperExecutor&) = delete;
+  GripperExecutor& operator=(const GripperExecutor&) = delete;
+
+  std::future<bool> homing();
+
+  /**
+    @param width Width to move the fingers to, in m.
+    @param speed In m/s.
+  */
+  std::future<bool> move(double width, double speed);
+
+  /** \brief Move the fingers to the largest width the gripper supports.*/
+  std::future<bool> open(double speed);
+
+  /** \brief Close the fingers on an object, see franka::Gripper::grasp.*/
+  std::future<bool> grasp(double width, double speed, double force,
+                          double epsilon_inner = 0.005,
+                          double epsilon_outer = 0.005);
+
+  /** \brief Stop the command that is running, right away rather than after
+   * the commands before it.*/
+  bool stop();
+
+  franka::Gripper* getGripper() const { return gripper_; }
+
+ private:
+  std::future<bool> enqueue(std::function<bool()> command);
+
+  /** \brief Body of the worker thread.*/
+  void run();
+
+  franka::Gripper* gripper_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::packaged_task<bool()>> commands_;
+  bool stopping_ = false;
+  std::thread worker_;
+};
+
+}  // namespace tacbot
+#endif
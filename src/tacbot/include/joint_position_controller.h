@@ -8,19 +8,37 @@
 #include <franka_msgs/FrankaState.h>
 #include <hardware_interface/joint_command_interface.h>
 #include <hardware_interface/robot_hw.h>
+#include <realtime_tools/realtime_buffer.h>
 #include <realtime_tools/realtime_publisher.h>
 #include <ros/node_handle.h>
 #include <ros/time.h>
 #include <trajectory_msgs/JointTrajectory.h>
 
 #include <array>
+#include <deque>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "contact_detector.h"
+#include "execution_monitor.h"
+#include "joint_trajectory_spline.h"
 #include "tacbot/TrajExecutionMonitor.h"
 
 namespace tacbot {
 
+/** \class A ros_control controller that follows the joint trajectories
+ * published by the planner, at the rate of the control loop.
+ *
+ * Trajectories are converted to a JointTrajectorySpline in the subscriber
+ * callback and handed to update() through a realtime buffer, so a new
+ * trajectory can replace the running one at any time without blocking the
+ * control loop. The spline is sampled at the time since the trajectory was
+ * picked up, and its segment lookup resumes from the previous cycle's segment.
+ * Monitoring messages are preallocated and published through realtime
+ * publishers, and the execution status can also be shared through an
+ * ExecutionMonitor.
+ */
 class JointPositionController
     : public controller_interface::MultiInterfaceController<
           franka_hw::FrankaModelInterface, franka_hw::FrankaStateInterface,
@@ -32,37 +50,71 @@ class JointPositionController
   void update(const ros::Time&, const ros::Duration& period) override;
 
  private:
+  using TrajectoryPtr = std::shared_ptr<const JointTrajectorySpline>;
+
   std::unique_ptr<franka_hw::FrankaStateHandle> state_handle_;
   std::unique_ptr<franka_hw::FrankaModelHandle> model_handle_;
 
   hardware_interface::PositionJointInterface* position_joint_interface_;
   std::vector<hardware_interface::JointHandle> position_joint_handles_;
 
+  ros::Subscriber trajectory_sub_;
+
+  /** \brief Latest trajectory from the subscriber, read by update().*/
+  realtime_tools::RealtimeBuffer<TrajectoryPtr> trajectory_buffer_;
+
+  /** \brief Trajectories the subscriber has handed over. The callback keeps a
+   * reference to them until the control loop has let go of its own, so that
+   * a trajectory is never freed from the control loop.*/
+  std::deque<TrajectoryPtr> handed_over_;
+
+  /** \brief State of the control loop, only touched by update().*/
+  TrajectoryPtr trajectory_;
+  /** \brief The trajectory last taken from the buffer, to tell a new one
+   * apart. Only compared, never dereferenced.*/
+  const JointTrajectorySpline* last_trajectory_ = nullptr;
   ros::Duration elapsed_time_;
-  std::array<double, 7> initial_pose_{};
+  std::size_t segment_ = 0;
+  std::array<double, 7> hold_pose_{};
+  ExecutionStatus status_;
 
-  ros::Subscriber trajectory_sub_;
-  trajectory_msgs::JointTrajectory joint_trajectory_;
-  std::size_t pt_idx_ = 0;
-  bool is_executing = false;
+  /** \brief Largest distance between the robot and the start of a new
+   * trajectory, in rad. Trajectories that start further away are rejected,
+   * since the first command would jump to the start within one cycle and
+   * trip the robot's discontinuity reflex.*/
+  double start_tolerance_ = 1e-3;
 
-  franka_hw::TriggerRate rate_trigger_{1.0};
+  franka_hw::TriggerRate rate_trigger_{30.0};
   realtime_tools::RealtimePublisher<TrajExecutionMonitor>
       trajectory_monitor_pub_;
 
-  int isRobotStateValid(const franka::RobotState& robot_state);
+  ExecutionMonitor execution_monitor_;
+
+  /** \brief Detects contacts from the external torques, which unlike the
+   * measured ones do not depend on the pose and speed of the robot.*/
+  ContactDetector contact_detector_;
+
+  /** \brief Advance the contact detector by one cycle. Called from update().
+    @return Whether a contact was detected since the trajectory started.
+  */
+  bool updateContactDetection(const franka::RobotState& robot_state,
+                              double period);
 
   void robotStateToMsg(const franka::RobotState& robot_state,
                        franka_msgs::FrankaState& franka_state_msg);
 
-  void trajectoryCallback(const trajectory_msgs::JointTrajectoryPtr& msg);
+  void trajectoryCallback(const trajectory_msgs::JointTrajectoryConstPtr& msg);
 
-  bool isApproxEqual(const std::array<double, 7>& a,
-                     const std::array<double, 7>& b, double tolerance = 1e-2);
+  /** \brief Switch to the trajectory from the buffer, if there is a new one.
+   * Called from update().*/
+  void pickUpTrajectory(const std::array<double, 7>& current_pose);
 
-  void reset();
+  /** \brief Publish the monitoring message at the publish rate, or right
+   * away if force is set. Called from update().*/
+  void publishStatus(const ros::Time& time,
+                     const franka::RobotState& robot_state, bool force);
 };
 
 }  // namespace tacbot
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,117 @@
+#ifndef TACBOT_JOINT_TRAJECTORY_SPLINE_H
+#define TACBOT_JOINT_TRAJECTORY_SPLINE_H
+
+// C++
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// ROS
+#include <trajectory_msgs/JointTrajectory.h>
+
+namespace tacbot {
+
+/** \class A cubic Hermite spline through the waypoints of a joint trajectory,
+ * from which the velocity can be evaluated at any time. The control loop of
+ * the robot runs at 1 kHz and its cycles are not always 1 ms apart, so rather
+ * than stepping through velocities that were sampled in advance, the
+ * controller evaluates the spline at the time that has actually passed.
+ *
+ * Evaluation does not allocate. Queries with increasing times, as made by the
+ * control loop, resume the segment search from the segment of the previous
+ * query, so each one takes constant time.
+ */
+class JointTrajectorySpline {
+ public:
+  using JointArray = std::array<double, 7>;
+
+  /** \brief Spline through the positions and velocities of the trajectory
+    points, at their time_from_start.
+    @param trajectory The trajectory of the 7 arm joints.
+    @param spline Set to the spline through the trajectory.
+    @return False if a point does not have a position for every joint, or a
+    velocity for every joint when it has any, in which case the spline is
+    left empty.
+  */
+  static bool fromTrajectory(const trajectory_msgs::JointTrajectory& trajectory,
+                             JointTrajectorySpline& spline);
+
+  /** \brief Spline through velocities sampled at a fixed period. The
+   * positions are integrated from zero with the trapezoidal rule, which is
+   * enough to shape the velocity between the samples.*/
+  static JointTrajectorySpline fromVelocities(
+      const std::vector<JointArray>& joint_velocities, double period = 0.001);
+
+  /** \brief Append a waypoint. Its time must be larger than the time of the
+   * previous waypoint.*/
+  void addPoint(double time, const JointArray& position,
+                const JointArray& velocity);
+
+  /** \brief Time of the last waypoint, zero if there is none.*/
+  double getDuration() const;
+
+  std::size_t size() const { return times_.size(); }
+
+  /** \brief Velocity at the given time, clamped to the first and the last
+    waypoint.
+    @param time Time since the start of the trajectory.
+    @param segment Index of the segment to start searching from. Updated to
+    the segment that contains the time, so it can be passed to the next query.
+    @return The joint velocities.
+  */
+  JointArray velocityAt(double time, std::size_t& segment) const;
+
+  /** \brief Position and velocity at the given time, clamped to the first and
+    the last waypoint. The segment is used as in velocityAt.
+  */
+  void sample(double time, std::size_t& segment, JointArray& position,
+              JointArray& velocity) const;
+
+  /** \brief Select the waypoints that have to be kept so that the spline
+    through them alone stays within the tolerances of this spline. Planned
+    trajectories are sampled densely by the time parameterization, yet most of
+    their waypoints lie on the spline through their neighbours. Each segment is
+    grown greedily for as long as the waypoints it skips, and the midpoints
+    between them, are reproduced.
+    @param position_tolerance Largest joint position error, in rad.
+    @param velocity_tolerance Largest joint velocity error, in rad/s.
+    @return Increasing indices of the waypoints to keep, including the first
+    and the last one.
+  */
+  std::vector<std::size_t> selectKnots(double position_tolerance,
+                                       double velocity_tolerance) const;
+
+  /** \brief The spline through the waypoints returned by selectKnots. It is
+   * evaluated like any other spline, so the control loop follows it without
+   * expanding it first.*/
+  JointTrajectorySpline compress(double position_tolerance,
+                                 double velocity_tolerance) const;
+
+  double getTime(std::size_t i) const { return times_[i]; }
+  const JointArray& getPosition(std::size_t i) const { return positions_[i]; }
+  const JointArray& getVelocity(std::size_t i) const { return velocities_[i]; }
+
+  /** \brief Position and velocity on the cubic Hermite segment from (q0, v0)
+    to (q1, v1).
+    @param h The duration of the segment, larger than zero.
+    @param t The time since the start of the segment.
+  */
+  static void evaluateSegment(const JointArray& q0, const JointArray& v0,
+                              const JointArray& q1, const JointArray& v1,
+                              double h, double t, JointArray& position,
+                              JointArray& velocity);
+
+ private:
+  /** \brief Whether a single segment from waypoint first to waypoint last
+   * stays within the tolerances of this spline.*/
+  bool fitsSegment(std::size_t first, std::size_t last,
+                   double position_tolerance,
+                   double velocity_tolerance) const;
+
+  std::vector<double> times_;
+  std::vector<JointArray> positions_;
+  std::vector<JointArray> velocities_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,79 @@
+#ifndef TACBOT_MANIPULABILITY_SAMPLER_H
+#define TACBOT_MANIPULABILITY_SAMPLER_H
+
+// C++
+#include <vector>
+
+// MoveIt
+#include <moveit/robot_model/joint_model_group.h>
+#include <moveit/robot_state/robot_state.h>
+
+// OMPL
+#include <ompl/base/StateSampler.h>
+#include <ompl/base/StateSpace.h>
+#include <ompl/util/RandomNumbers.h>
+
+// Eigen
+#include <Eigen/Core>
+
+namespace tacbot {
+
+/** \class A state sampler that steers uniform samples away from singular
+ * configurations. Paths through configurations where the end effector loses a
+ * direction of motion have to be executed slowly, so samples whose
+ * translational manipulability ellipsoid is thin are rejected with a
+ * probability that grows as the ellipsoid flattens.
+ *
+ * The ellipsoid is the 3x3 matrix J_v J_v^T of the translational rows of the
+ * Jacobian, so its eigenvalues come from the closed form solver for fixed size
+ * self-adjoint matrices rather than from a general eigen decomposition, as
+ * KinematicsMetrics does. A sample is never rejected outright: after a few
+ * attempts the best one is returned, so the sampler still covers the whole
+ * space.
+ */
+class ManipulabilitySampler : public ompl::base::StateSampler {
+ public:
+  struct Options {
+    /** \brief Smallest singular value of the translational Jacobian, in
+     * meters per radian, at and above which a sample is always accepted.*/
+    double min_singular_value = 0.05;
+
+    /** \brief Uniform samples drawn before the best one is returned.*/
+    std::size_t max_attempts = 8;
+  };
+
+  ManipulabilitySampler(const ompl::base::StateSpace* space,
+                        const moveit::core::RobotState& robot_state,
+                        const moveit::core::JointModelGroup* joint_model_group,
+                        const Options& options);
+
+  void sampleUniform(ompl::base::State* state) override;
+
+  void sampleUniformNear(ompl::base::State* state,
+                         const ompl::base::State* near,
+                         double distance) override;
+
+  void sampleGaussian(ompl::base::State* state, const ompl::base::State* mean,
+                      double std_dev) override;
+
+  /** \brief Smallest singular value of the translational Jacobian at a
+    configuration, zero at a singularity.
+    @param state A state of the joint space, in the group's joint order.
+    @return The square root of the smallest eigenvalue of J_v J_v^T.
+  */
+  double minSingularValue(const ompl::base::State* state);
+
+ private:
+  ompl::base::StateSamplerPtr uniform_sampler_;
+  moveit::core::RobotState robot_state_;
+  const moveit::core::JointModelGroup* joint_model_group_;
+  const moveit::core::LinkModel* tip_link_;
+  Options options_;
+  std::size_t dof_;
+  std::vector<double> joint_values_;
+  Eigen::MatrixXd jacobian_;
+  ompl::RNG rng_;
+};
+
+}  // namespace tacbot
+#endif
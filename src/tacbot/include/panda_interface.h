@@ -8,15 +8,21 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cmath>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <ruckig/ruckig.hpp>
+#include <thread>
 
 // #include "panda_sim_real_interface/JointDataArray.h"
 // #include <fstream>
 
 // #include <ruckig/ruckig.hpp>
 
+#include <kdl/chainfksolverpos_recursive.hpp>
 #include <kdl/chainiksolverpos_nr_jl.hpp>
 #include <kdl/chainiksolvervel_pinv.hpp>
 #include <kdl/frames.hpp>
@@ -24,6 +30,16 @@
 #include <kdl_parser/kdl_parser.hpp>
 #include <trac_ik/trac_ik.hpp>
 
+#include "control_backend.h"
+#include "contact_detector.h"
+#include "control_log.h"
+#include "cycle_timing.h"
+#include "execution_monitor.h"
+#include "gripper_executor.h"
+#include "joint_trajectory_spline.h"
+#include "trajectory_channel.h"
+#include "trajectory_log.h"
+
 #ifndef SUCCESS_JOINT_ANGLES_H
 #define SUCCESS_JOINT_ANGLES_H
 struct successJointAngles {
@@ -44,20 +60,96 @@ class PandaInterface {
   void init();
 
   std::array<double, 7> fk(std::array<double, 7> q);
-  successJointAngles ik(std::array<double, 7> ee_pose, KDL::Tree tree);
+  successJointAngles ik(std::array<double, 7> ee_pose, const KDL::Tree &tree);
   successJointAngles ik(std::array<double, 7> ee_pose);
   void set_joint_and_collision_behaviour(franka::Robot *robot);
   void move_to_default_pose(franka::Robot *robot);
   void move_to_joint_angles(franka::Robot *robot, std::array<double, 7> q_goal);
   int get_closest_time(float time, std::vector<double> time_list);
-  void follow_joint_waypoints(
+  /* Move to the first waypoint, then follow the others as below.*/
+  bool follow_joint_waypoints(
       franka::Robot *robot, std::vector<std::array<double, 7>> joint_waypoints,
-      double speed_factor);
-  void move_down_and_interact(franka::Robot *robot, franka::Gripper *gripper,
+      double speed_factor, double tolerance = 1e-3);
+  /* Pass through the waypoints without stopping at them, starting from the
+   * first one. Waypoints closer than the tolerance to the previous one are
+   * skipped.*/
+  bool follow_joint_waypoints(
+      tacbot::ControlBackend &robot,
+      const std::vector<std::array<double, 7>> &joint_waypoints,
+      double speed_factor, double tolerance = 1e-3);
+  /* Move to the first waypoint of a planned trajectory, then pass through its
+   * waypoints with the velocities the plan has at them, as below.*/
+  bool follow_joint_waypoints(franka::Robot *robot,
+                              const tacbot::JointTrajectorySpline &trajectory,
+                              double speed_factor, double tolerance = 1e-3);
+  /* Pass through the waypoints with the given velocities, e.g. those of a time
+   * parameterized plan, starting from the first one.*/
+  bool follow_joint_waypoints(
+      tacbot::ControlBackend &robot,
+      const std::vector<std::array<double, 7>> &joint_waypoints,
+      const std::vector<std::array<double, 7>> &joint_velocities,
+      double speed_factor, double tolerance = 1e-3);
+  /* One jerk limited Ruckig segment between each pair of waypoints. Interior
+   * waypoints are passed with a velocity that the joints can still brake
+   * from within the neighbouring segments, under the velocity and
+   * acceleration limits of MotionGenerator for the speed factor. If a segment
+   * cannot reach its end waypoint with that velocity, the robot stops at the
+   * waypoint instead.
+   * @return false if a segment cannot be planned even then.*/
+  bool plan_blended_waypoints(
+      const std::vector<std::array<double, 7>> &joint_waypoints,
+      double speed_factor, double tolerance,
+      std::vector<ruckig::Trajectory<7>> &segments);
+  /* As above, but interior waypoints are passed with the planned velocities,
+   * clamped to the velocity limits of MotionGenerator. The first and the last
+   * waypoint are at rest.
+   * @param joint_velocities One velocity per waypoint, or none to choose them
+   * as above.
+   * @return false also if the numbers of waypoints and velocities differ.*/
+  bool plan_blended_waypoints(
+      const std::vector<std::array<double, 7>> &joint_waypoints,
+      const std::vector<std::array<double, 7>> &joint_velocities,
+      double speed_factor, double tolerance,
+      std::vector<ruckig::Trajectory<7>> &segments);
+  /* Move the end-effector down by the height, grasp (interaction) or release
+   * the object, and move back up. The gripper opens on a worker thread while
+   * the arm moves down to grasp, or up after releasing.
+   * @return false if a motion or a gripper command failed.*/
+  bool move_down_and_interact(franka::Robot *robot, franka::Gripper *gripper,
                               float height, double object_width,
                               bool interaction);
+  /* The executor that runs the gripper's commands asynchronously. It is
+   * created on first use, and recreated for a different gripper.*/
+  tacbot::GripperExecutor &get_gripper_executor(franka::Gripper *gripper);
   bool move(franka::Robot *robot, std::array<double, 7> current_joint_angles,
             std::array<double, 7> target_joint_angles);
+  bool move(tacbot::ControlBackend &robot,
+            std::array<double, 7> current_joint_angles,
+            std::array<double, 7> target_joint_angles);
+  /* Move to the target along a jerk limited trajectory that Ruckig updates in
+   * every control cycle. The target can be replaced with set_online_target
+   * while the robot moves and the new trajectory starts from the current
+   * state in the next cycle, without stopping first. A target with a
+   * velocity is passed at that velocity, and the robot then comes to rest.
+   * Returns once the robot is at rest, false if it had to stop because no
+   * trajectory to the last valid target could be computed.*/
+  bool move_online(franka::Robot *robot, std::array<double, 7> target_q);
+  bool move_online(tacbot::ControlBackend &robot,
+                   std::array<double, 7> target_q);
+  /* Replace the target of a running move_online, or leave the trajectory of
+   * a running move_with_velocity_control for the target. Can be called from
+   * one thread besides the control loop, e.g. the planner's.*/
+  void set_online_target(const std::array<double, 7> &target_q,
+                         const std::array<double, 7> &target_q_vel = {});
+  /* Run the control loop on the segments sent through
+   * get_trajectory_channel(), until a FINISH command has been sent and the
+   * robot is at rest. Segments can be sent from another thread while it
+   * runs.*/
+  bool follow_trajectory_channel(franka::Robot *robot);
+  bool follow_trajectory_channel(tacbot::ControlBackend &robot);
+  tacbot::TrajectoryChannel &get_trajectory_channel() {
+    return trajectory_channel_;
+  }
   std::tuple<ruckig::Trajectory<7>, bool> generate_trajectory(
       ruckig::InputParameter<7> input);
   ruckig::InputParameter<7> get_ruckig_input(
@@ -78,10 +170,21 @@ class PandaInterface {
       ruckig::InputParameter<6> input);
   bool move_with_velocity_control(
       franka::Robot *robot,
-      std::vector<std::array<double, 7>> joint_velocities);
+      const std::vector<std::array<double, 7>> &joint_velocities);
+  /* Command the velocity of the trajectory, evaluated at the time that has
+   * passed according to the control loop. A target set with
+   * set_online_target during the motion replaces the rest of the trajectory,
+   * and the robot moves to it as in move_online.*/
+  bool move_with_velocity_control(
+      franka::Robot *robot, const tacbot::JointTrajectorySpline &trajectory);
+  bool move_with_velocity_control(
+      tacbot::ControlBackend &robot,
+      const tacbot::JointTrajectorySpline &trajectory);
   void follow_joint_velocities(
       franka::Robot *robot,
-      std::vector<std::array<double, 7>> joint_velocities);
+      const std::vector<std::array<double, 7>> &joint_velocities);
+  void follow_joint_trajectory(franka::Robot *robot,
+                               const tacbot::JointTrajectorySpline &trajectory);
   bool allCloseZero(const std::array<double, 7> &arr, double tolerance);
   void move_failure(franka::Robot *robot, ruckig::Trajectory<5> *trajectory,
                     int failure_mode,
@@ -112,4 +215,102 @@ class PandaInterface {
                                std::array<double, NUM_STEPS>,
                                std::array<double, 2>, int> *trajectory_data);
   void cleanup(franka::Robot *robot, franka::Gripper *gripper);
+
+  /* Record the state of the robot in every control cycle of the following
+   * motions to a CSV file, until stop_control_log is called.*/
+  bool start_control_log(const std::string &path);
+  void stop_control_log();
+
+  /* Timing of the control cycles of the last motion. Every control routine
+   * resets it before and prints a summary after the motion.*/
+  tacbot::CycleTimer &get_cycle_timer() { return cycle_timer_; }
+
+  /* Publish the progress of move_with_velocity_control, and where it failed,
+   * to the monitor. The monitor must have been opened and outlive the
+   * motions, nullptr stops publishing.*/
+  void set_execution_monitor(tacbot::ExecutionMonitor *monitor);
+
+  /* Run a ContactDetector in the control loop of move_with_velocity_control.
+   * A detected contact is published with the execution status in the same
+   * cycle. Needs the robot model, i.e. init().*/
+  void enable_contact_detection(
+      const tacbot::ContactDetector::Options &options = {});
+  void disable_contact_detection();
+
+ private:
+  /* Queue one control cycle for the control log. Safe to call from the
+   * control callback.*/
+  void log_control_sample(const franka::RobotState &robot_state, double time,
+                          double period, const std::array<double, 7> &command);
+
+  tacbot::ControlLogger control_logger_;
+  tacbot::CycleTimer cycle_timer_;
+
+  /* Fill in the status from the robot state and publish it, if there is an
+   * execution monitor. Safe to call from the control callback.*/
+  void publish_execution_status(tacbot::ExecutionStatus &status,
+                                const franka::RobotState &robot_state,
+                                double time, std::size_t pt_idx,
+                                tacbot::ExecutionStatus::State state);
+
+  tacbot::ExecutionMonitor *execution_monitor_ = nullptr;
+
+  /* Wait for a gripper command and log why it failed, if it did.*/
+  bool wait_for_gripper(std::future<bool> &result, const std::string &action);
+
+  std::unique_ptr<tacbot::GripperExecutor> gripper_executor_;
+
+  /* Advance the contact detector, if it is enabled, and copy a detected
+   * contact into the status. Safe to call from the control callback.*/
+  void update_contact_detection(const franka::RobotState &robot_state,
+                                double period, tacbot::ExecutionStatus &status);
+
+  tacbot::ContactDetector contact_detector_;
+  bool contact_detection_ = false;
+
+  struct JointTarget {
+    std::array<double, 7> q{};
+    std::array<double, 7> dq{};
+  };
+
+  /* Targets handed from set_online_target to the control loop.*/
+  tacbot::SpscRingBuffer<JointTarget> online_targets_{16};
+
+  tacbot::TrajectoryChannel trajectory_channel_;
+
+  /* FK and IK solvers of one thread. Neither solver may be shared between
+   * threads, so every thread that calls fk or ik gets its own pair. They are
+   * built on their own copy of the chain, which outlives them.*/
+  struct KinematicSolvers {
+    KDL::Chain chain;
+    std::unique_ptr<KDL::ChainFkSolverPos_recursive> fk_solver;
+    std::unique_ptr<TRAC_IK::TRAC_IK> ik_solver;
+  };
+
+  /* Parse the URDF into tree_ and chain_, once. Called by init, and by the
+   * first fk or ik call if init was not. Must be called with
+   * kinematics_mutex_ held. A failed parse is not retried.*/
+  void init_kinematics();
+
+  /* The solvers of the calling thread, null if the URDF could not be parsed.
+   * They are kept in thread local storage, so they are freed when the thread
+   * exits. The caller shares ownership, so they stay valid however long it
+   * uses them.*/
+  std::shared_ptr<KinematicSolvers> get_solvers();
+
+  KDL::Tree tree_;
+  KDL::Chain chain_;
+  KDL::JntArray ik_lower_limits_;
+  KDL::JntArray ik_upper_limits_;
+
+  std::mutex kinematics_mutex_;
+
+  /* Tells apart the solvers of the PandaInterfaces in a thread's storage,
+   * unlike the address, which a later object may reuse.*/
+  static std::atomic<std::uint64_t> next_kinematics_id_;
+  const std::uint64_t kinematics_id_ = next_kinematics_id_++;
+
+  /* Whether init_kinematics has run, and whether the URDF was parsed.*/
+  bool kinematics_loaded_ = false;
+  bool kinematics_ok_ = false;
 };
\ No newline at end of file
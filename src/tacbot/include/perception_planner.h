@@ -1,9 +1,14 @@
 #ifndef TACBOT_PERCEPTION_PLANNER_H
 #define TACBOT_PERCEPTION_PLANNER_H
 
+#include <ompl/multilevel/datastructures/Projection.h>
+
 #include "base_planner.h"
 #include "contact_perception.h"
+#include "field_engine.h"
+#include "field_grid_cache.h"
 #include "my_moveit_context.h"
+#include "planner_registry.h"
 #include "utilities.h"
 
 namespace tacbot {
@@ -20,16 +25,82 @@ class PerceptionPlanner : public BasePlanner {
 
   void init() override;
 
+  /** \brief Initialize the planner from robot description files, without
+   * ROS. The obstacles are added to the planning scene directly instead of
+   * being published through ContactPerception.*/
+  void init(const std::string& urdf_path,
+            const std::string& srdf_path) override;
+
   void setGoalState(std::size_t option);
 
   void setObstacleScene(std::size_t option);
 
+  /** \brief Levels of detail and point budget of the robot surface points.
+   * Takes effect right away, the fields cached for the old points are
+   * dropped.*/
+  void setSurfaceOptions(const FieldEngine::Options& options) {
+    field_engine_.setOptions(options);
+    scene_version_++;
+  }
+
   std::vector<tacbot::ObstacleGroup> getObstacles() { return obstacles_; };
 
+  /** \brief The reduced models that QRRTStar plans on below the full robot,
+    ordered from the coarsest level up. Each level is loaded once, from the
+    parameter robot_description_<dof>link, and is reused by every following
+    changePlanner().
+    @param bundle_dofs The number of joints of each reduced model, increasing
+    and smaller than the joints of the full robot, e.g. {3, 5}.
+  */
+  void setBundleHierarchy(const std::vector<std::size_t>& bundle_dofs);
+
+  /** \brief Load the reduced models of the bundle hierarchy on first use and
+   * point each of their contexts at the start, goal and scene of the current
+   * request.*/
   void createPandaBundleContext();
 
  protected:
-  std::shared_ptr<MyMoveitContext> pandaBundleContext_;
+  /** \brief The planners that changePlanner() can select.*/
+  static const PlannerRegistry<PerceptionPlanner>& registry();
+
+  /** \brief Surface points, link bounding spheres and the obstacle index,
+   * with the field shaping of the selected planner.*/
+  FieldEngine field_engine_;
+
+  /** \brief One reduced model of the bundle hierarchy. The loader, monitor
+   * and context are created once, the projection onto the level below is
+   * rebuilt only when one of the two state spaces changes.*/
+  struct BundleLevel {
+    std::size_t dof = 0;
+    robot_model_loader::RobotModelLoaderPtr robot_model_loader;
+    planning_scene_monitor::PlanningSceneMonitorPtr psm;
+    const moveit::core::JointModelGroup* joint_model_group = nullptr;
+    std::shared_ptr<MyMoveitContext> context;
+
+    /** \brief Projection from the level above onto this one, and the two
+     * spaces it was made for.*/
+    ompl::multilevel::ProjectionPtr projection;
+    ompl::base::StateSpacePtr bundle_space;
+    ompl::base::StateSpacePtr base_space;
+  };
+
+  /** \brief Load the reduced model with the given number of joints and start
+   * monitoring its scene.*/
+  BundleLevel loadBundleLevel(std::size_t dof);
+
+  /** \brief The request of the current query, cut down to the joints of the
+   * given level.*/
+  planning_interface::MotionPlanRequest createBundleRequest(
+      const BundleLevel& level);
+
+  /** \brief Space informations and projections of the bundle hierarchy, with
+   * the full robot's space on top, as QRRTStar takes them.*/
+  void getBundleSpaces(const ompl::base::SpaceInformationPtr& si,
+                       std::vector<ompl::base::SpaceInformationPtr>& si_vec,
+                       std::vector<ompl::multilevel::ProjectionPtr>& proj_vec);
+
+  std::vector<std::size_t> bundle_dofs_{5};
+  std::vector<BundleLevel> bundle_levels_;
 
   std::vector<tacbot::ObstacleGroup> obstacles_;
 
@@ -52,9 +123,14 @@ class PerceptionPlanner : public BasePlanner {
   std::vector<Eigen::Vector3d> sim_obstacle_pos_;
 
   /** \brief The class that handles point cloud processing of the surrounding
-   * environment and transfers this information to the planner.*/
+   * environment and transfers this information to the planner. Only created
+   * by the ROS initialization.*/
   std::shared_ptr<ContactPerception> contact_perception_;
 
+  /** \brief Collision checker, goal and obstacle set up shared by both
+   * initializations.*/
+  void initScene();
+
   void addPointObstacles(tacbot::ObstacleGroup& obstacle);
 
   void setCollisionChecker(std::string collision_checker_name);
@@ -65,6 +141,23 @@ class PerceptionPlanner : public BasePlanner {
 
   void sphericalCollisionPermission(bool is_allowed);
 
+  /** \brief Rebuild the allowed collision matrix that is used to measure
+   * contact. It is a copy of the scene's matrix in which the obstacles are not
+   * allowed to collide, so contacts with them are reported without having to
+   * toggle the shared scene matrix for every cost evaluation.*/
+  void updateContactAcm();
+
+  /** \brief Contact costs are measured against contact_acm_ under a read lock
+   * of the planning scene and can be evaluated concurrently.*/
+  bool isCostThreadSafe() const override { return true; }
+
+  collision_detection::AllowedCollisionMatrix contact_acm_;
+
+  /** \brief Contact cost and per link contact depth over the joint space,
+   * shared by the threads that evaluate costs.*/
+  FieldGridCache contact_cost_grid_;
+  FieldGridCache contact_field_grid_;
+
   bool findObstacleByName(const std::string& name,
                           tacbot::ObstacleGroup& obstacle);
 
@@ -76,14 +169,12 @@ class PerceptionPlanner : public BasePlanner {
   Eigen::VectorXd obstacleField(const ompl::base::State* rand_state);
 
   std::vector<Eigen::Vector3d> getLinkToObsVec(
-      const std::vector<std::vector<Eigen::Vector3d>>& rob_pts);
-  void extractPtsFromModel(const moveit::core::RobotStatePtr& robot_state,
-                           const moveit::core::LinkModel* link_model,
-                           std::vector<Eigen::Vector3d>& link_pts,
-                           std::size_t& num_pts);
+      const std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+      const std::vector<BoundingSphere>& link_spheres);
   std::size_t getPtsOnRobotSurface(
       const moveit::core::RobotStatePtr& robot_state,
-      std::vector<std::vector<Eigen::Vector3d>>& rob_pts);
+      std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+      std::vector<BoundingSphere>& link_spheres);
   Eigen::VectorXd obstacleFieldCartesian(const ompl::base::State* near_state,
                                          const ompl::base::State* rand_state);
   Eigen::VectorXd getRobtPtsVecDiffAvg(
@@ -0,0 +1,136 @@
+#ifndef TACBOT_PLANNER_REGISTRY_H
+#define TACBOT_PLANNER_REGISTRY_H
+
+// C++
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// OMPL
+#include <ompl/base/OptimizationObjective.h>
+#include <ompl/base/Planner.h>
+#include <ompl/geometric/SimpleSetup.h>
+
+// Eigen
+#include <Eigen/Core>
+
+namespace tacbot {
+
+/** \brief How the repulsive vector between a point on the robot and an
+ * obstacle point is shaped. These used to be decided by comparing the planner
+ * name on every call, they are now resolved once when the planner is changed.*/
+struct FieldParams {
+  enum class Kernel {
+    NORMALIZED,
+    INVERSE_SQUARE,
+  };
+
+  /** \brief Squared distance beyond which an obstacle does not repel.*/
+  double prox_radius = 0.02;
+
+  /** \brief Peak and falloff of the inverse square kernel.*/
+  double y_max = 3.0;
+  double falloff = 50.0;
+
+  /** \brief Whether the repulsion is blended with the direction towards the
+   * robot's goal configuration.*/
+  bool use_goal_attractor = false;
+
+  Kernel kernel = Kernel::NORMALIZED;
+
+  /** \brief Scale the vector based on how close it is to an obstacle.
+    @param vec The difference between a point on the robot and an obstacle.
+    @return The scaled vector, zero outside of the proximity radius.
+  */
+  Eigen::Vector3d scale(const Eigen::Vector3d& vec) const {
+    if (vec.squaredNorm() > prox_radius) {
+      return Eigen::Vector3d::Zero();
+    }
+    switch (kernel) {
+      case Kernel::INVERSE_SQUARE:
+        return inverseSquareKernel(vec);
+      case Kernel::NORMALIZED:
+      default:
+        return normalizedKernel(vec);
+    }
+  }
+
+  /** \brief Unit vector, the magnitude does not depend on the distance.*/
+  static Eigen::Vector3d normalizedKernel(const Eigen::Vector3d& vec);
+
+  /** \brief y_max / (falloff * d^2 + 1) along the vector.*/
+  Eigen::Vector3d inverseSquareKernel(const Eigen::Vector3d& vec) const;
+};
+
+/** \brief The field functions that an objective was built on. Planners that
+ * extend along a vector field reuse them so the planner and the objective
+ * agree on the field.*/
+struct FieldFunctions {
+  std::function<Eigen::VectorXd(const ompl::base::State*)> state_field;
+  std::function<Eigen::VectorXd(const ompl::base::State*,
+                                const ompl::base::State*)>
+      motion_field;
+};
+
+/** \class Name to factory lookup for the planners and optimization objectives
+ * a planning class supports. Each planning class fills its registry once, the
+ * factories receive the planning class so they can bind its field and cost
+ * functions. changePlanner() then does a single lookup instead of walking a
+ * chain of string comparisons, and the FieldParams of the chosen planner are
+ * stored so that nothing on the per-sample path looks at the name again.
+ */
+template <typename Owner>
+class PlannerRegistry {
+ public:
+  struct ObjectiveEntry {
+    std::function<FieldFunctions(Owner&)> fields;
+    std::function<ompl::base::OptimizationObjectivePtr(
+        const ompl::base::SpaceInformationPtr&, const FieldFunctions&)>
+        create;
+  };
+
+  struct PlannerEntry {
+    /** \brief Create the planner. The factory may also set the optimization
+     * objective on the simple setup when the planner dictates it.*/
+    std::function<ompl::base::PlannerPtr(
+        Owner&, const ompl::geometric::SimpleSetupPtr&, const FieldFunctions&)>
+        create;
+    FieldParams field_params;
+  };
+
+  void addObjective(const std::string& name, const ObjectiveEntry& entry) {
+    objectives_[name] = entry;
+  }
+
+  void addPlanner(const std::string& name, const PlannerEntry& entry) {
+    planners_[name] = entry;
+  }
+
+  /** \brief @return nullptr if no objective is registered under the name.*/
+  const ObjectiveEntry* findObjective(const std::string& name) const {
+    auto it = objectives_.find(name);
+    return it == objectives_.end() ? nullptr : &it->second;
+  }
+
+  /** \brief @return nullptr if no planner is registered under the name.*/
+  const PlannerEntry* findPlanner(const std::string& name) const {
+    auto it = planners_.find(name);
+    return it == planners_.end() ? nullptr : &it->second;
+  }
+
+  std::vector<std::string> plannerNames() const {
+    std::vector<std::string> names;
+    for (const auto& planner : planners_) {
+      names.emplace_back(planner.first);
+    }
+    return names;
+  }
+
+ private:
+  std::map<std::string, ObjectiveEntry> objectives_;
+  std::map<std::string, PlannerEntry> planners_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,108 @@
+#ifndef TACBOT_PLANNING_SCENE_HANDLE_H
+#define TACBOT_PLANNING_SCENE_HANDLE_H
+
+// C++
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+
+// MoveIt
+#include <moveit/planning_scene/planning_scene.h>
+#include <moveit/planning_scene_monitor/planning_scene_monitor.h>
+
+namespace tacbot {
+
+/** \class Scoped access to the planning scene a planner works in. When the
+ * planner is initialized through ROS the scene lives in a
+ * PlanningSceneMonitor and the locks are the monitor's own. When it is
+ * initialized from files there is no monitor and the handle guards a plain
+ * PlanningScene with a reader/writer mutex, so the planning code does not need
+ * to know which of the two it is running with.
+ *
+ * Usage mirrors LockedPlanningSceneRO/RW, the lock is held for as long as the
+ * returned object lives:
+ *   scene_handle_.read()->getCurrentState();
+ *   scene_handle_.write()->getAllowedCollisionMatrixNonConst();
+ */
+class PlanningSceneHandle {
+ public:
+  class ReadLock {
+   public:
+    operator const planning_scene::PlanningSceneConstPtr&() const {
+      return scene_;
+    }
+    const planning_scene::PlanningSceneConstPtr& operator->() const {
+      return scene_;
+    }
+
+   private:
+    friend class PlanningSceneHandle;
+    std::optional<planning_scene_monitor::LockedPlanningSceneRO> monitor_lock_;
+    std::shared_lock<std::shared_mutex> lock_;
+    planning_scene::PlanningSceneConstPtr scene_;
+  };
+
+  class WriteLock {
+   public:
+    operator const planning_scene::PlanningScenePtr&() const { return scene_; }
+    const planning_scene::PlanningScenePtr& operator->() const {
+      return scene_;
+    }
+
+   private:
+    friend class PlanningSceneHandle;
+    std::optional<planning_scene_monitor::LockedPlanningSceneRW> monitor_lock_;
+    std::unique_lock<std::shared_mutex> lock_;
+    planning_scene::PlanningScenePtr scene_;
+  };
+
+  PlanningSceneHandle() = default;
+
+  explicit PlanningSceneHandle(
+      const planning_scene_monitor::PlanningSceneMonitorPtr& psm)
+      : psm_(psm) {}
+
+  explicit PlanningSceneHandle(const planning_scene::PlanningScenePtr& scene)
+      : scene_(scene), mutex_(std::make_shared<std::shared_mutex>()) {}
+
+  ReadLock read() const {
+    ReadLock lock;
+    if (psm_) {
+      lock.monitor_lock_.emplace(psm_);
+      lock.scene_ = *lock.monitor_lock_;
+    } else {
+      lock.lock_ = std::shared_lock<std::shared_mutex>(*mutex_);
+      lock.scene_ = scene_;
+    }
+    return lock;
+  }
+
+  WriteLock write() const {
+    WriteLock lock;
+    if (psm_) {
+      lock.monitor_lock_.emplace(psm_);
+      lock.scene_ = *lock.monitor_lock_;
+    } else {
+      lock.lock_ = std::unique_lock<std::shared_mutex>(*mutex_);
+      lock.scene_ = scene_;
+    }
+    return lock;
+  }
+
+  /** \brief The scene itself, without taking a lock. For handing the scene to
+   * components that do their own locking, such as the planning context.*/
+  planning_scene::PlanningScenePtr getPlanningScene() const {
+    return psm_ ? psm_->getPlanningScene() : scene_;
+  }
+
+  bool hasMonitor() const { return psm_ != nullptr; }
+
+ private:
+  planning_scene_monitor::PlanningSceneMonitorPtr psm_;
+  planning_scene::PlanningScenePtr scene_;
+  std::shared_ptr<std::shared_mutex> mutex_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,91 @@
+#ifndef TACBOT_SIMULATED_ROBOT_H
+#define TACBOT_SIMULATED_ROBOT_H
+
+// C++
+#include <array>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "control_backend.h"
+
+namespace tacbot {
+
+/** \class A stand-in for a Panda that runs the control loop locally. The
+ * commanded joint velocities are integrated into the joint positions, and
+ * cycles can be dropped at random to emulate network jitter, in which case
+ * the callback sees a period of several milliseconds just as it would on the
+ * real robot.
+ *
+ * Every call of the callback is timed. A call that takes longer than the
+ * deadline counts as a missed deadline and delays the next cycle by one
+ * period. The statistics make it possible to measure execution routines
+ * without hardware.
+ */
+class SimulatedRobot : public ControlBackend {
+ public:
+  struct Options {
+    std::array<double, 7> initial_q = {0, -0.785398, 0, -2.356194,
+                                       0, 1.570796,  0.785398};
+
+    /** \brief Probability that a cycle is lost and the next callback is
+     * called after 2 ms or more.*/
+    double missed_cycle_probability = 0.0;
+
+    /** \brief Upper bound on the cycles that are lost in a row.*/
+    std::size_t max_missed_cycles = 1;
+
+    /** \brief Time in seconds a callback may take.*/
+    double deadline = 0.001;
+
+    /** \brief Wait out the remaining time of each cycle, for routines that
+     * interact with other threads in real time. Otherwise the loop runs as
+     * fast as possible.*/
+    bool real_time = false;
+
+    /** \brief The control loop is stopped after this many cycles.*/
+    std::size_t max_cycles = 600000;
+
+    unsigned int seed = 0;
+  };
+
+  struct Stats {
+    std::size_t cycles = 0;
+    std::size_t missed_cycles = 0;
+    std::size_t missed_deadlines = 0;
+
+    /** \brief Cycles in which a commanded joint acceleration exceeded the
+     * Panda's limits, which would trigger a reflex on the real robot.*/
+    std::size_t acceleration_violations = 0;
+
+    /** \brief Compute time percentiles of the callback, in seconds.*/
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+  };
+
+  SimulatedRobot();
+  explicit SimulatedRobot(const Options& options);
+
+  franka::RobotState readOnce() override { return state_; }
+
+  void control(JointVelocityCallback callback) override;
+
+  /** \brief Statistics of the last control loop.*/
+  Stats getStats() const;
+
+  /** \brief Move the robot to the given position, at rest.*/
+  void setJointPositions(const std::array<double, 7>& q);
+
+ private:
+  Options options_;
+  franka::RobotState state_;
+  std::mt19937 rng_;
+
+  std::vector<double> compute_times_;
+  Stats stats_;
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,142 @@
+#ifndef TACBOT_TRAJECTORY_CHANNEL_H
+#define TACBOT_TRAJECTORY_CHANNEL_H
+
+// C++
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "control_log.h"
+#include "joint_trajectory_spline.h"
+
+namespace tacbot {
+
+/** \brief A command sent to a running control loop.*/
+struct TrajectoryCommand {
+  enum class Type {
+    /** \brief Queue a segment after the segments that are already queued.*/
+    APPEND,
+    /** \brief Drop the queued segments and start this one from the current
+     * commanded state.*/
+    REPLACE,
+    /** \brief Drop the queued segments and come to rest.*/
+    STOP,
+    /** \brief End the control loop once the queued segments are done and the
+     * robot is at rest.*/
+    FINISH
+  };
+
+  Type type = Type::APPEND;
+
+  /** \brief The segment ends in (q, dq) after duration seconds. It is a cubic
+   * Hermite curve from the state at which it starts. Segments whose duration
+   * is not positive are dropped.*/
+  double duration = 0.0;
+  std::array<double, 7> q{};
+  std::array<double, 7> dq{};
+};
+
+/** \class Hands trajectory segments from a planning or perception thread to a
+ * control loop that is already running. The planner calls send, the control
+ * callback calls update once per cycle. The two sides only share a
+ * SpscRingBuffer, so neither waits for the other, and the callback reads at
+ * most max_commands_per_cycle commands per cycle so its work is bounded.
+ * All storage is allocated at construction.
+ *
+ * Segments are chained: each one starts where and when the previous one
+ * ends, also within a cycle, so the segments take their planned time. If the
+ * queue runs dry while the robot still moves, the channel brings it to rest
+ * instead of holding a velocity.
+ */
+class TrajectoryChannel {
+ public:
+  using JointArray = std::array<double, 7>;
+
+  struct Options {
+    std::size_t capacity = 1024;
+    std::size_t max_commands_per_cycle = 16;
+
+    /** \brief Deceleration used to come to rest, in rad/s^2.*/
+    double stop_acceleration = 2.0;
+  };
+
+  TrajectoryChannel();
+  explicit TrajectoryChannel(const Options& options);
+
+  /** \brief Called by the producer.
+    @return false if the channel is full; the command was not sent.
+  */
+  bool send(const TrajectoryCommand& command);
+
+  /** \brief Send the waypoints of a trajectory as segments, waiting while the
+    channel is full. The first waypoint is taken as the start and is not
+    sent.
+    @param replace Whether the trajectory replaces the queued segments.
+  */
+  void sendTrajectory(const JointTrajectorySpline& trajectory, bool replace);
+
+  /** \brief Called by the consumer before the first update, with the
+   * position the robot rests at. Commands that were already sent are kept
+   * and start from there.*/
+  void reset(const JointArray& q);
+
+  /** \brief Called by the consumer once per cycle. Reads the pending
+    commands and advances along the segments.
+    @param period Time since the previous cycle.
+    @return The commanded velocity.
+  */
+  const JointArray& update(double period);
+
+  /** \brief Whether a FINISH command was received and there is no motion
+   * left.*/
+  bool isFinished() const;
+
+  /** \brief Whether there is no segment to follow.*/
+  bool isIdle() const { return !active_; }
+
+  const JointArray& getPosition() const { return position_; }
+
+ private:
+  struct Segment {
+    JointArray q0{};
+    JointArray v0{};
+    JointArray q1{};
+    JointArray v1{};
+    double duration = 0.0;
+  };
+
+  void handle(const TrajectoryCommand& command);
+
+  /** \brief Start a segment from the current commanded state.
+    @param start_time The time already spent in the segment, what is left of
+    the cycle in which the previous segment ended.
+  */
+  void begin(const JointArray& q1, const JointArray& v1, double duration,
+             double start_time = 0.0);
+
+  /** \brief Start the segment that brings the robot to rest.*/
+  void beginStop(double start_time = 0.0);
+
+  bool allZero(const JointArray& values) const;
+
+  Options options_;
+  SpscRingBuffer<TrajectoryCommand> channel_;
+
+  /** \brief Segments received but not started, a ring over preallocated
+   * storage that only the consumer touches.*/
+  std::vector<TrajectoryCommand> pending_;
+  std::size_t pending_head_ = 0;
+  std::size_t pending_size_ = 0;
+
+  Segment segment_;
+  bool active_ = false;
+  double elapsed_ = 0.0;
+  bool finish_requested_ = false;
+
+  JointArray position_{};
+  JointArray velocity_{};
+};
+
+}  // namespace tacbot
+#endif
@@ -0,0 +1,96 @@
+#ifndef TACBOT_TRAJECTORY_LOG_H
+#define TACBOT_TRAJECTORY_LOG_H
+
+// C++
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ROS
+#include <trajectory_msgs/JointTrajectory.h>
+
+namespace tacbot {
+
+/** \class A joint trajectory or execution log stored by column: the times of
+ * all samples, then their positions, velocities and accelerations.
+ *
+ * The binary file is a 64 byte header followed by the four columns as
+ * doubles, time with one value per sample and q, dq and ddq
+ * with seven values per sample. Every column starts at a multiple of eight
+ * bytes, so the file can be memory-mapped and each column viewed in place,
+ * e.g. with numpy.memmap, see scripts/trajectory_log.py. All numbers, in the
+ * header and the columns, are little endian whatever the host, as are the
+ * NumPy files.
+ *
+ * Header layout:
+ *   char[8]  magic "TBTRAJ01"
+ *   uint64   number of samples
+ *   uint64   number of joints, always 7
+ *   uint64   byte offsets of the time, q, dq and ddq columns
+ *   uint64   reserved
+ */
+class TrajectoryLog {
+ public:
+  using JointArray = std::array<double, 7>;
+
+  static constexpr std::size_t HEADER_SIZE = 64;
+
+  void reserve(std::size_t num_samples);
+
+  void addSample(double time, const JointArray& q, const JointArray& dq,
+                 const JointArray& ddq);
+
+  /** \brief Append the points of a trajectory, with their time_from_start
+   * shifted to follow the last sample. The start point is skipped when the
+   * log is not empty, as it repeats the last sample. Missing velocities and
+   * accelerations are zero.*/
+  void addTrajectory(const trajectory_msgs::JointTrajectory& trajectory);
+
+  std::size_t size() const { return time_.size(); }
+  void clear();
+
+  const std::vector<double>& getTime() const { return time_; }
+  const std::vector<double>& getPositions() const { return q_; }
+  const std::vector<double>& getVelocities() const { return dq_; }
+  const std::vector<double>& getAccelerations() const { return ddq_; }
+
+  /** \brief Write the binary format.
+    @return false if the file could not be written.
+  */
+  bool save(const std::string& path) const;
+
+  /** \brief Read a file written by save.
+    @return false if the file could not be read or is not a trajectory log.
+  */
+  bool load(const std::string& path);
+
+  /** \brief Write each column to its own NumPy file, <prefix>time.npy,
+    <prefix>q.npy, <prefix>dq.npy and <prefix>ddq.npy, with shapes (N,) and
+    (N, 7).
+    @return false if a file could not be written.
+  */
+  bool exportNpy(const std::string& prefix) const;
+
+ private:
+  std::vector<double> time_;
+  std::vector<double> q_;
+  std::vector<double> dq_;
+  std::vector<double> ddq_;
+};
+
+/** \brief Write a C-ordered array in the NumPy .npy format, version 1.0.
+  @param path The file to write.
+  @param data The values, in row-major order.
+  @param shape The dimensions of the array, whose product is the number of
+  values.
+  @return false if the file could not be written.
+*/
+bool saveNpy(const std::string& path, const double* data,
+             const std::vector<std::size_t>& shape);
+bool saveNpy(const std::string& path, const int* data,
+             const std::vector<std::size_t>& shape);
+
+}  // namespace tacbot
+#endif
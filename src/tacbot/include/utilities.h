@@ -17,6 +17,7 @@ namespace tacbot {
 struct TrajectoryAnalysisData {
   std::vector<double> total_depth;
   std::vector<std::vector<double>> depth_per_link;
+  std::vector<double> field_cost;
 };
 
 struct PlanAnalysisData {
@@ -26,6 +27,7 @@ struct PlanAnalysisData {
   double total_contact_depth = 0.0;
   double joint_path_len = 0.0;
   double ee_path_len = 0.0;
+  double total_field_cost = 0.0;
 
   TrajectoryAnalysisData trajectory_analysis;
 };
@@ -2,17 +2,48 @@
 #define TACBOT_VISUALIZER_DATA_H
 #include <manipulability_measures.h>
 
+#include <limits>
+#include <random>
 #include <vector>
 
 #include "utilities.h"
 
+/** Set to 0 to compile the recording of planner samples out of the planners'
+ * hot paths, whatever recording policy is selected at runtime.*/
+#ifndef TACBOT_VISUALIZER_RECORDING
+#define TACBOT_VISUALIZER_RECORDING 1
+#endif
+
 namespace tacbot {
 
+/** \brief Which of the planner's sampled states VisualizerData keeps.*/
+struct RecordingOptions {
+  enum Policy {
+    /** \brief Keep every sampled state.*/
+    ALL,
+    /** \brief Keep nothing.*/
+    OFF,
+    /** \brief Keep a uniform random subset of at most capacity states.*/
+    RESERVOIR,
+    /** \brief Keep every stride-th state.*/
+    EVERY_NTH,
+  };
+
+  Policy policy = ALL;
+  std::size_t capacity = 1000;
+  std::size_t stride = 10;
+  unsigned int seed = 0;
+};
+
 /** \class This struct is mainly used as a storage device. The ContactPlanner
  * stores its information here, and the Visualizer class will retrieve this
  * information from the ContactPlanner to visualize it.
  */
 struct VisualizerData {
+  /** \brief The planner's sample state count of each recorded state. States
+   * kept by a reservoir are not stored in the order they were sampled in.*/
+  std::vector<std::size_t> sample_state_idx_;
+
   /** \brief The robot joint angles as sampled by the planner.*/
   std::vector<std::vector<double>> sample_joint_angles_;
 
@@ -48,7 +79,43 @@ struct VisualizerData {
   /** \brief The number of repulse points at any given time. This number changes
    * during trajectory generation. It is used to resize vectors which store
    * information.*/
-  std::size_t cur_total_num_repulse_pts_;
+  std::size_t cur_total_num_repulse_pts_ = 0;
+
+  /** \brief Select which sampled states are recorded from now on. The states
+   * recorded so far are cleared, since they were selected by the old policy.
+  */
+  void setRecordingOptions(const RecordingOptions& options);
+
+  const RecordingOptions& getRecordingOptions() const {
+    return recording_options_;
+  }
+
+  /** \brief Clear the recorded states and the end-effector path.*/
+  void clear();
+
+  /** \brief Whether the sampled state is recorded. The decision is made once,
+    the first time a state is seen, and the save functions then store the
+    state's data in its place. The planners check this before collecting the
+    data of a state.
+    @param sample_state_count The robot state number, sampled by the planner.
+  */
+  bool isRecording(std::size_t sample_state_count) {
+#if TACBOT_VISUALIZER_RECORDING
+    return getSlot(sample_state_count) != NOT_RECORDED;
+#else
+    (void)sample_state_count;
+    return false;
+#endif
+  }
+
+  /** \brief Store a point of the end-effector path. The path is decimated to
+    the stride, or evenly to the capacity of a reservoir, so that it stays in
+    order.
+    @param pt_idx The index of the trajectory point.
+    @param num_pts The number of points in the trajectory.
+  */
+  void saveEEPathPt(const Eigen::Vector3d& pt, std::size_t pt_idx,
+                    std::size_t num_pts);
 
   /** \brief Stores the origin and direction of the repulsion vector for a robot
     state.
@@ -66,9 +133,7 @@ struct VisualizerData {
                        const Eigen::Vector3d& vec, std::size_t pt_num,
                        std::size_t sample_state_count);
 
-  void saveNearRandDot(const Eigen::VectorXd& vec) {
-    nearrand_dot_at_link.emplace_back(vec);
-  }
+  void saveNearRandDot(const Eigen::VectorXd& vec);
 
   /** \brief Store the joint angles sampled by the planner.
     @param joint_angles
@@ -100,6 +165,31 @@ struct VisualizerData {
   void setTotalNumRepulsePts(std::size_t num_pts);
 
   void saveAvgRepulseVec(const std::vector<Eigen::Vector3d>& vec);
+
+ private:
+  static constexpr std::size_t NOT_RECORDED =
+      std::numeric_limits<std::size_t>::max();
+
+  /** \brief The index the sampled state is stored at, or NOT_RECORDED. A new
+   * state is given its index by the recording policy.*/
+  std::size_t getSlot(std::size_t sample_state_count);
+
+  /** \brief Empty the data stored at an index that a reservoir hands to a new
+   * state.*/
+  void resetSlot(std::size_t slot);
+
+  RecordingOptions recording_options_;
+  std::mt19937 reservoir_rng_;
+
+  /** \brief The state the save functions without a state number store to,
+   * the last one given to getSlot.*/
+  std::size_t cur_state_ = NOT_RECORDED;
+  std::size_t cur_slot_ = NOT_RECORDED;
+
+  /** \brief Number of distinct states seen, and recorded, since the last
+   * clear.*/
+  std::size_t num_states_seen_ = 0;
+  std::size_t num_states_recorded_ = 0;
 };
 
 }  // namespace tacbot
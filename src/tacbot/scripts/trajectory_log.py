@@ -0,0 +1,46 @@
+import os
+import sys
+
+import numpy as np
+
+# Layout of the header written by TrajectoryLog::save, see
+# include/trajectory_log.h.
+MAGIC = b"TBTRAJ01"
+HEADER_SIZE = 64
+
+
+def load_tbt(path: str) -> dict:
+    """Memory-map the columns of a binary trajectory log. Nothing is read
+    until a column is accessed."""
+    header = np.fromfile(path, dtype=np.uint8, count=HEADER_SIZE).tobytes()
+    if header[:8] != MAGIC:
+        raise ValueError(path + " is not a trajectory log")
+    fields = np.frombuffer(header[8:56], dtype="<u8")
+    num_samples, num_joints = int(fields[0]), int(fields[1])
+    offsets = [int(offset) for offset in fields[2:6]]
+
+    log = {}
+    log["time"] = np.memmap(path, dtype="<f8", mode="r", offset=offsets[0],
+                            shape=(num_samples,))
+    for name, offset in zip(["q", "dq", "ddq"], offsets[1:]):
+        log[name] = np.memmap(path, dtype="<f8", mode="r", offset=offset,
+                              shape=(num_samples, num_joints))
+    return log
+
+
+def load_npy(prefix: str) -> dict:
+    """Memory-map the arrays written by TrajectoryLog::exportNpy."""
+    return {name: np.load(prefix + name + ".npy", mmap_mode="r")
+            for name in ["time", "q", "dq", "ddq"]}
+
+
+def load(path: str) -> dict:
+    if path.endswith(".tbt"):
+        return load_tbt(path)
+    return load_npy(path)
+
+
+if __name__ == "__main__":
+    log = load(sys.argv[1])
+    print(os.path.basename(sys.argv[1]), "samples:", len(log["time"]),
+          "duration:", log["time"][-1] if len(log["time"]) else 0.0)
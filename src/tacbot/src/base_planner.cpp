@@ -1,7 +1,14 @@
 #include "base_planner.h"
 
+#include <srdfdom/model.h>
+#include <urdf_parser/urdf_parser.h>
+
 #include <moveit/trajectory_processing/ruckig_traj_smoothing.h>
 #include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
+#include <ompl/base/objectives/PathLengthOptimizationObjective.h>
+
+#include <fstream>
+#include <sstream>
 
 using namespace std::chrono;
 constexpr char LOGNAME[] = "contact_planner";
@@ -14,10 +21,12 @@ BasePlanner::BasePlanner() {
 
 void BasePlanner::setCurToStartState(
     planning_interface::MotionPlanRequest& req) {
-  moveit::core::RobotStatePtr robot_state(new moveit::core::RobotState(
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)->getCurrentState()));
+  moveit::core::RobotStatePtr robot_state(
+      new moveit::core::RobotState(scene_handle_.read()->getCurrentState()));
   robot_state->setToDefaultValues(joint_model_group_, "ready");
-  psm_->updateSceneWithCurrentState();
+  if (psm_) {
+    psm_->updateSceneWithCurrentState();
+  }
 
   req.start_state.joint_state.header.stamp = ros::Time::now();
   req.start_state.joint_state.name = joint_model_group_->getVariableNames();
@@ -39,8 +48,8 @@ void BasePlanner::setCurToStartState(
 
 void BasePlanner::setStartState(planning_interface::MotionPlanRequest& req,
                                 const std::vector<double>& pos) {
-  moveit::core::RobotStatePtr robot_state(new moveit::core::RobotState(
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)->getCurrentState()));
+  moveit::core::RobotStatePtr robot_state(
+      new moveit::core::RobotState(scene_handle_.read()->getCurrentState()));
   // robot_state->setToDefaultValues(joint_model_group_, "ready");
   robot_state->setVariablePositions(pos);
   robot_state->update();
@@ -52,7 +61,9 @@ void BasePlanner::setStartState(planning_interface::MotionPlanRequest& req,
   // planning_scene_monitor::LockedPlanningSceneRW(psm_)->setCurrentState(
   //     *robot_state);
 
-  psm_->updateSceneWithCurrentState();
+  if (psm_) {
+    psm_->updateSceneWithCurrentState();
+  }
 
   req.start_state.joint_state.header.stamp = ros::Time::now();
   req.start_state.joint_state.name = joint_model_group_->getVariableNames();
@@ -77,8 +88,8 @@ moveit_msgs::Constraints BasePlanner::createJointGoal() {
 
 moveit_msgs::Constraints BasePlanner::createJointGoal(
     std::vector<double> joint_goal_pos) {
-  moveit::core::RobotStatePtr robot_state(new moveit::core::RobotState(
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)->getCurrentState()));
+  moveit::core::RobotStatePtr robot_state(
+      new moveit::core::RobotState(scene_handle_.read()->getCurrentState()));
 
   moveit::core::RobotState goal_state(*robot_state);
 
@@ -118,6 +129,42 @@ bool BasePlanner::generatePlan(planning_interface::MotionPlanResponse& res) {
   return true;
 }
 
+bool BasePlanner::shortcutPlan(planning_interface::MotionPlanResponse& res,
+                               double time_budget) {
+  ompl::geometric::SimpleSetupPtr simple_setup = context_->getOMPLSimpleSetup();
+  if (res.error_code_.val != res.error_code_.SUCCESS ||
+      !simple_setup->haveSolutionPath()) {
+    ROS_ERROR_NAMED(LOGNAME, "No solution path. Cannot shortcut.");
+    return false;
+  }
+
+  ompl::base::SpaceInformationPtr si = simple_setup->getSpaceInformation();
+  ompl::base::OptimizationObjectivePtr objective = optimization_objective_;
+  if (!objective) {
+    objective = simple_setup->getOptimizationObjective();
+  }
+  if (!objective) {
+    objective =
+        std::make_shared<ompl::base::PathLengthOptimizationObjective>(si);
+  }
+
+  ContactPathShortcutter::Options options;
+  options.time_budget = time_budget;
+  options.serialize_cost = !isCostThreadSafe();
+  ContactPathShortcutter shortcutter(si, objective, options);
+
+  ompl::geometric::PathGeometric& path = simple_setup->getSolutionPath();
+  shortcutter.shortcut(path);
+
+  robot_trajectory::RobotTrajectoryPtr trajectory =
+      std::make_shared<robot_trajectory::RobotTrajectory>(
+          robot_model_, joint_model_group_->getName());
+  context_->convertPath(path, *trajectory);
+  res.trajectory_ = trajectory;
+  plan_response_ = res;
+  return true;
+}
+
 bool BasePlanner::parameterizePlan(
     planning_interface::MotionPlanResponse& res) {
   if (res.error_code_.val != res.error_code_.SUCCESS || !res.trajectory_) {
@@ -158,6 +205,61 @@ bool BasePlanner::parameterizePlan(
   return true;
 }
 
+bool BasePlanner::compressPlan(planning_interface::MotionPlanResponse& res,
+                               double position_tolerance,
+                               double velocity_tolerance) {
+  if (res.error_code_.val != res.error_code_.SUCCESS || !res.trajectory_ ||
+      res.trajectory_->empty()) {
+    ROS_ERROR_NAMED(LOGNAME, "Invalid solution. Cannot compress.");
+    return false;
+  }
+
+  // time parameterization can repeat the time of the first waypoint, those
+  // are left out of the spline, remember which waypoint each point came from
+  JointTrajectorySpline spline;
+  std::vector<std::size_t> waypoint_indices;
+  std::vector<double> positions;
+  std::vector<double> velocities;
+  JointTrajectorySpline::JointArray position;
+  JointTrajectorySpline::JointArray velocity;
+  for (std::size_t wp_idx = 0; wp_idx < res.trajectory_->getWayPointCount();
+       wp_idx++) {
+    double time = res.trajectory_->getWayPointDurationFromStart(wp_idx);
+    if (spline.size() > 0 && time <= spline.getDuration()) {
+      continue;
+    }
+    const moveit::core::RobotState& state =
+        res.trajectory_->getWayPoint(wp_idx);
+    state.copyJointGroupPositions(joint_model_group_, positions);
+    state.copyJointGroupVelocities(joint_model_group_, velocities);
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      position[jnt_idx] = positions[jnt_idx];
+      velocity[jnt_idx] = velocities[jnt_idx];
+    }
+    spline.addPoint(time, position, velocity);
+    waypoint_indices.emplace_back(wp_idx);
+  }
+
+  robot_trajectory::RobotTrajectoryPtr trajectory =
+      std::make_shared<robot_trajectory::RobotTrajectory>(
+          robot_model_, joint_model_group_->getName());
+  double last_time = 0.0;
+  for (std::size_t knot : spline.selectKnots(position_tolerance,
+                                             velocity_tolerance)) {
+    trajectory->addSuffixWayPoint(
+        res.trajectory_->getWayPointPtr(waypoint_indices[knot]),
+        spline.getTime(knot) - last_time);
+    last_time = spline.getTime(knot);
+  }
+
+  ROS_INFO_NAMED(LOGNAME, "Compressed trajectory from %ld to %ld waypoints.",
+                 res.trajectory_->getWayPointCount(),
+                 trajectory->getWayPointCount());
+  res.trajectory_ = trajectory;
+  plan_response_ = res;
+  return true;
+}
+
 void BasePlanner::init() {
   robot_model_loader_ = std::make_shared<robot_model_loader::RobotModelLoader>(
       "robot_description");
@@ -198,22 +300,81 @@ void BasePlanner::init() {
   ROS_INFO_NAMED(LOGNAME, "providePlanningSceneService");
   psm_->providePlanningSceneService();
 
-  ROS_INFO_NAMED(LOGNAME, "KinematicsMetrics");
-  kinematics_metrics_ = std::make_shared<kinematics_metrics::KinematicsMetrics>(
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)->getRobotModel());
-
   ROS_INFO_NAMED(LOGNAME, "getStateMonitor");
   planning_scene_monitor::CurrentStateMonitorPtr csm = psm_->getStateMonitor();
   csm->enableCopyDynamics(true);
 
-  ROS_INFO_NAMED(LOGNAME, "robot_state");
-  moveit::core::RobotStatePtr robot_state(new moveit::core::RobotState(
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)->getCurrentState()));
+  scene_handle_ = PlanningSceneHandle(psm_);
 
   ROS_INFO_NAMED(LOGNAME, "updateSceneWithCurrentState");
-  robot_state->setToDefaultValues(joint_model_group_, "ready");
   psm_->updateSceneWithCurrentState();
 
+  initCommon();
+}
+
+void BasePlanner::init(const std::string& urdf_path,
+                       const std::string& srdf_path) {
+  // Time stamps on the request messages use ros::Time, which otherwise needs
+  // ros::init and a master to be available.
+  if (!ros::isInitialized()) {
+    ros::Time::init();
+  }
+
+  auto read_file = [](const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+      ROS_ERROR_NAMED(LOGNAME, "Could not open file: %s", path.c_str());
+      throw std::invalid_argument(path);
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+  };
+
+  ROS_INFO_NAMED(LOGNAME, "Loading robot model from %s and %s",
+                 urdf_path.c_str(), srdf_path.c_str());
+  urdf::ModelInterfaceSharedPtr urdf_model =
+      urdf::parseURDF(read_file(urdf_path));
+  if (!urdf_model) {
+    ROS_ERROR_NAMED(LOGNAME, "Failed to parse URDF: %s", urdf_path.c_str());
+    throw std::invalid_argument(urdf_path);
+  }
+
+  srdf::ModelSharedPtr srdf_model = std::make_shared<srdf::Model>();
+  if (!srdf_model->initString(*urdf_model, read_file(srdf_path))) {
+    ROS_ERROR_NAMED(LOGNAME, "Failed to parse SRDF: %s", srdf_path.c_str());
+    throw std::invalid_argument(srdf_path);
+  }
+
+  robot_model_ = std::make_shared<moveit::core::RobotModel>(urdf_model,
+                                                            srdf_model);
+
+  ROS_INFO_NAMED(LOGNAME, "getJointModelGroup");
+  joint_model_group_ = robot_model_->getJointModelGroup(group_name_);
+  dof_ = joint_model_group_->getActiveVariableCount();
+
+  // Without a state monitor there is no robot to read the current state from,
+  // so the scene starts out in the same ready pose that the planners use.
+  planning_scene::PlanningScenePtr scene =
+      std::make_shared<planning_scene::PlanningScene>(robot_model_);
+  scene->getCurrentStateNonConst().setToDefaultValues(joint_model_group_,
+                                                       "ready");
+  scene->getCurrentStateNonConst().update();
+  scene_handle_ = PlanningSceneHandle(scene);
+
+  initCommon();
+}
+
+void BasePlanner::initCommon() {
+  ROS_INFO_NAMED(LOGNAME, "KinematicsMetrics");
+  kinematics_metrics_ =
+      std::make_shared<kinematics_metrics::KinematicsMetrics>(robot_model_);
+
+  ROS_INFO_NAMED(LOGNAME, "robot_state");
+  moveit::core::RobotStatePtr robot_state(
+      new moveit::core::RobotState(scene_handle_.read()->getCurrentState()));
+  robot_state->setToDefaultValues(joint_model_group_, "ready");
+
   robot_state_ = std::make_shared<moveit::core::RobotState>(*robot_state);
 
   ROS_INFO_NAMED(LOGNAME, "vis_data_");
@@ -221,6 +382,56 @@ void BasePlanner::init() {
   ROS_INFO_NAMED(LOGNAME, "init done");
 }
 
+void BasePlanner::addCollisionObject(
+    const moveit_msgs::CollisionObject& collision_object) {
+  if (!scene_handle_.write()->processCollisionObjectMsg(collision_object)) {
+    ROS_ERROR_NAMED(LOGNAME, "Failed to add collision object: %s",
+                    collision_object.id.c_str());
+  }
+  scene_version_++;
+}
+
+void BasePlanner::setStateSampler(
+    const ompl::geometric::SimpleSetupPtr& simple_setup) {
+  const ompl::base::StateSpacePtr& space = simple_setup->getStateSpace();
+
+  // Without path constraints the planning context samples with the default
+  // sampler of the space, which clearStateSamplerAllocator() restores. With
+  // them its samples have to satisfy the constraints, which biased samples
+  // would not.
+  bool use_manip_sampler = use_manip_sampler_;
+  const kinematic_constraints::KinematicConstraintSetPtr& path_constraints =
+      context_->getPathConstraints();
+  if (use_manip_sampler && path_constraints && !path_constraints->empty()) {
+    ROS_WARN_NAMED(LOGNAME,
+                   "Keeping the path constrained sampler of the planning "
+                   "context instead of the manipulability biased sampler.");
+    use_manip_sampler = false;
+  }
+
+  if (!use_manip_sampler) {
+    // Only undo our own allocator, a new planning context brings its own
+    // state space with its own sampler.
+    if (manip_sampler_space_.lock() == space) {
+      space->clearStateSamplerAllocator();
+    }
+    manip_sampler_space_.reset();
+    return;
+  }
+  manip_sampler_space_ = space;
+
+  ROS_INFO_NAMED(LOGNAME, "Using the manipulability biased sampler.");
+  moveit::core::RobotState robot_state(*robot_state_);
+  const moveit::core::JointModelGroup* joint_model_group = joint_model_group_;
+  ManipulabilitySampler::Options options = manip_sampler_options_;
+  space->setStateSamplerAllocator(
+      [robot_state, joint_model_group,
+       options](const ompl::base::StateSpace* state_space) {
+        return std::make_shared<ManipulabilitySampler>(
+            state_space, robot_state, joint_model_group, options);
+      });
+}
+
 bool BasePlanner::solveFK(std::vector<double> joint_values) {
   const kinematics::KinematicsBaseConstPtr ik_solver =
       joint_model_group_->getSolverInstance();
@@ -229,8 +440,8 @@ bool BasePlanner::solveFK(std::vector<double> joint_values) {
   link_names.emplace_back("panda_link8");
   std::vector<geometry_msgs::Pose> poses;
 
-  moveit::core::RobotStatePtr robot_state(new moveit::core::RobotState(
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)->getCurrentState()));
+  moveit::core::RobotStatePtr robot_state(
+      new moveit::core::RobotState(scene_handle_.read()->getCurrentState()));
   robot_state->setToDefaultValues(joint_model_group_, "ready");
 
   robot_state->copyJointGroupPositions(joint_model_group_, joint_values);
@@ -319,8 +530,7 @@ bool BasePlanner::calculateEEPath() {
       joint_angles[jnt_idx] = point.positions[jnt_idx];
     }
 
-    moveit::core::RobotState robot_state(
-        psm_->getPlanningScene()->getRobotModel());
+    moveit::core::RobotState robot_state(robot_model_);
     robot_state.setJointGroupPositions(joint_model_group_, joint_angles);
     robot_state.update();
 
@@ -330,7 +540,7 @@ bool BasePlanner::calculateEEPath() {
         robot_state.getGlobalLinkTransform("panda_link8");
     Eigen::Vector3d tip_pos{tip_tf.translation().x(), tip_tf.translation().y(),
                             tip_tf.translation().z()};
-    vis_data_->ee_path_pts_.emplace_back(tip_pos);
+    vis_data_->saveEEPathPt(tip_pos, pt_idx, num_pts);
   }
   return true;
 }
@@ -0,0 +1,139 @@
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "panda_interface.h"
+#include "simulated_robot.h"
+
+using namespace tacbot;
+
+namespace {
+
+void printStats(const std::string& name, const SimulatedRobot::Stats& stats) {
+  std::cout << std::left << std::setw(28) << name << std::right
+            << std::setw(8) << stats.cycles << std::setw(8)
+            << stats.missed_cycles << std::setw(8) << stats.missed_deadlines
+            << std::setw(8) << stats.acceleration_violations << std::fixed
+            << std::setprecision(2) << std::setw(10) << stats.p50 * 1e6
+            << std::setw(10) << stats.p90 * 1e6 << std::setw(10)
+            << stats.p99 * 1e6 << std::setw(10) << stats.max * 1e6
+            << std::endl;
+}
+
+/** A smooth motion of all joints around the start position, with waypoints
+ * every 50 ms, as a time parameterized plan would have.*/
+JointTrajectorySpline createTrajectory(const std::array<double, 7>& start,
+                                       double duration) {
+  JointTrajectorySpline trajectory;
+  const double omega = 2.0 * M_PI / duration;
+  for (double t = 0.0; t <= duration + 1e-9; t += 0.05) {
+    std::array<double, 7> q;
+    std::array<double, 7> dq;
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      // 1 - cos starts and ends at rest
+      q[jnt_idx] = start[jnt_idx] + 0.1 * (1.0 - std::cos(omega * t));
+      dq[jnt_idx] = 0.1 * omega * std::sin(omega * t);
+    }
+    trajectory.addPoint(t, q, dq);
+  }
+  return trajectory;
+}
+
+}  // namespace
+
+/** Runs the execution routines of PandaInterface against a SimulatedRobot
+ * and reports the compute time of the control callback, in microseconds, and
+ * the cycles and deadlines that were missed. No robot or ROS master is needed.
+ *
+ * usage: benchmark_execution [missed cycle probability] [deadline in s]
+ */
+int main(int argc, char** argv) {
+  SimulatedRobot::Options options;
+  options.missed_cycle_probability = argc > 1 ? std::stod(argv[1]) : 0.001;
+  options.deadline = argc > 2 ? std::stod(argv[2]) : 0.0005;
+
+  PandaInterface panda_interface;
+  std::array<double, 7> start = options.initial_q;
+  std::array<double, 7> target = start;
+  for (double& q : target) {
+    q += 0.3;
+  }
+
+  std::cout << std::left << std::setw(28) << "routine" << std::right
+            << std::setw(8) << "cycles" << std::setw(8) << "lost"
+            << std::setw(8) << "late" << std::setw(8) << "accel"
+            << std::setw(10) << "p50 us" << std::setw(10) << "p90 us"
+            << std::setw(10) << "p99 us" << std::setw(10) << "max us"
+            << std::endl;
+
+  {
+    SimulatedRobot robot(options);
+    panda_interface.move(robot, start, target);
+    printStats("move", robot.getStats());
+  }
+
+  JointTrajectorySpline trajectory = createTrajectory(start, 3.0);
+  {
+    SimulatedRobot robot(options);
+    panda_interface.move_with_velocity_control(robot, trajectory);
+    printStats("move_with_velocity_control", robot.getStats());
+  }
+
+  {
+    // the waypoints of the same path, without their timing
+    std::vector<std::array<double, 7>> waypoints;
+    for (std::size_t i = 0; i < trajectory.size(); i++) {
+      waypoints.push_back(trajectory.getPosition(i));
+    }
+    SimulatedRobot robot(options);
+    panda_interface.follow_joint_waypoints(robot, waypoints, 0.5);
+    printStats("follow_joint_waypoints", robot.getStats());
+  }
+
+  {
+    // and with the velocities of the plan at the waypoints
+    std::vector<std::array<double, 7>> waypoints;
+    std::vector<std::array<double, 7>> velocities;
+    for (std::size_t i = 0; i < trajectory.size(); i++) {
+      waypoints.push_back(trajectory.getPosition(i));
+      velocities.push_back(trajectory.getVelocity(i));
+    }
+    SimulatedRobot robot(options);
+    panda_interface.follow_joint_waypoints(robot, waypoints, velocities, 0.5);
+    printStats("follow_joint_waypoints dq", robot.getStats());
+  }
+
+  // the routines that take input from another thread run in real time
+  SimulatedRobot::Options real_time_options = options;
+  real_time_options.real_time = true;
+  {
+    SimulatedRobot robot(real_time_options);
+    std::thread retarget([&]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(300));
+      panda_interface.set_online_target(start);
+    });
+    panda_interface.move_online(robot, target);
+    retarget.join();
+    printStats("move_online", robot.getStats());
+  }
+
+  {
+    SimulatedRobot robot(real_time_options);
+    TrajectoryChannel& channel = panda_interface.get_trajectory_channel();
+    std::thread planner([&]() {
+      channel.sendTrajectory(trajectory, false);
+      TrajectoryCommand finish;
+      finish.type = TrajectoryCommand::Type::FINISH;
+      while (!channel.send(finish)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+    panda_interface.follow_trajectory_channel(robot);
+    planner.join();
+    printStats("follow_trajectory_channel", robot.getStats());
+  }
+
+  return 0;
+}
@@ -37,6 +37,18 @@ MotionGenerator::MotionGenerator(double speed_factor,
   q_1_.setZero();
 }
 
+std::array<double, 7> MotionGenerator::getMaxVelocity() const {
+  std::array<double, 7> dq_max;
+  Eigen::Map<Vector7d>(dq_max.data()) = dq_max_;
+  return dq_max;
+}
+
+std::array<double, 7> MotionGenerator::getMaxAcceleration() const {
+  std::array<double, 7> ddq_max;
+  Eigen::Map<Vector7d>(ddq_max.data()) = ddq_max_start_.cwiseMin(ddq_max_goal_);
+  return ddq_max;
+}
+
 bool MotionGenerator::calculateDesiredValues(double t,
                                              Vector7d* delta_q_d) const {
   Vector7i sign_delta_q;
@@ -0,0 +1,93 @@
+#include "contact_detector.h"
+
+#include <cmath>
+
+namespace tacbot {
+
+void ContactDetector::reset() {
+  initialized_ = false;
+  residual_.fill(0.0);
+  cycles_above_.fill(0);
+  contact_ = Contact();
+}
+
+bool ContactDetector::update(const franka::RobotState& robot_state,
+                             const franka::Model& model, double period) {
+  return update(robot_state, model.mass(robot_state),
+                model.coriolis(robot_state), model.gravity(robot_state),
+                period, [&](franka::Frame frame) {
+                  return model.pose(frame, robot_state);
+                });
+}
+
+int ContactDetector::updateObserver(const franka::RobotState& robot_state,
+                                    const std::array<double, 49>& mass,
+                                    const std::array<double, 7>& coriolis,
+                                    const std::array<double, 7>& gravity,
+                                    double period) {
+  const std::array<double, 7> p = momentum(mass, robot_state.dq);
+
+  if (!initialized_ || period <= 0.0) {
+    integral_ = p;
+    residual_.fill(0.0);
+    last_mass_ = mass;
+    initialized_ = true;
+    return -1;
+  }
+
+  for (std::size_t i = 0; i < 7; i++) {
+    // C^T dq = dM/dt dq - C dq, with dM/dt from the last cycle
+    double mass_dot_dq = 0.0;
+    for (std::size_t j = 0; j < 7; j++) {
+      mass_dot_dq += (mass[j * 7 + i] - last_mass_[j * 7 + i]) / period *
+                     robot_state.dq[j];
+    }
+    integral_[i] += period * (robot_state.tau_J[i] - gravity[i] - coriolis[i] +
+                              mass_dot_dq + residual_[i]);
+  }
+  for (std::size_t i = 0; i < 7; i++) {
+    residual_[i] = options_.gain * (p[i] - integral_[i]);
+    if (std::abs(residual_[i]) > options_.thresholds[i]) {
+      cycles_above_[i]++;
+    } else {
+      cycles_above_[i] = 0;
+    }
+  }
+  last_mass_ = mass;
+
+  if (!contact_.detected) {
+    for (std::size_t i = 7; i-- > 0;) {
+      if (cycles_above_[i] >= options_.min_cycles) {
+        return static_cast<int>(i);
+      }
+    }
+  }
+  return -1;
+}
+
+std::array<double, 7> ContactDetector::momentum(
+    const std::array<double, 49>& mass, const std::array<double, 7>& dq) {
+  // the mass matrix is column major
+  std::array<double, 7> p{};
+  for (std::size_t j = 0; j < 7; j++) {
+    for (std::size_t i = 0; i < 7; i++) {
+      p[i] += mass[j * 7 + i] * dq[j];
+    }
+  }
+  return p;
+}
+
+void ContactDetector::locateContact(std::size_t link,
+                                    const std::array<double, 16>& start,
+                                    const std::array<double, 16>& end) {
+  // the frames of the joints are followed by the flange, so link i lies
+  // between frame i and frame i + 1
+  contact_.detected = true;
+  contact_.link = link;
+  for (std::size_t i = 0; i < 3; i++) {
+    contact_.point[i] = 0.5 * (start[12 + i] + end[12 + i]);
+  }
+  contact_.residual = residual_;
+}
+
+}  // namespace tacbot
@@ -0,0 +1,260 @@
+#include "contact_path_shortcutter.h"
+
+#include <ros/console.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+constexpr char LOGNAME[] = "contact_path_shortcutter";
+
+namespace tacbot {
+
+ContactPathShortcutter::ContactPathShortcutter(
+    const ompl::base::SpaceInformationPtr& si,
+    const ompl::base::OptimizationObjectivePtr& objective,
+    const Options& options)
+    : si_(si), objective_(objective), options_(options) {
+  if (options_.num_threads == 0) {
+    options_.num_threads =
+        std::max<std::size_t>(1, std::thread::hardware_concurrency());
+  }
+  options_.candidates_per_thread =
+      std::max<std::size_t>(1, options_.candidates_per_thread);
+  rngs_.resize(options_.num_threads);
+  pool_ = std::make_unique<WorkerPool>(options_.num_threads);
+}
+
+ContactPathShortcutter::~ContactPathShortcutter() = default;
+
+ContactPathShortcutter::WorkerPool::WorkerPool(std::size_t num_threads) {
+  for (std::size_t t = 1; t < num_threads; t++) {
+    threads_.emplace_back(&WorkerPool::work, this, t);
+  }
+}
+
+ContactPathShortcutter::WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_condition_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ContactPathShortcutter::WorkerPool::run(
+    const std::function<void(std::size_t)>& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    pending_ = threads_.size();
+    round_++;
+  }
+  start_condition_.notify_all();
+
+  task(0);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_condition_.wait(lock, [this]() { return pending_ == 0; });
+  task_ = nullptr;
+}
+
+void ContactPathShortcutter::WorkerPool::work(std::size_t t) {
+  std::size_t last_round = 0;
+  while (true) {
+    const std::function<void(std::size_t)>* task = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      start_condition_.wait(
+          lock, [&]() { return stopping_ || round_ != last_round; });
+      if (stopping_) {
+        return;
+      }
+      last_round = round_;
+      task = task_;
+    }
+    (*task)(t);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_--;
+    }
+    done_condition_.notify_one();
+  }
+}
+
+ompl::base::Cost ContactPathShortcutter::motionCost(
+    const ompl::base::State* s1, const ompl::base::State* s2) {
+  if (options_.serialize_cost) {
+    std::lock_guard<std::mutex> lock(cost_mutex_);
+    return objective_->motionCost(s1, s2);
+  }
+  return objective_->motionCost(s1, s2);
+}
+
+ompl::base::Cost ContactPathShortcutter::segmentCost(std::size_t from,
+                                                     std::size_t to) const {
+  ompl::base::Cost cost = objective_->identityCost();
+  for (std::size_t i = from; i < to; i++) {
+    cost = objective_->combineCosts(cost, edge_costs_[i]);
+  }
+  return cost;
+}
+
+ompl::base::Cost ContactPathShortcutter::pathCost() const {
+  return segmentCost(0, edge_costs_.size());
+}
+
+void ContactPathShortcutter::evaluateCandidates(
+    const std::vector<ompl::base::State*>& states, ompl::RNG& rng,
+    std::vector<Candidate>& accepted, std::size_t& attempts) {
+  const int last = static_cast<int>(states.size()) - 1;
+  for (std::size_t c = 0; c < options_.candidates_per_thread; c++) {
+    int from = rng.uniformInt(0, last);
+    int to = rng.uniformInt(0, last);
+    if (from > to) {
+      std::swap(from, to);
+    }
+    // a shortcut has to skip at least one state to change anything
+    if (to - from < 2) {
+      continue;
+    }
+    attempts++;
+
+    if (!si_->checkMotion(states[from], states[to])) {
+      continue;
+    }
+
+    ompl::base::Cost new_cost = motionCost(states[from], states[to]);
+    ompl::base::Cost old_cost = segmentCost(from, to);
+    if (!objective_->isCostBetterThan(new_cost, old_cost)) {
+      continue;
+    }
+
+    Candidate candidate;
+    candidate.from = from;
+    candidate.to = to;
+    candidate.cost = new_cost;
+    candidate.gain = std::abs(old_cost.value() - new_cost.value());
+    accepted.emplace_back(candidate);
+  }
+}
+
+ShortcutStats ContactPathShortcutter::shortcut(
+    ompl::geometric::PathGeometric& path) {
+  auto start_time = std::chrono::steady_clock::now();
+  auto deadline = start_time + std::chrono::duration<double>(
+                                   std::max(0.0, options_.time_budget));
+
+  ShortcutStats stats;
+  std::vector<ompl::base::State*>& states = path.getStates();
+  stats.initial_states = states.size();
+
+  edge_costs_.clear();
+  for (std::size_t i = 0; i + 1 < states.size(); i++) {
+    edge_costs_.emplace_back(motionCost(states[i], states[i + 1]));
+  }
+  stats.initial_cost = pathCost().value();
+
+  std::size_t num_threads = options_.num_threads;
+  std::vector<std::vector<Candidate>> thread_candidates(num_threads);
+  std::vector<std::size_t> thread_attempts(num_threads, 0);
+  std::size_t idle_rounds = 0;
+
+  while (states.size() > 2 && std::chrono::steady_clock::now() < deadline &&
+         idle_rounds < options_.max_idle_rounds) {
+    stats.rounds++;
+
+    pool_->run([&](std::size_t t) {
+      thread_candidates[t].clear();
+      thread_attempts[t] = 0;
+      evaluateCandidates(states, rngs_[t], thread_candidates[t],
+                         thread_attempts[t]);
+    });
+
+    std::vector<Candidate> candidates;
+    for (std::size_t t = 0; t < num_threads; t++) {
+      stats.attempts += thread_attempts[t];
+      candidates.insert(candidates.end(), thread_candidates[t].begin(),
+                        thread_candidates[t].end());
+    }
+
+    if (candidates.empty()) {
+      idle_rounds++;
+      continue;
+    }
+    idle_rounds = 0;
+
+    // Greedily keep the largest gains whose removed interiors do not overlap.
+    // Shortcuts that only share an end point can both be applied.
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) {
+                return a.gain > b.gain;
+              });
+    std::vector<Candidate> applied;
+    for (const Candidate& candidate : candidates) {
+      bool overlaps = std::any_of(
+          applied.begin(), applied.end(), [&](const Candidate& other) {
+            return candidate.from < other.to && other.from < candidate.to;
+          });
+      if (!overlaps) {
+        applied.emplace_back(candidate);
+      }
+    }
+    std::sort(applied.begin(), applied.end(),
+              [](const Candidate& a, const Candidate& b) {
+                return a.from < b.from;
+              });
+
+    std::vector<ompl::base::State*> new_states;
+    std::vector<ompl::base::Cost> new_edge_costs;
+    new_states.reserve(states.size());
+    new_edge_costs.reserve(edge_costs_.size());
+    std::size_t idx = 0;
+    for (const Candidate& candidate : applied) {
+      for (; idx < candidate.from; idx++) {
+        new_states.emplace_back(states[idx]);
+        new_edge_costs.emplace_back(edge_costs_[idx]);
+      }
+      new_states.emplace_back(states[candidate.from]);
+      new_edge_costs.emplace_back(candidate.cost);
+      for (std::size_t removed = candidate.from + 1; removed < candidate.to;
+           removed++) {
+        si_->freeState(states[removed]);
+      }
+      idx = candidate.to;
+    }
+    for (; idx < states.size(); idx++) {
+      new_states.emplace_back(states[idx]);
+      if (idx < edge_costs_.size()) {
+        new_edge_costs.emplace_back(edge_costs_[idx]);
+      }
+    }
+
+    states.swap(new_states);
+    edge_costs_.swap(new_edge_costs);
+    stats.accepted += applied.size();
+  }
+
+  stats.final_cost = pathCost().value();
+  stats.final_states = states.size();
+  stats.elapsed = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start_time)
+                      .count();
+
+  if (options_.reinterpolate && stats.final_states < stats.initial_states) {
+    path.interpolate(stats.initial_states);
+  }
+
+  ROS_INFO_NAMED(LOGNAME,
+                 "Shortcutting: cost %f -> %f, states %zu -> %zu, accepted %zu "
+                 "of %zu attempts in %zu rounds, %f s (%f cost/s)",
+                 stats.initial_cost, stats.final_cost, stats.initial_states,
+                 stats.final_states, stats.accepted, stats.attempts,
+                 stats.rounds, stats.elapsed, stats.improvementPerSecond());
+  return stats;
+}
+
+}  // namespace tacbot
@@ -202,11 +202,11 @@ void ContactPerception::addTableMesh() {
   addCollisionObjects(collision_objects, object_colors);
 }
 
-void ContactPerception::addSphere(const tacbot::ObstacleGroup& obstacle) {
+moveit_msgs::CollisionObject ContactPerception::sphereToCollisionObject(
+    const tacbot::ObstacleGroup& obstacle) {
   moveit_msgs::CollisionObject collision_object;
   collision_object.header.frame_id = "panda_link0";
   collision_object.id = obstacle.name;
-  obst_num_++;
   collision_object.operation = collision_object.ADD;
 
   shape_msgs::SolidPrimitive primitive;
@@ -226,6 +226,13 @@ void ContactPerception::addSphere(const tacbot::ObstacleGroup& obstacle) {
 
   collision_object.primitives.push_back(primitive);
   collision_object.primitive_poses.push_back(pose);
+  return collision_object;
+}
+
+void ContactPerception::addSphere(const tacbot::ObstacleGroup& obstacle) {
+  moveit_msgs::CollisionObject collision_object =
+      sphereToCollisionObject(obstacle);
+  obst_num_++;
 
   std::vector<moveit_msgs::CollisionObject> collision_objects;
   collision_objects.emplace_back(collision_object);
@@ -5,7 +5,10 @@
 #include <moveit/collision_detection_fcl/collision_common.h>
 #include <moveit/trajectory_processing/time_optimal_trajectory_generation.h>
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <functional>
 
 using namespace std::chrono;
 constexpr char LOGNAME[] = "contact_planner";
@@ -15,7 +18,6 @@ namespace tacbot {
 ContactPlanner::ContactPlanner() : BasePlanner() {
   setObstacleScene(3);
   setGoalState(1);
-  contact_perception_ = std::make_shared<ContactPerception>();
 }
 
 void ContactPlanner::setGoalState(std::size_t option) {
@@ -31,6 +33,8 @@ void ContactPlanner::setGoalState(std::size_t option) {
 void ContactPlanner::setObstacleScene(std::size_t option) {
   spherical_obstacles_.clear();
   sim_obstacle_pos_.clear();
+  field_memo_.clear();
+  scene_version_++;
   ROS_INFO_NAMED(LOGNAME, "Obstacle scene option selected: %ld", option);
   switch (option) {
     case 1:
@@ -67,6 +71,7 @@ void ContactPlanner::setObstacleScene(std::size_t option) {
   for (auto obstacle : spherical_obstacles_) {
     addSphericalObstacle(obstacle.first, obstacle.second);
   }
+  field_engine_.setObstacles(sim_obstacle_pos_);
 }
 
 void ContactPlanner::addSphericalObstacle(const Eigen::Vector3d& center,
@@ -83,52 +88,22 @@ void ContactPlanner::addSphericalObstacle(const Eigen::Vector3d& center,
 }
 
 Eigen::Vector3d ContactPlanner::scaleToDist(Eigen::Vector3d vec) {
-  double y_max = 3.0;
-  double D = 50.0;
-  // double dist_max = 1.0;
-  // std::cout << "vec.norm() " << vec.norm() << std::endl;
-  Eigen::Vector3d vec_out = Eigen::VectorXd::Zero(3);
-
-  // double norm = vec.norm();
-  // double norm_max = 0.1;
-  // if (norm < norm_max) {
-  //   vec_out[0] = 1;
-  //   vec_out[1] = 1;
-  //   vec_out[2] = 1;
-  // } else {
-  //   vec_out[0] = 0;
-  //   vec_out[1] = 0;
-  //   vec_out[2] = 0;
-  // }
-
-  double prox_radius = 0.02;
-  if (planner_name_ == "ContactTRRTDuo" || planner_name_ == "VFRRT") {
-    prox_radius = 0.2;
-  }
-
-  if (vec.squaredNorm() > prox_radius) {
-    return vec_out;
-  }
-
-  if (planner_name_ != "ContactTRRTDuo") {
-    vec.normalize();
-    return vec;
-  }
-
-  vec_out = (vec * y_max) / (D * vec.squaredNorm() + 1.0);
-
-  // std::cout << "vec.squaredNorm() " << vec.squaredNorm() << std::endl;
-  // std::cout << "before scale " << vec.transpose() << std::endl;
-  // std::cout << "vec_out " << vec_out.transpose() << std::endl;
-  return vec_out;
+  return field_engine_.getFieldParams().scale(vec);
 }
 
 void ContactPlanner::extractPtsFromGoalState() {
   moveit::core::RobotStatePtr robot_state =
       std::make_shared<moveit::core::RobotState>(*robot_state_);
   robot_state->setJointGroupPositions(joint_model_group_, joint_goal_pos_);
-  std::size_t num_pts = getPtsOnRobotSurface(robot_state, goal_rob_pts_);
+  robot_state->update();
+  // All the points of the goal state are kept, so that every level of detail
+  // a sample picks has its attractor points.
+  std::vector<BoundingSphere> link_spheres;
+  std::size_t num_pts = field_engine_.getPtsOnRobotSurface(
+      *robot_state, joint_model_group_, dof_, goal_rob_pts_, link_spheres,
+      true);
   std::cout << "num pts from robot goal state: " << num_pts << std::endl;
+  field_engine_.setAttractorPts(goal_rob_pts_);
 }
 
 Eigen::Vector3d ContactPlanner::getAttractPt(std::size_t link_num,
@@ -138,127 +113,44 @@ Eigen::Vector3d ContactPlanner::getAttractPt(std::size_t link_num,
   return pt_on_rob;
 }
 
-void ContactPlanner::extractPtsFromModel(
-    const moveit::core::RobotStatePtr& robot_state,
-    const moveit::core::LinkModel* link_model,
-    std::vector<Eigen::Vector3d>& link_pts, std::size_t& num_pts) {
-  std::vector<shapes::ShapeConstPtr> shapes = link_model->getShapes();
-  std::size_t num_shapes = shapes.size();
-  for (std::size_t j = 0; j < num_shapes; ++j) {
-    Eigen::Isometry3d transform =
-        robot_state->getCollisionBodyTransform(link_model, j);
-
-    if (shapes[j]->type != shapes::MESH) {
-      // should somehow extract points from this as well
-      // ROS_ERROR_NAMED(LOGNAME, "Not a mesh shape");
-    } else {
-      shapes::Mesh* mesh = static_cast<shapes::Mesh*>(shapes[j]->clone());
-      mesh->mergeVertices(0.05);
-      // std::vector<Eigen::Vector3d> points(mesh->vertex_count);
-
-      // std::vector<Eigen::Vector3d> points(mesh->vertex_count);
-
-      for (unsigned int k = 0; k < mesh->vertex_count; ++k) {
-        Eigen::Vector3d mesh_pt(mesh->vertices[3 * k],
-                                mesh->vertices[3 * k + 1],
-                                mesh->vertices[3 * k + 2]);
-        // points[k] = transform * mesh_pt;
-        link_pts.emplace_back(transform * mesh_pt);
-        num_pts++;
-      }
-
-      // for (std::size_t p = 0; p < mesh->triangle_count; ++p) {
-      //   std::size_t i3 = p * 3;
-      //   Eigen::Vector3d s1(mesh->vertices[mesh->triangles[i3] * 3],
-      //                      mesh->vertices[mesh->triangles[i3] * 3 + 1],
-      //                      mesh->vertices[mesh->triangles[i3] * 3 + 2]);
-
-      //   Eigen::Vector3d s2(mesh->vertices[mesh->triangles[i3 + 1] * 3],
-      //                      mesh->vertices[mesh->triangles[i3 + 1] * 3 + 1],
-      //                      mesh->vertices[mesh->triangles[i3 + 1] * 3 +
-      //                      2]);
-
-      //   Eigen::Vector3d s3(mesh->vertices[mesh->triangles[i3 + 2] * 3],
-      //                      mesh->vertices[mesh->triangles[i3 + 2] * 3 + 1],
-      //                      mesh->vertices[mesh->triangles[i3 + 2] * 3 +
-      //                      2]);
-      //   points.emplace_back(transform * ((s1 + s2) / 2));
-      //   points.emplace_back(transform * ((s2 + s3) / 2));
-      //   points.emplace_back(transform * ((s3 + s1) / 2));
-      //   num_pts = num_pts + 3;
-      // }
-    }
-  }
-}
-
 std::size_t ContactPlanner::getPtsOnRobotSurface(
     const moveit::core::RobotStatePtr& robot_state,
-    std::vector<std::vector<Eigen::Vector3d>>& rob_pts) {
-  const std::vector<std::string> link_names =
-      joint_model_group_->getLinkModelNames();
-
-  rob_pts.clear();
-  std::size_t num_links = link_names.size();
-  std::size_t num_pts = 0;
-  // std::cout << "num_links " << num_links << std::endl;
-
-  for (std::size_t i = 0; i < num_links; i++) {
-    // std::cout << "i: " << i << ", " << link_names[i] << std::endl;
-
-    const moveit::core::LinkModel* link_model =
-        robot_state->getLinkModel(link_names[i]);
-
-    const moveit::core::LinkTransformMap fixed_links =
-        link_model->getAssociatedFixedTransforms();
-
-    // std::cout << "link_tf_map.size(): " << link_tf_map.size() << std::endl;
-
-    std::vector<shapes::ShapeConstPtr> shapes = link_model->getShapes();
-    std::size_t num_shapes = shapes.size();
-
-    std::vector<Eigen::Vector3d> link_pts;
-
-    // the last link does not have a mesh for some reason
-    if (i >= dof_ - 1 || (num_shapes == 0 && fixed_links.size() > 0)) {
-      // std::cout << "i: " << i << ", " << link_names[i] << std::endl;
-      for (const std::pair<const moveit::core::LinkModel* const,
-                           Eigen::Isometry3d>& fixed_link : fixed_links) {
-        extractPtsFromModel(robot_state, fixed_link.first, link_pts, num_pts);
-      }
-
-      if (i == num_links - 1) {
-        // std::cout << "i: " << i << ", " << link_names[i] << std::endl;
-        rob_pts.emplace_back(link_pts);
-      }
-      continue;
-    }
-
-    extractPtsFromModel(robot_state, link_model, link_pts, num_pts);
-    rob_pts.emplace_back(link_pts);
-  }
-  // std::cout << "rob_pts.size() " << rob_pts.size() << std::endl;
-  return num_pts;
+    std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+    std::vector<BoundingSphere>& link_spheres) {
+  // The engine reads the link transforms of a const state.
+  robot_state->update();
+  return field_engine_.getPtsOnRobotSurface(*robot_state, joint_model_group_,
+                                            dof_, rob_pts, link_spheres);
 }
 
 std::vector<Eigen::Vector3d> ContactPlanner::getObstacles(
-    const Eigen::Vector3d& pt_on_rob) {
+    const Eigen::Vector3d& pt_on_rob, bool record_vis) {
   std::vector<Eigen::Vector3d> obstacles;
   if (use_sim_obstacles_) {
-    vis_data_->saveObstaclePos(sim_obstacle_pos_, sample_state_count_);
+    if (record_vis) {
+      vis_data_->saveObstaclePos(sim_obstacle_pos_, sample_state_count_);
+    }
     return sim_obstacle_pos_;
   }
 
-  bool status = contact_perception_->extractNearPts(pt_on_rob, obstacles);
+  // Without perception, e.g. in headless mode, the obstacles are only in the
+  // planning scene and there is no point cloud to search.
+  bool status = contact_perception_ &&
+                contact_perception_->extractNearPts(pt_on_rob, obstacles);
   if (status) {
-    vis_data_->saveObstaclePos(obstacles, sample_state_count_);
+    if (record_vis) {
+      vis_data_->saveObstaclePos(obstacles, sample_state_count_);
+    }
     return obstacles;
   }
 
   // Store an empty obstacle vector when no obstacles have been found in
   // proximity. This ensures that the size of the stored obstacles in an array
   // are equal to the number of states that we considered.
-  vis_data_->saveObstaclePos(std::vector<Eigen::Vector3d>{},
-                             sample_state_count_);
+  if (record_vis) {
+    vis_data_->saveObstaclePos(std::vector<Eigen::Vector3d>{},
+                               sample_state_count_);
+  }
 
   // This yields a zero repulsion vector and will mean no repulsion will be
   // applied by the vectors filed.
@@ -270,7 +162,7 @@ std::vector<Eigen::Vector3d> ContactPlanner::getObstacles(
 Eigen::VectorXd ContactPlanner::getRobtPtsVecDiffAvg(
     const std::vector<std::vector<Eigen::Vector3d>>& near_state_rob_pts,
     const std::vector<std::vector<Eigen::Vector3d>>& rand_state_rob_pts,
-    const std::vector<Eigen::Vector3d>& link_to_obs_vec) {
+    const std::vector<Eigen::Vector3d>& link_to_obs_vec, bool record_vis) {
   std::size_t num_links = near_state_rob_pts.size();
   Eigen::VectorXd mean_per_link = Eigen::VectorXd::Zero(num_links);
 
@@ -280,7 +172,10 @@ Eigen::VectorXd ContactPlanner::getRobtPtsVecDiffAvg(
     std::vector<Eigen::Vector3d> near_pts_on_link = near_state_rob_pts[i];
     std::vector<Eigen::Vector3d> rand_pts_on_link = rand_state_rob_pts[i];
 
-    std::size_t num_pts_on_link = near_pts_on_link.size();
+    // The two states may have placed the link at different levels of detail,
+    // the shorter prefix is the set of points they have in common.
+    std::size_t num_pts_on_link =
+        std::min(near_pts_on_link.size(), rand_pts_on_link.size());
     Eigen::MatrixXd diff_per_link = Eigen::MatrixXd::Zero(num_pts_on_link, 3);
 
     for (std::size_t j = 0; j < num_pts_on_link; j++) {
@@ -298,8 +193,10 @@ Eigen::VectorXd ContactPlanner::getRobtPtsVecDiffAvg(
       // std::cout << "sample_state_count_: " << sample_state_count_ <<
       // std::endl;
 
-      vis_data_->saveNearRandVec(near_pt_on_rob, nearrand_diff, pt_num,
-                                 sample_state_count_);
+      if (record_vis) {
+        vis_data_->saveNearRandVec(near_pt_on_rob, nearrand_diff, pt_num,
+                                   sample_state_count_);
+      }
 
       pt_num++;
     }
@@ -318,13 +215,17 @@ Eigen::VectorXd ContactPlanner::getRobtPtsVecDiffAvg(
 
     mean_per_link[i] = dot;
   }
-  vis_data_->saveNearRandDot(mean_per_link);
+  if (record_vis) {
+    vis_data_->saveNearRandDot(mean_per_link);
+  }
   return mean_per_link;
 }
 
 std::vector<Eigen::Vector3d> ContactPlanner::getLinkToObsVec(
-    const std::vector<std::vector<Eigen::Vector3d>>& rob_pts) {
+    const std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+    const std::vector<BoundingSphere>& link_spheres, bool record_vis) {
   std::size_t num_links = rob_pts.size();
+  const bool goal_attractor = field_engine_.getFieldParams().use_goal_attractor;
 
   std::vector<Eigen::Vector3d> link_to_obs_vec(num_links,
                                                Eigen::Vector3d::Zero(3));
@@ -332,15 +233,33 @@ std::vector<Eigen::Vector3d> ContactPlanner::getLinkToObsVec(
   std::size_t pt_num = 0;
 
   for (std::size_t i = 0; i < num_links; i++) {
-    std::vector<Eigen::Vector3d> pts_on_link = rob_pts[i];
+    const std::vector<Eigen::Vector3d>& pts_on_link = rob_pts[i];
     std::size_t num_pts_on_link = pts_on_link.size();
+    if (num_pts_on_link == 0) {
+      continue;
+    }
     // std::cout << "link_num: " << i << std::endl;
     // std::cout << "num_pts_on_link: " << num_pts_on_link << std::endl;
 
     Eigen::MatrixXd pts_link_vec = Eigen::MatrixXd::Zero(num_pts_on_link, 3);
 
     // std::cout << "getObstacles: " << std::endl;
-    std::vector<Eigen::Vector3d> obstacle_pos = getObstacles(pts_on_link[0]);
+    std::vector<Eigen::Vector3d> obstacle_pos =
+        getObstacles(pts_on_link[0], record_vis);
+
+    // A link whose bounding sphere is out of reach of every obstacle is not
+    // repelled, so its points are not visited.
+    if (use_sim_obstacles_ && i < link_spheres.size() &&
+        !field_engine_.isObstacleNear(link_spheres[i])) {
+      if (record_vis) {
+        for (std::size_t j = 0; j < num_pts_on_link; j++) {
+          vis_data_->saveOriginVec(pts_on_link[j], Eigen::Vector3d::Zero(),
+                                   pt_num + j, sample_state_count_);
+        }
+      }
+      pt_num += num_pts_on_link;
+      continue;
+    }
 
     for (std::size_t j = 0; j < num_pts_on_link; j++) {
       // std::cout << "pt j: " << j << std::endl;
@@ -364,7 +283,7 @@ std::vector<Eigen::Vector3d> ContactPlanner::getLinkToObsVec(
         vec = scaleToDist(vec);
         // std::cout << "vec: " << vec.transpose() << std::endl;
 
-        if (planner_name_ == "ContactTRRTDuo") {
+        if (goal_attractor) {
           Eigen::Vector3d att_pt = getAttractPt(i, j);
 
           Eigen::Vector3d att_vec = att_pt - pt_on_rob;
@@ -406,8 +325,10 @@ std::vector<Eigen::Vector3d> ContactPlanner::getLinkToObsVec(
 
       // std::cout << "saveOriginVec: " << std::endl;
 
-      vis_data_->saveOriginVec(pt_on_rob, pt_to_obs_av, pt_num,
-                               sample_state_count_);
+      if (record_vis) {
+        vis_data_->saveOriginVec(pt_on_rob, pt_to_obs_av, pt_num,
+                                 sample_state_count_);
+      }
       pt_num++;
     }
     // std::cout << "pts_link_vec.rows(): " << pts_link_vec.rows() << std::endl;
@@ -420,35 +341,130 @@ std::vector<Eigen::Vector3d> ContactPlanner::getLinkToObsVec(
 
     link_to_obs_vec[i] = link_to_obs_avg;
   }
-  vis_data_->saveAvgRepulseVec(link_to_obs_vec);
+  if (record_vis) {
+    vis_data_->saveAvgRepulseVec(link_to_obs_vec);
+  }
 
   return link_to_obs_vec;
 }
 
-Eigen::VectorXd ContactPlanner::obstacleFieldTaskSpace(
-    const ompl::base::State* base_state) {
+ContactPlanner::FieldSample& ContactPlanner::getFieldSample(
+    const ompl::base::State* base_state, bool with_field, bool& computed) {
   const ompl::base::RealVectorStateSpace::StateType& vec_state =
       *base_state->as<ompl::base::RealVectorStateSpace::StateType>();
-  // ROS_INFO_NAMED(LOGNAME, "joint_angles");
   std::vector<double> joint_angles = utilities::toStlVec(vec_state, dof_);
 
-  moveit::core::RobotStatePtr robot_state =
-      std::make_shared<moveit::core::RobotState>(*robot_state_);
-  robot_state->setJointGroupPositions(joint_model_group_, joint_angles);
+  FieldMemoKey key(dof_);
+  for (std::size_t i = 0; i < dof_; i++) {
+    key[i] = std::llround(joint_angles[i] / FIELD_MEMO_RESOLUTION);
+  }
+
+  computed = false;
+  FieldSample& sample = field_memo_[key];
+  if (!sample.has_pts) {
+    if (!field_state_) {
+      field_state_ = std::make_shared<moveit::core::RobotState>(*robot_state_);
+    }
+    field_state_->setJointGroupPositions(joint_model_group_, joint_angles);
+    sample.num_pts = getPtsOnRobotSurface(field_state_, sample.rob_pts,
+                                          sample.link_spheres);
+    sample.jacobian = field_state_->getJacobian(joint_model_group_);
+    sample.has_pts = true;
+  }
+
+  if (with_field && !sample.has_field) {
+    // Gates that run before any repulsion work. A state the planner rejects
+    // is never extended from or costed, and a state with no obstacle within
+    // reach of its links has a zero field, which passes the transition test
+    // at any temperature. The validity is kept with the sample, so the
+    // collision check runs once per state.
+    if (!sample.has_validity) {
+      sample.valid = !field_si_ || field_si_->isValid(base_state);
+      sample.has_validity = true;
+    }
+    if (!sample.valid || !isObstacleNear(sample.link_spheres)) {
+      sample.link_to_obs_vec.assign(sample.rob_pts.size(),
+                                    Eigen::Vector3d::Zero());
+      sample.has_field = true;
+      return sample;
+    }
+
+    Eigen::VectorXd flat;
+    if (use_field_grid_ &&
+        field_grid_.interpolate(joint_angles, gridEvaluator(), flat)) {
+      sample.link_to_obs_vec.resize(flat.size() / 3);
+      for (std::size_t i = 0; i < sample.link_to_obs_vec.size(); i++) {
+        sample.link_to_obs_vec[i] = flat.segment<3>(3 * i);
+      }
+    } else {
+      vis_data_->setTotalNumRepulsePts(sample.num_pts);
+      sample.link_to_obs_vec =
+          getLinkToObsVec(sample.rob_pts, sample.link_spheres,
+                          vis_data_->isRecording(sample_state_count_));
+      computed = true;
+    }
+    sample.has_field = true;
+  }
+  return sample;
+}
+
+bool ContactPlanner::isObstacleNear(
+    const std::vector<BoundingSphere>& link_spheres) const {
+  // Obstacles from the perception side are not in the field engine.
+  if (!use_sim_obstacles_) {
+    return true;
+  }
+  return std::any_of(link_spheres.begin(), link_spheres.end(),
+                     [this](const BoundingSphere& sphere) {
+                       return field_engine_.isObstacleNear(sphere);
+                     });
+}
 
-  std::vector<std::vector<Eigen::Vector3d>> rob_pts;
+FieldGridCache::Evaluator ContactPlanner::gridEvaluator() {
+  return [this](const std::vector<double>& joint_angles) {
+    moveit::core::RobotStatePtr robot_state =
+        std::make_shared<moveit::core::RobotState>(*robot_state_);
+    robot_state->setJointGroupPositions(joint_model_group_, joint_angles);
+    std::vector<std::vector<Eigen::Vector3d>> rob_pts;
+    std::vector<BoundingSphere> link_spheres;
+    getPtsOnRobotSurface(robot_state, rob_pts, link_spheres);
+    std::vector<Eigen::Vector3d> link_to_obs_vec =
+        getLinkToObsVec(rob_pts, link_spheres, false);
+
+    Eigen::VectorXd flat(3 * link_to_obs_vec.size());
+    for (std::size_t i = 0; i < link_to_obs_vec.size(); i++) {
+      flat.segment<3>(3 * i) = link_to_obs_vec[i];
+    }
+    return flat;
+  };
+}
 
-  // ROS_INFO_NAMED(LOGNAME, "getPtsOnRobotSurface");
-  std::size_t num_pts = getPtsOnRobotSurface(robot_state, rob_pts);
+void ContactPlanner::trimFieldMemo() {
+  field_grid_.setSceneVersion(scene_version_);
+  if (field_memo_.size() >= MAX_FIELD_MEMO_SIZE) {
+    field_memo_.clear();
+  }
+}
 
-  // ROS_INFO_NAMED(LOGNAME, "setTotalNumRepulsePts %ld", num_pts);
-  vis_data_->setTotalNumRepulsePts(num_pts);
+std::size_t ContactPlanner::FieldMemoKeyHash::operator()(
+    const FieldMemoKey& key) const {
+  std::size_t hash = key.size();
+  for (std::int64_t value : key) {
+    hash ^= std::hash<std::int64_t>()(value) + 0x9e3779b97f4a7c15ULL +
+            (hash << 6) + (hash >> 2);
+  }
+  return hash;
+}
 
-  std::vector<Eigen::Vector3d> link_to_obs_vec = getLinkToObsVec(rob_pts);
+Eigen::VectorXd ContactPlanner::obstacleFieldTaskSpace(
+    const ompl::base::State* base_state) {
   Eigen::VectorXd field_out = Eigen::VectorXd::Zero(dof_);
+  trimFieldMemo();
+  bool computed = false;
+  const FieldSample& sample = getFieldSample(base_state, true, computed);
   for (std::size_t i = 0; i < dof_; i++) {
     {
-      Eigen::Vector3d vec = link_to_obs_vec[i];
+      Eigen::Vector3d vec = sample.link_to_obs_vec[i];
       field_out[i] = vec.norm();
       // std::cout << "field_out[i]: " << field_out[i] << std::endl;
     }
@@ -460,59 +476,48 @@ Eigen::VectorXd ContactPlanner::obstacleFieldTaskSpace(
 
 Eigen::VectorXd ContactPlanner::obstacleFieldCartesian(
     const ompl::base::State* near_state, const ompl::base::State* rand_state) {
-  const ompl::base::RealVectorStateSpace::StateType& vec_state1 =
-      *near_state->as<ompl::base::RealVectorStateSpace::StateType>();
-  std::vector<double> joint_angles1 = utilities::toStlVec(vec_state1, dof_);
-
-  moveit::core::RobotStatePtr robot_state1 =
-      std::make_shared<moveit::core::RobotState>(*robot_state_);
-  robot_state1->setJointGroupPositions(joint_model_group_, joint_angles1);
-  std::vector<std::vector<Eigen::Vector3d>> near_rob_pts;
-  std::size_t num_pts = getPtsOnRobotSurface(robot_state1, near_rob_pts);
+  trimFieldMemo();
 
-  vis_data_->setTotalNumRepulsePts(num_pts);
-  // std::cout << "num pts from near state: " << num_pts << std::endl;
-  std::vector<Eigen::Vector3d> link_to_obs_vec = getLinkToObsVec(near_rob_pts);
-  // std::cout << "link_to_obs_vec.size(): " << link_to_obs_vec.size()
-  //           << std::endl;
+  // The near state is already in the tree and is the near state of many
+  // extensions, its repulsion is only computed the first time.
+  bool near_computed = false;
+  const FieldSample& near_sample =
+      getFieldSample(near_state, true, near_computed);
 
-  const ompl::base::RealVectorStateSpace::StateType& vec_state2 =
-      *rand_state->as<ompl::base::RealVectorStateSpace::StateType>();
-  std::vector<double> joint_angles2 = utilities::toStlVec(vec_state2, dof_);
-
-  moveit::core::RobotStatePtr robot_state2 =
-      std::make_shared<moveit::core::RobotState>(*robot_state_);
-  robot_state2->setJointGroupPositions(joint_model_group_, joint_angles2);
-  std::vector<std::vector<Eigen::Vector3d>> rand_rob_pts;
-  num_pts = getPtsOnRobotSurface(robot_state2, rand_rob_pts);
-  // std::cout << "num pts from rand state: " << num_pts << std::endl;
+  bool rand_computed = false;
+  const FieldSample& rand_sample =
+      getFieldSample(rand_state, false, rand_computed);
 
+  bool record_vis =
+      near_computed && vis_data_->isRecording(sample_state_count_);
   Eigen::VectorXd vfield =
-      getRobtPtsVecDiffAvg(near_rob_pts, rand_rob_pts, link_to_obs_vec);
-
-  vis_data_->saveRepulseAngles(joint_angles1, joint_angles2);
-  sample_state_count_++;
+      getRobtPtsVecDiffAvg(near_sample.rob_pts, rand_sample.rob_pts,
+                           near_sample.link_to_obs_vec, record_vis);
+
+  // Each state is recorded once, when its repulsion is first computed, if the
+  // recording policy selects it.
+  if (record_vis) {
+    const ompl::base::RealVectorStateSpace::StateType& vec_state1 =
+        *near_state->as<ompl::base::RealVectorStateSpace::StateType>();
+    const ompl::base::RealVectorStateSpace::StateType& vec_state2 =
+        *rand_state->as<ompl::base::RealVectorStateSpace::StateType>();
+    vis_data_->saveRepulseAngles(utilities::toStlVec(vec_state1, dof_),
+                                 utilities::toStlVec(vec_state2, dof_));
+  }
+  if (near_computed) {
+    sample_state_count_++;
+  }
   return vfield;
 }
 
 Eigen::VectorXd ContactPlanner::obstacleFieldConfigSpace(
     const ompl::base::State* base_state) {
-  const ompl::base::RealVectorStateSpace::StateType& vec_state =
-      *base_state->as<ompl::base::RealVectorStateSpace::StateType>();
-  std::vector<double> joint_angles = utilities::toStlVec(vec_state, dof_);
-
-  moveit::core::RobotStatePtr robot_state =
-      std::make_shared<moveit::core::RobotState>(*robot_state_);
-  robot_state->setJointGroupPositions(joint_model_group_, joint_angles);
+  trimFieldMemo();
+  bool computed = false;
+  const FieldSample& sample = getFieldSample(base_state, true, computed);
+  const std::vector<Eigen::Vector3d>& link_to_obs_vec = sample.link_to_obs_vec;
 
-  std::vector<std::vector<Eigen::Vector3d>> rob_pts;
-  std::size_t num_pts = getPtsOnRobotSurface(robot_state, rob_pts);
-  // std::cout << "getPtsOnRobotSurface num_pts: " << num_pts << std::endl;
-
-  vis_data_->setTotalNumRepulsePts(num_pts);
-  std::vector<Eigen::Vector3d> link_to_obs_vec = getLinkToObsVec(rob_pts);
-
-  Eigen::MatrixXd jacobian = robot_state->getJacobian(joint_model_group_);
+  const Eigen::MatrixXd& jacobian = sample.jacobian;
 
   // std::vector<ManipulabilityMeasures> manip_per_joint;
 
@@ -594,8 +599,15 @@ Eigen::VectorXd ContactPlanner::obstacleFieldConfigSpace(
   // d_q_out.normalize();
 
   // manipulability_.emplace_back(manip_per_joint);
-  vis_data_->saveRepulseAngles(joint_angles, d_q_out);
-  sample_state_count_++;
+  if (computed) {
+    if (vis_data_->isRecording(sample_state_count_)) {
+      const ompl::base::RealVectorStateSpace::StateType& vec_state =
+          *base_state->as<ompl::base::RealVectorStateSpace::StateType>();
+      vis_data_->saveRepulseAngles(utilities::toStlVec(vec_state, dof_),
+                                   d_q_out);
+    }
+    sample_state_count_++;
+  }
   // std::cout << "d_q_out.norm():\n " << d_q_out.norm() << std::endl;
   // std::cout << "d_q_out:\n " << d_q_out.transpose() << std::endl;
 
@@ -645,86 +657,180 @@ Eigen::VectorXd ContactPlanner::totalField(const ompl::base::State* state) {
   return total_vec;
 }
 
+const PlannerRegistry<ContactPlanner>& ContactPlanner::registry() {
+  static const PlannerRegistry<ContactPlanner> registry = [] {
+    PlannerRegistry<ContactPlanner> r;
+
+    r.addObjective(
+        "UpstreamCost",
+        {[](ContactPlanner& planner) {
+           FieldFunctions fields;
+           fields.state_field =
+               std::bind(&ContactPlanner::obstacleFieldConfigSpace, &planner,
+                         std::placeholders::_1);
+           return fields;
+         },
+         [](const ompl::base::SpaceInformationPtr& si,
+            const FieldFunctions& fields) {
+           return std::make_shared<
+               ompl::base::VFUpstreamCriterionOptimizationObjective>(
+               si, fields.state_field);
+         }});
+
+    r.addObjective(
+        "FieldMagnitude",
+        {[](ContactPlanner& planner) {
+           FieldFunctions fields;
+           fields.state_field =
+               std::bind(&ContactPlanner::obstacleFieldTaskSpace, &planner,
+                         std::placeholders::_1);
+           return fields;
+         },
+         [](const ompl::base::SpaceInformationPtr& si,
+            const FieldFunctions& fields) {
+           return std::make_shared<
+               ompl::base::VFMagnitudeOptimizationObjective>(
+               si, fields.state_field);
+         }});
+
+    r.addObjective(
+        "FieldAlign",
+        {[](ContactPlanner& planner) {
+           // The objective costs states with the configuration space field,
+           // which shares the memoized repulsion of the extension step.
+           FieldFunctions fields;
+           fields.state_field =
+               std::bind(&ContactPlanner::obstacleFieldConfigSpace, &planner,
+                         std::placeholders::_1);
+           fields.motion_field =
+               std::bind(&ContactPlanner::obstacleFieldCartesian, &planner,
+                         std::placeholders::_1, std::placeholders::_2);
+           return fields;
+         },
+         [](const ompl::base::SpaceInformationPtr& si,
+            const FieldFunctions& fields) {
+           return std::make_shared<
+               ompl::base::VFUpstreamCriterionOptimizationObjective>(
+               si, fields.state_field);
+         }});
+
+    FieldParams default_field;
+
+    FieldParams wide_field;
+    wide_field.prox_radius = 0.2;
+
+    FieldParams duo_field = wide_field;
+    duo_field.kernel = FieldParams::Kernel::INVERSE_SQUARE;
+    duo_field.use_goal_attractor = true;
+
+    r.addPlanner("ClassicTRRT",
+                 {[](ContactPlanner&, const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions&) {
+                    return std::make_shared<ompl::geometric::ClassicTRRT>(
+                        ss->getSpaceInformation());
+                  },
+                  default_field});
+
+    r.addPlanner("ContactTRRT",
+                 {[](ContactPlanner&, const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions& fields) {
+                    return std::make_shared<ompl::geometric::ContactTRRT>(
+                        ss->getSpaceInformation(), fields.state_field);
+                  },
+                  default_field});
+
+    r.addPlanner("ContactTRRTDuo",
+                 {[](ContactPlanner&, const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions& fields) {
+                    return std::make_shared<ompl::geometric::ContactTRRT>(
+                        ss->getSpaceInformation(), fields.motion_field);
+                  },
+                  duo_field});
+
+    r.addPlanner("BITstar",
+                 {[](ContactPlanner&, const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions&) {
+                    return std::make_shared<ompl::geometric::BITstar>(
+                        ss->getSpaceInformation());
+                  },
+                  default_field});
+
+    r.addPlanner("RRTstar",
+                 {[](ContactPlanner&, const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions&) {
+                    return std::make_shared<ompl::geometric::RRTstar>(
+                        ss->getSpaceInformation());
+                  },
+                  default_field});
+
+    r.addPlanner("FMT",
+                 {[](ContactPlanner&, const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions&) {
+                    return std::make_shared<ompl::geometric::FMT>(
+                        ss->getSpaceInformation());
+                  },
+                  default_field});
+
+    r.addPlanner("VFRRT",
+                 {[](ContactPlanner&, const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions& fields) {
+                    double exploration = 0.7;
+                    double initial_lambda = 1.0;
+                    std::size_t update_freq = 10;
+                    return std::make_shared<ompl::geometric::VFRRT>(
+                        ss->getSpaceInformation(), fields.state_field,
+                        exploration, initial_lambda, update_freq);
+                  },
+                  wide_field});
+
+    return r;
+  }();
+  return registry;
+}
+
 void ContactPlanner::changePlanner() {
   ompl::geometric::SimpleSetupPtr simple_setup = context_->getOMPLSimpleSetup();
   ompl::base::SpaceInformationPtr si = simple_setup->getSpaceInformation();
-
-  ompl::geometric::PathSimplifierPtr simplifier =
-      simple_setup->getPathSimplifier();
-
-  std::function<Eigen::VectorXd(const ompl::base::State*)> vFieldFunc;
-
-  std::function<Eigen::VectorXd(const ompl::base::State*,
-                                const ompl::base::State*)>
-      vFieldFuncDuo;
-
-  if (objective_name_ == "UpstreamCost") {
-    ROS_INFO_NAMED(LOGNAME, "Using UpstreamCost optimization objective.");
-    vFieldFunc = std::bind(&ContactPlanner::obstacleFieldConfigSpace, this,
-                           std::placeholders::_1);
-    optimization_objective_ =
-        std::make_shared<ompl::base::VFUpstreamCriterionOptimizationObjective>(
-            si, vFieldFunc);
-  } else if (objective_name_ == "FieldMagnitude") {
-    ROS_INFO_NAMED(LOGNAME, "Using FieldMagnitude optimization objective.");
-    vFieldFunc = std::bind(&ContactPlanner::obstacleFieldTaskSpace, this,
-                           std::placeholders::_1);
-    optimization_objective_ =
-        std::make_shared<ompl::base::VFMagnitudeOptimizationObjective>(
-            si, vFieldFunc);
-  } else if (objective_name_ == "FieldAlign") {
-    ROS_INFO_NAMED(LOGNAME, "Using FieldAlign optimization objective.");
-    vFieldFuncDuo = std::bind(&ContactPlanner::obstacleFieldCartesian, this,
-                              std::placeholders::_1, std::placeholders::_2);
-    optimization_objective_ =
-        std::make_shared<ompl::base::VFUpstreamCriterionOptimizationObjective>(
-            si, vFieldFunc);
-  } else {
-    ROS_ERROR_NAMED(LOGNAME, "Invalid optimization objective.");
-  }
-
-  optimization_objective_->setCostToGoHeuristic(
-      &ompl::base::goalRegionCostToGo);
-  simple_setup->setOptimizationObjective(optimization_objective_);
-
-  ompl::base::PlannerPtr planner;
-  if (planner_name_ == "ClassicTRRT") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: ClassicTRRT.");
-    planner = std::make_shared<ompl::geometric::ClassicTRRT>(
-        simple_setup->getSpaceInformation());
-  } else if (planner_name_ == "ContactTRRT") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: ContactTRRT.");
-    planner = std::make_shared<ompl::geometric::ContactTRRT>(
-        simple_setup->getSpaceInformation(), vFieldFunc);
-  } else if (planner_name_ == "ContactTRRTDuo") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: ContactTRRTDuo.");
-    planner = std::make_shared<ompl::geometric::ContactTRRT>(
-        simple_setup->getSpaceInformation(), vFieldFuncDuo);
-  } else if (planner_name_ == "BITstar") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: BITstar.");
-    planner = std::make_shared<ompl::geometric::BITstar>(
-        simple_setup->getSpaceInformation());
-  } else if (planner_name_ == "RRTstar") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: RRTstar.");
-    planner = std::make_shared<ompl::geometric::RRTstar>(
-        simple_setup->getSpaceInformation());
-  } else if (planner_name_ == "FMT") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: FMT.");
-    planner = std::make_shared<ompl::geometric::FMT>(
-        simple_setup->getSpaceInformation());
-  } else if (planner_name_ == "VFRRT") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: VFRRT.");
-    double exploration = 0.7;
-    double initial_lambda = 1.0;
-    std::size_t update_freq = 10.0;
-    planner = std::make_shared<ompl::geometric::VFRRT>(
-        simple_setup->getSpaceInformation(), vFieldFunc, exploration,
-        initial_lambda, update_freq);
+  field_memo_.clear();
+  field_si_ = si;
+
+  FieldFunctions fields;
+  const auto* objective = registry().findObjective(objective_name_);
+  if (objective) {
+    ROS_INFO_NAMED(LOGNAME, "Using %s optimization objective.",
+                   objective_name_.c_str());
+    fields = objective->fields(*this);
+    optimization_objective_ = objective->create(si, fields);
+    optimization_objective_->setCostToGoHeuristic(
+        &ompl::base::goalRegionCostToGo);
+    simple_setup->setOptimizationObjective(optimization_objective_);
   } else {
-    ROS_ERROR_NAMED(LOGNAME, "Invalid planner.");
+    ROS_ERROR_NAMED(LOGNAME, "Invalid optimization objective: %s",
+                    objective_name_.c_str());
   }
 
-  simple_setup->setPlanner(planner);
+  const auto* planner_entry = registry().findPlanner(planner_name_);
+  if (!planner_entry) {
+    ROS_ERROR_NAMED(LOGNAME, "Invalid planner: %s", planner_name_.c_str());
+    return;
+  }
+  ROS_INFO_NAMED(LOGNAME, "Using planner: %s.", planner_name_.c_str());
+  field_engine_.setFieldParams(planner_entry->field_params);
+  field_memo_.clear();
+
+  // The field depends on the planner's field parameters, so the grid only
+  // lives for as long as the planner does.
+  FieldGridCache::Stats grid_stats = field_grid_.getStats();
+  if (grid_stats.interpolated + grid_stats.rejected > 0) {
+    ROS_INFO_NAMED(LOGNAME,
+                   "Previous field grid: %ld interpolated, %ld exact, %ld "
+                   "vertex evaluations",
+                   grid_stats.interpolated, grid_stats.rejected,
+                   grid_stats.vertex_evaluations);
+  }
+  field_grid_.clear();
+  setStateSampler(simple_setup);
+  simple_setup->setPlanner(planner_entry->create(*this, simple_setup, fields));
 }
 
 std::vector<tacbot::ObstacleGroup> ContactPlanner::getSimObstaclePos() {
@@ -745,14 +851,72 @@ std::vector<tacbot::ObstacleGroup> ContactPlanner::getSimObstaclePos() {
   return obstacles;
 };
 
+void ContactPlanner::addContactObstacle(const ExecutionStatus& status,
+                                        double radius) {
+  Eigen::Vector3d center{status.contact_point[0], status.contact_point[1],
+                         status.contact_point[2]};
+  ROS_INFO_NAMED(LOGNAME, "Contact on link %d at (%f, %f, %f)",
+                 status.contact_link, center[0], center[1], center[2]);
+  addSphericalObstacle(center, radius);
+  field_engine_.setObstacles(sim_obstacle_pos_);
+  // the fields cached for the states seen so far do not know the new obstacle
+  field_memo_.clear();
+  scene_version_++;
+}
+
+bool ContactPlanner::monitorExecution(
+    const ExecutionMonitor& monitor, double timeout, ExecutionStatus& status,
+    const std::function<void(const ExecutionStatus&)>& on_contact) {
+  ROS_INFO_NAMED(LOGNAME, "Monitoring trajectory execution.");
+  const ros::WallTime deadline =
+      ros::WallTime::now() + ros::WallDuration(timeout);
+
+  // contacts are added to the obstacles as soon as the controller reports
+  // them, while the robot is still moving
+  bool contact_added = false;
+  std::uint32_t sequence = monitor.read(status);
+  while (true) {
+    if (status.contact_link >= 0 && !contact_added) {
+      addContactObstacle(status);
+      contact_added = true;
+      if (on_contact) {
+        on_contact(status);
+      }
+    }
+    if (status.state == ExecutionStatus::FINISHED ||
+        status.state == ExecutionStatus::FAILED) {
+      break;
+    }
+    double remaining = (deadline - ros::WallTime::now()).toSec();
+    if (remaining <= 0.0 ||
+        !monitor.waitForUpdate(sequence, remaining, status)) {
+      ROS_ERROR_NAMED(LOGNAME, "Timed out while monitoring execution.");
+      return false;
+    }
+  }
+
+  if (status.state == ExecutionStatus::FAILED) {
+    ROS_ERROR_NAMED(LOGNAME, "Execution failure on trajectory point %u",
+                    status.pt_idx);
+    return false;
+  }
+
+  ROS_INFO_NAMED(LOGNAME, "Finished trajectory execution monitoring.");
+  return true;
+}
+
 void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
-  for (std::size_t i = 0; spherical_obstacles_.size(); i++) {
+  for (std::size_t i = 0; i < spherical_obstacles_.size(); i++) {
     auto sphere = spherical_obstacles_[i];
     tacbot::ObstacleGroup obstacle;
     obstacle.center = sphere.first;
     obstacle.radius = sphere.second;
     obstacle.name = "sphere_" + std::to_string(i);
-    contact_perception_->addSphere(obstacle);
+    if (contact_perception_) {
+      contact_perception_->addSphere(obstacle);
+    } else {
+      addCollisionObject(ContactPerception::sphereToCollisionObject(obstacle));
+    }
   }
 
   PlanAnalysisData& plan_analysis = benchmark_data.plan_analysis;
@@ -764,27 +928,23 @@ void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
   plan_analysis.num_path_states = num_pts;
   ROS_INFO_NAMED(LOGNAME, "Trajectory num_pts: %ld", num_pts);
 
-  planning_scene_monitor::LockedPlanningSceneRW(psm_)->addCollisionDetector(
+  scene_handle_.write()->addCollisionDetector(
       collision_detection::CollisionDetectorAllocatorBullet::create());
 
-  planning_scene_monitor::LockedPlanningSceneRW(psm_)
-      ->setActiveCollisionDetector("Bullet");
+  scene_handle_.write()->setActiveCollisionDetector("Bullet");
 
   const std::string active_col_det =
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)
-          ->getActiveCollisionDetectorName();
+      scene_handle_.read()->getActiveCollisionDetectorName();
   ROS_INFO_NAMED(LOGNAME, "active_col_det: %s", active_col_det.c_str());
 
   std::vector<std::string> col_det_names;
-  planning_scene_monitor::LockedPlanningSceneRO(psm_)
-      ->getCollisionDetectorNames(col_det_names);
+  scene_handle_.read()->getCollisionDetectorNames(col_det_names);
   for (auto name : col_det_names) {
     std::cout << "active col det name: " << name << std::endl;
   }
 
   const collision_detection::CollisionEnvConstPtr collision_env =
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)
-          ->getCollisionEnvUnpadded();
+      scene_handle_.read()->getCollisionEnvUnpadded();
 
   collision_detection::CollisionRequest collision_request;
   collision_request.distance = false;
@@ -803,15 +963,29 @@ void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
   distance_request.verbose = true;
   distance_request.max_contacts_per_body = 1;
   distance_request.compute_gradient = false;
-  distance_request.enableGroup(psm_->getPlanningScene()->getRobotModel());
+  distance_request.enableGroup(robot_model_);
 
   collision_detection::AllowedCollisionMatrix acm =
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)
-          ->getAllowedCollisionMatrix();
+      scene_handle_.read()->getAllowedCollisionMatrix();
   distance_request.acm = &acm;
 
-  moveit::core::RobotState prev_robot_state(
-      psm_->getPlanningScene()->getRobotModel());
+  // The repulsion along the whole trajectory is evaluated in one batch.
+  const std::size_t num_variables = joint_model_group_->getVariableCount();
+  std::vector<double> joint_values(num_pts * num_variables, 0.0);
+  for (std::size_t pt_idx = 0; pt_idx < num_pts; pt_idx++) {
+    const std::vector<double>& positions =
+        msg.trajectory.joint_trajectory.points[pt_idx].positions;
+    std::copy_n(positions.begin(), std::min(num_variables, positions.size()),
+                joint_values.begin() + pt_idx * num_variables);
+  }
+  FieldEngine::FieldBatch field_batch;
+  field_engine_.evaluateBatch(*robot_state_, joint_model_group_, dof_,
+                              joint_values.data(), num_pts, field_batch);
+  plan_analysis.trajectory_analysis.field_cost.assign(
+      field_batch.costs.data(), field_batch.costs.data() + num_pts);
+  plan_analysis.total_field_cost = field_batch.costs.sum();
+
+  moveit::core::RobotState prev_robot_state(robot_model_);
   Eigen::Vector3d prev_tip_pos;
 
   for (std::size_t pt_idx = 0; pt_idx < num_pts; pt_idx++) {
@@ -825,8 +999,7 @@ void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
       joint_angles[jnt_idx] = point.positions[jnt_idx];
     }
 
-    moveit::core::RobotState robot_state(
-        psm_->getPlanningScene()->getRobotModel());
+    moveit::core::RobotState robot_state(robot_model_);
     robot_state.setJointGroupPositions(joint_model_group_, joint_angles);
     robot_state.update();
 
@@ -836,7 +1009,7 @@ void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
         robot_state.getGlobalLinkTransform("panda_link8");
     Eigen::Vector3d tip_pos{tip_tf.translation().x(), tip_tf.translation().y(),
                             tip_tf.translation().z()};
-    vis_data_->ee_path_pts_.emplace_back(tip_pos);
+    vis_data_->saveEEPathPt(tip_pos, pt_idx, num_pts);
 
     if (pt_idx > 0) {
       double dist_travelled = robot_state.distance(prev_robot_state);
@@ -853,7 +1026,7 @@ void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
     // COLLISION
 
     collision_detection::CollisionResult collision_result;
-    planning_scene_monitor::LockedPlanningSceneRO(psm_)->checkCollisionUnpadded(
+    scene_handle_.read()->checkCollisionUnpadded(
         collision_request, collision_result, robot_state);
     bool collision = collision_result.collision;
 
@@ -906,6 +1079,8 @@ void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
                  plan_analysis.joint_path_len);
   ROS_INFO_NAMED(LOGNAME, "plan_analysis.ee_path_len: %f",
                  plan_analysis.ee_path_len);
+  ROS_INFO_NAMED(LOGNAME, "plan_analysis.total_field_cost: %f",
+                 plan_analysis.total_field_cost);
   ROS_INFO_NAMED(LOGNAME, "plan_analysis.num_contact_states: %ld",
                  plan_analysis.num_contact_states);
   ROS_INFO_NAMED(LOGNAME, "plan_analysis.num_path_states: %ld",
@@ -916,6 +1091,13 @@ void ContactPlanner::analyzePlanResponse(BenchMarkData& benchmark_data) {
 
 void ContactPlanner::init() {
   BasePlanner::init();
+  contact_perception_ = std::make_shared<ContactPerception>();
+  extractPtsFromGoalState();
+}
+
+void ContactPlanner::init(const std::string& urdf_path,
+                          const std::string& srdf_path) {
+  BasePlanner::init(urdf_path, srdf_path);
   extractPtsFromGoalState();
 }
 
@@ -0,0 +1,88 @@
+#include "control_log.h"
+
+#include <chrono>
+
+namespace tacbot {
+
+ControlLogger::ControlLogger(std::size_t capacity) : buffer_(capacity) {}
+
+ControlLogger::~ControlLogger() { stop(); }
+
+bool ControlLogger::start(const std::string& path) {
+  if (isRunning()) {
+    return false;
+  }
+  file_.open(path, std::ios::out | std::ios::trunc);
+  if (!file_.is_open()) {
+    return false;
+  }
+
+  file_ << "time,period";
+  for (const char* name : {"q", "dq", "ddq_d", "tau_J", "command"}) {
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      file_ << "," << name << jnt_idx;
+    }
+  }
+  file_ << "\n";
+
+  // a callback that saw the previous recording running may have pushed its
+  // sample after the writer's last pass, it does not belong to this one
+  ControlSample stale;
+  while (buffer_.pop(stale)) {
+  }
+
+  dropped_.store(0, std::memory_order_relaxed);
+  running_.store(true, std::memory_order_release);
+  writer_ = std::thread(&ControlLogger::drain, this);
+  return true;
+}
+
+void ControlLogger::stop() {
+  if (!isRunning()) {
+    return;
+  }
+  running_.store(false, std::memory_order_release);
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  file_.close();
+}
+
+void ControlLogger::record(const ControlSample& sample) {
+  if (!running_.load(std::memory_order_acquire)) {
+    return;
+  }
+  if (!buffer_.push(sample)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ControlLogger::drain() {
+  ControlSample sample;
+  while (true) {
+    // read the flag before draining, so that the samples pushed before stop
+    // are all written by the last pass
+    bool running = running_.load(std::memory_order_acquire);
+    while (buffer_.pop(sample)) {
+      write(sample);
+    }
+    if (!running) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  file_.flush();
+}
+
+void ControlLogger::write(const ControlSample& sample) {
+  file_ << sample.time << "," << sample.period;
+  for (const std::array<double, 7>* values :
+       {&sample.q, &sample.dq, &sample.ddq_d, &sample.tau_J, &sample.command}) {
+    for (double value : *values) {
+      file_ << "," << value;
+    }
+  }
+  file_ << "\n";
+}
+
+}  // namespace tacbot
@@ -0,0 +1,140 @@
+#include "cycle_timing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace tacbot {
+
+std::size_t LatencyHistogram::bucketIndex(std::uint64_t value) {
+  value = std::min<std::uint64_t>(value, (2ull << MAX_EXPONENT) - 1);
+  // values below 2^(SUB_BUCKET_BITS + 1) get a bucket each, above that every
+  // power of two gets 2^SUB_BUCKET_BITS buckets
+  const int exponent = value == 0 ? 0 : 63 - __builtin_clzll(value);
+  const int shift = std::max(0, exponent - SUB_BUCKET_BITS);
+  return (static_cast<std::size_t>(shift) << SUB_BUCKET_BITS) +
+         static_cast<std::size_t>(value >> shift);
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t index) {
+  if (index < (2u << SUB_BUCKET_BITS)) {
+    return index;
+  }
+  const std::size_t shift = (index >> SUB_BUCKET_BITS) - 1;
+  const std::uint64_t mantissa = index - (shift << SUB_BUCKET_BITS);
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t value) {
+  counts_[bucketIndex(value)]++;
+  count_++;
+  max_ = std::max(max_, value);
+  sum_ += static_cast<double>(value);
+}
+
+void LatencyHistogram::reset() {
+  counts_.fill(0);
+  count_ = 0;
+  max_ = 0;
+  sum_ = 0.0;
+}
+
+double LatencyHistogram::getMean() const {
+  return count_ == 0 ? 0.0 : sum_ / static_cast<double>(count_);
+}
+
+std::uint64_t LatencyHistogram::getValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  if (percentile == 100.0) {
+    return max_;
+  }
+  const std::uint64_t rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(
+             std::ceil(percentile / 100.0 * static_cast<double>(count_))));
+
+  std::uint64_t seen = 0;
+  for (std::size_t idx = 0; idx < BUCKET_COUNT; idx++) {
+    seen += counts_[idx];
+    if (seen >= rank) {
+      return std::min(bucketUpperBound(idx), max_);
+    }
+  }
+  return max_;
+}
+
+CycleTimer::CycleTimer(double budget, double nominal_period)
+    : budget_ns_(static_cast<std::uint64_t>(budget * 1e9)),
+      nominal_period_ns_(static_cast<std::uint64_t>(nominal_period * 1e9)) {}
+
+void CycleTimer::reset() {
+  has_last_cycle_ = false;
+  compute_time_.reset();
+  jitter_.reset();
+  over_budget_ = 0;
+  missed_cycles_ = 0;
+}
+
+void CycleTimer::begin(double period) {
+  cycle_start_ = Clock::now();
+  if (has_last_cycle_) {
+    const std::int64_t interval =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(cycle_start_ -
+                                                             last_cycle_start_)
+            .count();
+    const std::int64_t deviation =
+        interval - static_cast<std::int64_t>(nominal_period_ns_);
+    jitter_.record(static_cast<std::uint64_t>(std::abs(deviation)));
+  }
+  last_cycle_start_ = cycle_start_;
+  has_last_cycle_ = true;
+
+  // the first cycle of a motion has a period of zero
+  const auto periods = static_cast<std::uint64_t>(
+      std::llround(period * 1e9 / static_cast<double>(nominal_period_ns_)));
+  if (periods > 1) {
+    missed_cycles_ += periods - 1;
+  }
+}
+
+void CycleTimer::end() {
+  const auto compute_time =
+      static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               cycle_start_)
+              .count());
+  compute_time_.record(compute_time);
+  if (compute_time > budget_ns_) {
+    over_budget_++;
+  }
+}
+
+void CycleTimer::setBudget(double budget) {
+  budget_ns_ = static_cast<std::uint64_t>(budget * 1e9);
+}
+
+double CycleTimer::getBudget() const {
+  return static_cast<double>(budget_ns_) * 1e-9;
+}
+
+void CycleTimer::report(const std::string& name, std::ostream& out) const {
+  const auto us = [](std::uint64_t ns) {
+    return static_cast<double>(ns) * 1e-3;
+  };
+  const std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(1) << name << ": " << getCycles()
+      << " cycles, compute [us] mean " << compute_time_.getMean() * 1e-3
+      << " p50 " << us(compute_time_.getValueAtPercentile(50))
+      << " p99 " << us(compute_time_.getValueAtPercentile(99))
+      << " p99.9 " << us(compute_time_.getValueAtPercentile(99.9)) << " max "
+      << us(compute_time_.getMax()) << ", jitter [us] p50 "
+      << us(jitter_.getValueAtPercentile(50)) << " p99 "
+      << us(jitter_.getValueAtPercentile(99)) << " max "
+      << us(jitter_.getMax()) << ", over budget " << over_budget_
+      << ", missed cycles " << missed_cycles_ << std::endl;
+  out.flags(flags);
+}
+
+}  // namespace tacbot
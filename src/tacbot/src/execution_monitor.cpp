@@ -0,0 +1,197 @@
+#include "execution_monitor.h"
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+namespace tacbot {
+
+namespace {
+
+constexpr std::uint64_t MAGIC = 0x5442455845433031;  // "TBEXEC01"
+
+// the block is shared between processes, so the futex must not be private
+long futexWait(std::atomic<std::uint32_t>* word, std::uint32_t value,
+               const timespec* timeout) {
+  return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAIT,
+                 value, timeout, nullptr, 0);
+}
+
+long futexWakeAll(std::atomic<std::uint32_t>* word) {
+  return syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAKE,
+                 INT32_MAX, nullptr, nullptr, 0);
+}
+
+}  // namespace
+
+ExecutionMonitor::~ExecutionMonitor() { close(); }
+
+bool ExecutionMonitor::open(const std::string& name, bool create) {
+  close();
+
+  int flags = O_RDWR;
+  if (create) {
+    flags |= O_CREAT;
+  }
+  int fd = shm_open(name.c_str(), flags, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  if (create && ftruncate(fd, sizeof(SharedBlock)) != 0) {
+    ::close(fd);
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 ||
+      static_cast<std::size_t>(file_stat.st_size) < sizeof(SharedBlock)) {
+    ::close(fd);
+    return false;
+  }
+
+  void* memory = mmap(nullptr, sizeof(SharedBlock), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (memory == MAP_FAILED) {
+    return false;
+  }
+
+  if (create) {
+    block_ = new (memory) SharedBlock();
+    block_->sequence.store(0, std::memory_order_relaxed);
+    block_->waiters.store(0, std::memory_order_relaxed);
+    ExecutionStatus status;
+    std::uint64_t words[WORD_COUNT] = {};
+    std::memcpy(words, &status, sizeof(status));
+    for (std::size_t i = 0; i < WORD_COUNT; i++) {
+      block_->words[i].store(words[i], std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    block_->magic = MAGIC;
+  } else {
+    block_ = static_cast<SharedBlock*>(memory);
+    if (block_->magic != MAGIC) {
+      munmap(memory, sizeof(SharedBlock));
+      block_ = nullptr;
+      return false;
+    }
+  }
+
+  name_ = name;
+  owner_ = create;
+  return true;
+}
+
+void ExecutionMonitor::close() {
+  if (block_ == nullptr) {
+    return;
+  }
+  munmap(block_, sizeof(SharedBlock));
+  block_ = nullptr;
+  if (owner_) {
+    shm_unlink(name_.c_str());
+  }
+  owner_ = false;
+}
+
+void ExecutionMonitor::publish(const ExecutionStatus& status) {
+  std::uint64_t words[WORD_COUNT] = {};
+  std::memcpy(words, &status, sizeof(status));
+
+  const std::uint32_t sequence =
+      block_->sequence.load(std::memory_order_relaxed);
+  block_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::size_t i = 0; i < WORD_COUNT; i++) {
+    block_->words[i].store(words[i], std::memory_order_relaxed);
+  }
+  // sequentially consistent, so that either the writer sees the waiter or the
+  // waiter sees the new sequence number before it goes to sleep
+  block_->sequence.store(sequence + 2, std::memory_order_seq_cst);
+  if (block_->waiters.load(std::memory_order_seq_cst) > 0) {
+    futexWakeAll(&block_->sequence);
+  }
+}
+
+std::uint32_t ExecutionMonitor::read(ExecutionStatus& status) const {
+  std::uint64_t words[WORD_COUNT];
+  while (true) {
+    const std::uint32_t before =
+        block_->sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;
+    }
+    for (std::size_t i = 0; i < WORD_COUNT; i++) {
+      words[i] = block_->words[i].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (block_->sequence.load(std::memory_order_relaxed) == before) {
+      std::memcpy(&status, words, sizeof(status));
+      return before;
+    }
+  }
+}
+
+bool ExecutionMonitor::waitForUpdate(std::uint32_t& sequence, double timeout,
+                                     ExecutionStatus& status) const {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(timeout));
+
+  while (true) {
+    block_->waiters.fetch_add(1, std::memory_order_seq_cst);
+    const std::uint32_t current =
+        block_->sequence.load(std::memory_order_seq_cst);
+    if (current != sequence) {
+      block_->waiters.fetch_sub(1, std::memory_order_relaxed);
+      // if the writer is in the middle of an update, read waits for it
+      sequence = read(status);
+      return true;
+    }
+
+    const Clock::duration remaining = deadline - Clock::now();
+    if (remaining <= Clock::duration::zero()) {
+      block_->waiters.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    const auto remaining_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(remaining)
+            .count();
+    timespec relative;
+    relative.tv_sec = remaining_ns / 1000000000;
+    relative.tv_nsec = remaining_ns % 1000000000;
+    // returns immediately if the sequence number has changed in the meantime
+    futexWait(&block_->sequence, current, &relative);
+    block_->waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+bool ExecutionMonitor::waitForCompletion(double timeout,
+                                         ExecutionStatus& status) const {
+  using Clock = std::chrono::steady_clock;
+  const Clock::time_point deadline =
+      Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                         std::chrono::duration<double>(timeout));
+
+  std::uint32_t sequence = read(status);
+  while (status.state != ExecutionStatus::FINISHED &&
+         status.state != ExecutionStatus::FAILED) {
+    const double remaining =
+        std::chrono::duration<double>(deadline - Clock::now()).count();
+    if (remaining <= 0.0 || !waitForUpdate(sequence, remaining, status)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace tacbot
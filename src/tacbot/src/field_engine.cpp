@@ -0,0 +1,511 @@
+#include "field_engine.h"
+
+#include <geometric_shapes/shapes.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace tacbot {
+
+void BoundingSphere::merge(const BoundingSphere& other) {
+  Eigen::Vector3d diff = other.center - center;
+  double dist = diff.norm();
+  if (dist + other.radius <= radius) {
+    return;
+  }
+  if (dist + radius <= other.radius) {
+    *this = other;
+    return;
+  }
+  double new_radius = 0.5 * (dist + radius + other.radius);
+  center += diff * ((new_radius - radius) / dist);
+  radius = new_radius;
+}
+
+FieldEngine::FieldEngine() {}
+
+FieldEngine::FieldEngine(const Options& options) : options_(options) {}
+
+void FieldEngine::setOptions(const Options& options) {
+  std::lock_guard<std::mutex> lock(surfaces_mutex_);
+  options_ = options;
+  if (options_.lod_spacings.empty()) {
+    options_.lod_spacings.emplace_back(0.05);
+  }
+  surfaces_.clear();
+}
+
+void FieldEngine::setObstacles(const std::vector<Eigen::Vector3d>& obstacles) {
+  obstacles_ = obstacles;
+  rebuildIndex();
+}
+
+void FieldEngine::setFieldParams(const FieldParams& params) {
+  params_ = params;
+  rebuildIndex();
+}
+
+double FieldEngine::getReach() const { return std::sqrt(params_.prox_radius); }
+
+long FieldEngine::cellIdx(double coord) const {
+  return static_cast<long>(std::floor(coord / cell_size_));
+}
+
+std::int64_t FieldEngine::cellKey(long x, long y, long z) const {
+  // 21 bits per axis is plenty for a workspace of a few meters.
+  const std::int64_t mask = (1 << 21) - 1;
+  return ((x & mask) << 42) | ((y & mask) << 21) | (z & mask);
+}
+
+void FieldEngine::rebuildIndex() {
+  cells_.clear();
+  num_obstacles_ = obstacles_.size();
+  cell_size_ = std::max(getReach(), 0.01);
+  for (const Eigen::Vector3d& obstacle : obstacles_) {
+    cells_[cellKey(cellIdx(obstacle[0]), cellIdx(obstacle[1]),
+                   cellIdx(obstacle[2]))]
+        .emplace_back(obstacle);
+  }
+}
+
+bool FieldEngine::isObstacleNear(const BoundingSphere& sphere) const {
+  const double range = sphere.radius + getReach();
+  const double range_sq = range * range;
+  const Eigen::Vector3d& c = sphere.center;
+  for (long x = cellIdx(c[0] - range); x <= cellIdx(c[0] + range); x++) {
+    for (long y = cellIdx(c[1] - range); y <= cellIdx(c[1] + range); y++) {
+      for (long z = cellIdx(c[2] - range); z <= cellIdx(c[2] + range); z++) {
+        auto it = cells_.find(cellKey(x, y, z));
+        if (it == cells_.end()) {
+          continue;
+        }
+        for (const Eigen::Vector3d& obstacle : it->second) {
+          if ((obstacle - c).squaredNorm() <= range_sq) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+  return false;
+}
+
+double FieldEngine::nearestObstacleDistance(const Eigen::Vector3d& pt,
+                                            double max_dist) const {
+  double best_sq = max_dist * max_dist;
+  bool found = false;
+  for (long x = cellIdx(pt[0] - max_dist); x <= cellIdx(pt[0] + max_dist);
+       x++) {
+    for (long y = cellIdx(pt[1] - max_dist); y <= cellIdx(pt[1] + max_dist);
+         y++) {
+      for (long z = cellIdx(pt[2] - max_dist); z <= cellIdx(pt[2] + max_dist);
+           z++) {
+        auto it = cells_.find(cellKey(x, y, z));
+        if (it == cells_.end()) {
+          continue;
+        }
+        for (const Eigen::Vector3d& obstacle : it->second) {
+          double dist_sq = (obstacle - pt).squaredNorm();
+          if (dist_sq <= best_sq) {
+            best_sq = dist_sq;
+            found = true;
+          }
+        }
+      }
+    }
+  }
+  return found ? std::sqrt(best_sq) : std::numeric_limits<double>::infinity();
+}
+
+void FieldEngine::appendShapePts(
+    const moveit::core::LinkModel* link_model,
+    const Eigen::Isometry3d& link_to_slot,
+    std::vector<Eigen::Vector3d>& local_pts) const {
+  const std::vector<shapes::ShapeConstPtr>& shapes = link_model->getShapes();
+  for (std::size_t j = 0; j < shapes.size(); ++j) {
+    if (shapes[j]->type != shapes::MESH) {
+      // should somehow extract points from this as well
+      continue;
+    }
+
+    Eigen::Isometry3d shape_to_slot =
+        link_to_slot * link_model->getCollisionOriginTransforms()[j];
+    std::unique_ptr<shapes::Mesh> mesh(
+        static_cast<shapes::Mesh*>(shapes[j]->clone()));
+    mesh->mergeVertices(options_.lod_spacings.front());
+    for (unsigned int k = 0; k < mesh->vertex_count; ++k) {
+      Eigen::Vector3d mesh_pt(mesh->vertices[3 * k], mesh->vertices[3 * k + 1],
+                              mesh->vertices[3 * k + 2]);
+      local_pts.emplace_back(shape_to_slot * mesh_pt);
+    }
+  }
+}
+
+FieldEngine::LinkSurfacePtr FieldEngine::getLinkSurface(
+    const LinkSlot& slot) {
+  std::lock_guard<std::mutex> lock(surfaces_mutex_);
+  auto it = surfaces_.find(slot.link_model);
+  if (it != surfaces_.end()) {
+    return it->second;
+  }
+
+  std::vector<Eigen::Vector3d> pts;
+  if (slot.use_fixed_links) {
+    for (const auto& fixed_link :
+         slot.link_model->getAssociatedFixedTransforms()) {
+      appendShapePts(fixed_link.first, fixed_link.second, pts);
+    }
+  } else {
+    appendShapePts(slot.link_model, Eigen::Isometry3d::Identity(), pts);
+  }
+
+  auto new_surface = std::make_shared<LinkSurface>(
+      buildLinkSurface(pts, options_.lod_spacings));
+  surfaces_[slot.link_model] = new_surface;
+  return new_surface;
+}
+
+FieldEngine::LinkSurface FieldEngine::buildLinkSurface(
+    const std::vector<Eigen::Vector3d>& pts,
+    const std::vector<double>& lod_spacings) {
+  LinkSurface surface;
+  const std::size_t num_levels = lod_spacings.size();
+  const std::size_t num_pts = pts.size();
+  surface.level_counts.assign(num_levels, 0);
+  if (num_pts == 0) {
+    return surface;
+  }
+
+  // Farthest point order. The distance of each new point to the ones before it
+  // only shrinks, so the points that are at least a spacing apart from all
+  // earlier points form a prefix.
+  std::vector<double> min_dist(num_pts, std::numeric_limits<double>::max());
+  std::vector<bool> used(num_pts, false);
+  std::size_t next = 0;
+  for (std::size_t k = 0; k < num_pts; k++) {
+    double spacing = k == 0 ? std::numeric_limits<double>::max()
+                            : min_dist[next];
+    used[next] = true;
+    surface.local_pts.emplace_back(pts[next]);
+    for (std::size_t l = 1; l < num_levels; l++) {
+      if (spacing >= lod_spacings[l]) {
+        surface.level_counts[l] = k + 1;
+      }
+    }
+
+    std::size_t farthest = next;
+    double farthest_dist = -1.0;
+    for (std::size_t p = 0; p < num_pts; p++) {
+      if (used[p]) {
+        continue;
+      }
+      min_dist[p] = std::min(min_dist[p], (pts[p] - pts[next]).norm());
+      if (min_dist[p] > farthest_dist) {
+        farthest_dist = min_dist[p];
+        farthest = p;
+      }
+    }
+    next = farthest;
+  }
+  if (num_levels > 0) {
+    surface.level_counts[0] = num_pts;
+  }
+
+  Eigen::Vector3d lo = pts[0];
+  Eigen::Vector3d hi = pts[0];
+  for (const Eigen::Vector3d& pt : pts) {
+    lo = lo.cwiseMin(pt);
+    hi = hi.cwiseMax(pt);
+  }
+  surface.local_sphere.center = 0.5 * (lo + hi);
+  for (const Eigen::Vector3d& pt : pts) {
+    surface.local_sphere.radius = std::max(
+        surface.local_sphere.radius, (pt - surface.local_sphere.center).norm());
+  }
+  return surface;
+}
+
+std::vector<std::size_t> FieldEngine::choosePtCounts(
+    const std::vector<const LinkSurface*>& surfaces,
+    const std::vector<BoundingSphere>& link_spheres) const {
+  const std::size_t num_links = surfaces.size();
+  if (num_links == 0) {
+    return {};
+  }
+
+  // The levels of the surfaces at hand, which the options may have moved on
+  // from if they were changed meanwhile.
+  std::size_t num_levels = surfaces.front()->level_counts.size();
+  for (const LinkSurface* surface : surfaces) {
+    num_levels = std::min(num_levels, surface->level_counts.size());
+  }
+  const std::size_t default_level = std::min<std::size_t>(1, num_levels - 1);
+  const double reach = getReach();
+
+  std::vector<std::size_t> levels(num_links, default_level);
+  std::vector<double> gaps(num_links, std::numeric_limits<double>::infinity());
+  if (hasObstacles()) {
+    for (std::size_t i = 0; i < num_links; i++) {
+      const BoundingSphere& sphere = link_spheres[i];
+      gaps[i] = nearestObstacleDistance(sphere.center, sphere.radius + reach) -
+                sphere.radius;
+      if (gaps[i] <= 0.0) {
+        levels[i] = 0;
+      } else if (gaps[i] >= reach || num_levels < 3) {
+        levels[i] = num_levels - 1;
+      } else {
+        levels[i] = std::min(
+            num_levels - 1,
+            1 + static_cast<std::size_t>(gaps[i] / reach * (num_levels - 2)));
+      }
+    }
+  }
+
+  std::vector<std::size_t> counts(num_links);
+  std::size_t total = 0;
+  for (std::size_t i = 0; i < num_links; i++) {
+    counts[i] = surfaces[i]->level_counts[levels[i]];
+    total += counts[i];
+  }
+  if (options_.max_pts == 0 || total <= options_.max_pts) {
+    return counts;
+  }
+
+  // Coarsen the links that are farthest from the obstacles first.
+  std::vector<std::size_t> order(num_links);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&](std::size_t a, std::size_t b) {
+                     return gaps[a] > gaps[b];
+                   });
+  for (std::size_t i : order) {
+    while (levels[i] + 1 < num_levels && total > options_.max_pts) {
+      levels[i]++;
+      std::size_t count = surfaces[i]->level_counts[levels[i]];
+      total -= counts[i] - count;
+      counts[i] = count;
+    }
+  }
+
+  // Even the coarsest levels are over the budget, shorten every prefix.
+  if (total > options_.max_pts) {
+    double scale = static_cast<double>(options_.max_pts) / total;
+    for (std::size_t& count : counts) {
+      if (count > 0) {
+        count = std::max<std::size_t>(1, count * scale);
+      }
+    }
+  }
+  return counts;
+}
+
+std::size_t FieldEngine::getPtsOnRobotSurface(
+    const moveit::core::RobotState& robot_state,
+    const moveit::core::JointModelGroup* joint_model_group, std::size_t dof,
+    std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+    std::vector<BoundingSphere>& link_spheres, bool full_detail) {
+  const std::vector<const moveit::core::LinkModel*>& link_models =
+      joint_model_group->getLinkModels();
+  std::size_t num_links = link_models.size();
+
+  std::vector<LinkSlot> slots;
+  for (std::size_t i = 0; i < num_links; i++) {
+    const moveit::core::LinkModel* link_model = link_models[i];
+    bool no_shapes = link_model->getShapes().empty() &&
+                     !link_model->getAssociatedFixedTransforms().empty();
+
+    // the last link does not have a mesh for some reason, the points of the
+    // links that are fixed to it are used instead
+    if (i >= dof - 1 || no_shapes) {
+      if (i == num_links - 1) {
+        slots.push_back({link_model, true});
+      }
+      continue;
+    }
+    slots.push_back({link_model, false});
+  }
+
+  // Holding on to the surfaces keeps them alive if the options change while
+  // the points are placed.
+  std::vector<LinkSurfacePtr> held_surfaces;
+  std::vector<const LinkSurface*> surfaces;
+  link_spheres.clear();
+  for (const LinkSlot& slot : slots) {
+    held_surfaces.emplace_back(getLinkSurface(slot));
+    const LinkSurface& surface = *held_surfaces.back();
+    const Eigen::Isometry3d& transform =
+        robot_state.getGlobalLinkTransform(slot.link_model);
+    BoundingSphere sphere;
+    sphere.center = transform * surface.local_sphere.center;
+    sphere.radius = surface.local_sphere.radius;
+    surfaces.emplace_back(&surface);
+    link_spheres.emplace_back(sphere);
+  }
+
+  std::vector<std::size_t> counts;
+  if (full_detail) {
+    for (const LinkSurface* surface : surfaces) {
+      counts.emplace_back(surface->local_pts.size());
+    }
+  } else {
+    counts = choosePtCounts(surfaces, link_spheres);
+  }
+
+  rob_pts.clear();
+  std::size_t num_pts = 0;
+  for (std::size_t i = 0; i < slots.size(); i++) {
+    const Eigen::Isometry3d& transform =
+        robot_state.getGlobalLinkTransform(slots[i].link_model);
+    std::vector<Eigen::Vector3d> link_pts;
+    link_pts.reserve(counts[i]);
+    for (std::size_t j = 0; j < counts[i]; j++) {
+      link_pts.emplace_back(transform * surfaces[i]->local_pts[j]);
+    }
+    num_pts += counts[i];
+    rob_pts.emplace_back(std::move(link_pts));
+  }
+  return num_pts;
+}
+
+Eigen::Matrix3Xd FieldEngine::gatherObstacles(const BoundingSphere& sphere,
+                                              double range) const {
+  const double full_range = sphere.radius + range;
+  const double full_range_sq = full_range * full_range;
+  const Eigen::Vector3d& c = sphere.center;
+  std::vector<const Eigen::Vector3d*> found;
+  for (long x = cellIdx(c[0] - full_range); x <= cellIdx(c[0] + full_range);
+       x++) {
+    for (long y = cellIdx(c[1] - full_range); y <= cellIdx(c[1] + full_range);
+         y++) {
+      for (long z = cellIdx(c[2] - full_range);
+           z <= cellIdx(c[2] + full_range); z++) {
+        auto it = cells_.find(cellKey(x, y, z));
+        if (it == cells_.end()) {
+          continue;
+        }
+        for (const Eigen::Vector3d& obstacle : it->second) {
+          if ((obstacle - c).squaredNorm() <= full_range_sq) {
+            found.emplace_back(&obstacle);
+          }
+        }
+      }
+    }
+  }
+
+  Eigen::Matrix3Xd obstacles(3, found.size());
+  for (std::size_t k = 0; k < found.size(); k++) {
+    obstacles.col(k) = *found[k];
+  }
+  return obstacles;
+}
+
+Eigen::Vector3d FieldEngine::repulsionSum(const Eigen::Vector3d& pt,
+                                          const Eigen::Matrix3Xd& obstacles,
+                                          const Eigen::Vector3d* att_pt) const {
+  Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+  Eigen::Matrix3Xd vecs = (-obstacles).colwise() + pt;
+  Eigen::RowVectorXd dist_sq = vecs.colwise().squaredNorm();
+  for (Eigen::Index k = 0; k < vecs.cols(); k++) {
+    // Obstacles out of reach scale to zero and do not contribute.
+    if (dist_sq[k] > params_.prox_radius) {
+      continue;
+    }
+    Eigen::Vector3d vec = params_.scale(vecs.col(k));
+    if (att_pt && vec.norm() != 0.0) {
+      Eigen::Vector3d att_vec = (*att_pt - pt).normalized();
+      if (att_vec.dot(vec) < -0.5) {
+        att_vec = Eigen::Vector3d::Zero();
+      }
+      vec += 0.5 * att_vec;
+    }
+    sum += vec;
+  }
+  return sum;
+}
+
+void FieldEngine::evaluatePtsBatch(
+    const std::vector<std::vector<std::vector<Eigen::Vector3d>>>& rob_pts,
+    const std::vector<std::vector<BoundingSphere>>& link_spheres,
+    FieldBatch& batch) const {
+  const std::size_t num_states = rob_pts.size();
+  std::size_t num_links = 0;
+  for (const std::vector<std::vector<Eigen::Vector3d>>& state_pts : rob_pts) {
+    num_links = std::max(num_links, state_pts.size());
+  }
+  batch.link_vecs = Eigen::MatrixXd::Zero(3 * num_links, num_states);
+  batch.costs = Eigen::VectorXd::Zero(num_states);
+  if (!hasObstacles()) {
+    return;
+  }
+
+  const double reach = getReach();
+  const bool goal_attractor = params_.use_goal_attractor;
+  for (std::size_t i = 0; i < num_links; i++) {
+    for (std::size_t start = 0; start < num_states;
+         start += BATCH_RUN_LENGTH) {
+      const std::size_t end = std::min(num_states, start + BATCH_RUN_LENGTH);
+
+      // The states of the run in which the link has an obstacle within reach,
+      // the others are not repelled. One sphere around the link in all of
+      // them bounds the obstacles that any of their points can reach.
+      std::vector<std::size_t> near_states;
+      BoundingSphere run_sphere;
+      for (std::size_t s = start; s < end; s++) {
+        if (i >= rob_pts[s].size() || rob_pts[s][i].empty() ||
+            i >= link_spheres[s].size() ||
+            !isObstacleNear(link_spheres[s][i])) {
+          continue;
+        }
+        if (near_states.empty()) {
+          run_sphere = link_spheres[s][i];
+        } else {
+          run_sphere.merge(link_spheres[s][i]);
+        }
+        near_states.emplace_back(s);
+      }
+      if (near_states.empty()) {
+        continue;
+      }
+      const Eigen::Matrix3Xd obstacles = gatherObstacles(run_sphere, reach);
+
+      for (std::size_t s : near_states) {
+        const std::vector<Eigen::Vector3d>& pts = rob_pts[s][i];
+        Eigen::Vector3d sum = Eigen::Vector3d::Zero();
+        for (std::size_t j = 0; j < pts.size(); j++) {
+          bool has_att = goal_attractor && i < attractor_pts_.size() &&
+                         j < attractor_pts_[i].size();
+          sum += repulsionSum(pts[j], obstacles,
+                              has_att ? &attractor_pts_[i][j] : nullptr);
+        }
+        // Each point averages over all obstacles and the link over its
+        // points.
+        Eigen::Vector3d link_vec =
+            sum / static_cast<double>(pts.size() * num_obstacles_);
+        batch.link_vecs.block<3, 1>(3 * i, s) = link_vec;
+        batch.costs[s] += link_vec.norm();
+      }
+    }
+  }
+}
+
+void FieldEngine::evaluateBatch(
+    const moveit::core::RobotState& seed_state,
+    const moveit::core::JointModelGroup* joint_model_group, std::size_t dof,
+    const double* joint_values, std::size_t num_states, FieldBatch& batch) {
+  const std::size_t num_variables = joint_model_group->getVariableCount();
+  moveit::core::RobotState robot_state(seed_state);
+  std::vector<std::vector<std::vector<Eigen::Vector3d>>> rob_pts(num_states);
+  std::vector<std::vector<BoundingSphere>> link_spheres(num_states);
+  for (std::size_t s = 0; s < num_states; s++) {
+    robot_state.setJointGroupPositions(joint_model_group,
+                                       joint_values + s * num_variables);
+    robot_state.updateLinkTransforms();
+    getPtsOnRobotSurface(robot_state, joint_model_group, dof, rob_pts[s],
+                         link_spheres[s]);
+  }
+  evaluatePtsBatch(rob_pts, link_spheres, batch);
+}
+
+}  // namespace tacbot
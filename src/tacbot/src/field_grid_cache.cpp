@@ -0,0 +1,170 @@
+#include "field_grid_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace tacbot {
+
+FieldGridCache::FieldGridCache() {}
+
+FieldGridCache::FieldGridCache(const Options& options) : options_(options) {}
+
+std::size_t FieldGridCache::VertexHash::operator()(const Vertex& vertex) const {
+  std::size_t hash = 14695981039346656037ULL;
+  for (long idx : vertex) {
+    hash ^= static_cast<std::size_t>(idx);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+Eigen::VectorXd FieldGridCache::vertexValue(const Vertex& vertex,
+                                            const Evaluator& evaluator) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = vertices_.find(vertex);
+    if (it != vertices_.end()) {
+      stats_.vertex_hits++;
+      return it->second;
+    }
+  }
+
+  std::vector<double> q(vertex.size());
+  for (std::size_t i = 0; i < vertex.size(); i++) {
+    q[i] = vertex[i] * options_.resolution;
+  }
+  Eigen::VectorXd value = evaluator(q);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (vertices_.size() >= options_.max_vertices) {
+    vertices_.clear();
+  }
+  stats_.vertex_evaluations++;
+  // Another thread may have filled in the same vertex meanwhile, either value
+  // is exact so keep the one that is there.
+  return vertices_.emplace(vertex, std::move(value)).first->second;
+}
+
+bool FieldGridCache::interpolate(const std::vector<double>& q,
+                                 const Evaluator& evaluator,
+                                 Eigen::VectorXd& value) {
+  const std::size_t dim = q.size();
+  Vertex vertex(dim);
+  std::vector<double> frac(dim);
+  for (std::size_t i = 0; i < dim; i++) {
+    double x = q[i] / options_.resolution;
+    double cell = std::floor(x);
+    vertex[i] = static_cast<long>(cell);
+    frac[i] = x - cell;
+  }
+
+  // The Kuhn simplex that contains q is found by walking from the lower corner
+  // of the cell along the axes in order of decreasing fractional part.
+  std::vector<std::size_t> order(dim);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](std::size_t a, std::size_t b) { return frac[a] > frac[b]; });
+
+  Vertex simplex = vertex;
+  simplex.insert(simplex.end(), order.begin(), order.end());
+  bool checked = false;
+  bool trusted = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = simplices_.find(simplex);
+    if (it != simplices_.end()) {
+      checked = true;
+      trusted = it->second;
+      if (!trusted) {
+        stats_.rejected++;
+        return false;
+      }
+    }
+  }
+
+  Eigen::VectorXd v = vertexValue(vertex, evaluator);
+  double weight = dim > 0 ? 1.0 - frac[order[0]] : 1.0;
+  Eigen::VectorXd result = weight * v;
+  Eigen::VectorXd vertex_sum = v;
+  for (std::size_t k = 0; k < dim; k++) {
+    vertex[order[k]]++;
+    v = vertexValue(vertex, evaluator);
+    weight = k + 1 < dim ? frac[order[k]] - frac[order[k + 1]] : frac[order[k]];
+    result += weight * v;
+    vertex_sum += v;
+  }
+
+  if (!checked) {
+    // The centroid is where the interpolation weighs all vertices equally.
+    // Axis order[k] is stepped along by dim - k of the dim + 1 vertices.
+    std::vector<double> centroid(dim);
+    for (std::size_t k = 0; k < dim; k++) {
+      std::size_t axis = order[k];
+      centroid[axis] = (simplex[axis] + static_cast<double>(dim - k) /
+                                            static_cast<double>(dim + 1)) *
+                       options_.resolution;
+    }
+    Eigen::VectorXd exact = evaluator(centroid);
+    Eigen::VectorXd interpolated = vertex_sum / static_cast<double>(dim + 1);
+
+    // Where the function is close to a convex or concave quadratic, the
+    // error is a weighted variance of the vertex values. Equal weights give at
+    // least 2 / (dim + 1) of the largest variance that any point of the
+    // simplex gives, so the error at the centroid bounds it anywhere.
+    double error_bound = 0.5 * static_cast<double>(dim + 1) *
+                         (exact - interpolated).cwiseAbs().maxCoeff();
+    trusted = exact.size() == interpolated.size() &&
+              error_bound <= options_.tolerance;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (simplices_.size() >= options_.max_vertices) {
+      simplices_.clear();
+    }
+    simplices_.emplace(std::move(simplex), trusted);
+    stats_.simplex_checks++;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (trusted) {
+      stats_.interpolated++;
+    } else {
+      stats_.rejected++;
+    }
+  }
+  if (trusted) {
+    value = result;
+  }
+  return trusted;
+}
+
+void FieldGridCache::setSceneVersion(std::size_t scene_version) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (scene_version != scene_version_) {
+    vertices_.clear();
+    simplices_.clear();
+    scene_version_ = scene_version;
+  }
+}
+
+void FieldGridCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  vertices_.clear();
+  simplices_.clear();
+  stats_ = Stats();
+}
+
+void FieldGridCache::setOptions(const Options& options) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  options_ = options;
+  vertices_.clear();
+  simplices_.clear();
+}
+
+FieldGridCache::Stats FieldGridCache::getStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+}  // namespace tacbot
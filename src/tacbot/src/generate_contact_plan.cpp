@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <thread>
+
 #include "contact_planner.h"
 #include "my_moveit_context.h"
 #include "panda_interface.h"
@@ -78,6 +81,55 @@ int main(int argc, char* argv[]) {
     ROS_ERROR("Failed to get param 'demo_planner'");
   }
 
+  // Bound the states the planner records for the visualizer, long runs
+  // sample far more of them than can be looked at.
+  ros::NodeHandle private_node_handle("~");
+  std::string recording_param;
+  if (private_node_handle.getParam("visualizer_recording", recording_param)) {
+    RecordingOptions recording;
+    if (recording_param == "off") {
+      recording.policy = RecordingOptions::OFF;
+    } else if (recording_param == "reservoir") {
+      recording.policy = RecordingOptions::RESERVOIR;
+    } else if (recording_param == "every_nth") {
+      recording.policy = RecordingOptions::EVERY_NTH;
+    } else if (recording_param != "all") {
+      ROS_ERROR("Unknown visualizer_recording '%s', recording all states",
+                recording_param.c_str());
+    }
+    int capacity = static_cast<int>(recording.capacity);
+    private_node_handle.getParam("visualizer_recording_capacity", capacity);
+    recording.capacity = static_cast<std::size_t>(std::max(capacity, 1));
+    int stride = static_cast<int>(recording.stride);
+    private_node_handle.getParam("visualizer_recording_stride", stride);
+    recording.stride = static_cast<std::size_t>(std::max(stride, 1));
+    planner->getVisualizerData()->setRecordingOptions(recording);
+  }
+
+  // bound the robot surface points per state, e.g. _field_max_pts:=400, the
+  // links farthest from the obstacles are made coarser first
+  int field_max_pts = 0;
+  if (private_node_handle.getParam("field_max_pts", field_max_pts)) {
+    FieldEngine::Options surface_options;
+    surface_options.max_pts =
+        static_cast<std::size_t>(std::max(field_max_pts, 0));
+    planner->setSurfaceOptions(surface_options);
+  }
+
+  // interpolate the field from a grid over the joint space where that is
+  // accurate, e.g. _use_field_grid:=true
+  bool use_field_grid = false;
+  if (private_node_handle.getParam("use_field_grid", use_field_grid)) {
+    planner->setUseFieldGrid(use_field_grid);
+  }
+
+  // bias the uniform samples away from singular configurations, e.g.
+  // _use_manip_sampler:=true
+  bool use_manip_sampler = false;
+  if (private_node_handle.getParam("use_manip_sampler", use_manip_sampler)) {
+    planner->setUseManipulabilitySampler(use_manip_sampler);
+  }
+
   if (planner_param == "contact") {
     PLANNER_NAME = "ContactTRRTDuo";  // ContactTRRTDuo, RRTstar
     OBJECTIVE_NAME =
@@ -115,9 +167,15 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  ROS_INFO_NAMED(LOGNAME, "shortcutPlan");
+  if (!planner->shortcutPlan(res, 1.0)) {
+    return 1;
+  }
+
   if (!planner->parameterizePlan(res)) {
     return 1;
   }
+  planner->compressPlan(res);
 
   moveit_msgs::MotionPlanResponse msg;
   res.getMessage(msg);
@@ -137,12 +195,80 @@ int main(int argc, char* argv[]) {
 
     moveit_msgs::MotionPlanResponse traj_msg;
     res.getMessage(traj_msg);
-    std::vector<std::array<double, 7>> joint_waypoints;
-    std::vector<std::array<double, 7>> joint_velocities;
-    utilities::toControlTrajectory(traj_msg, joint_waypoints, joint_velocities);
-
-    panda_interface.follow_joint_velocities(panda_interface.robot_.get(),
-                                            joint_velocities);
+    JointTrajectorySpline trajectory;
+    if (!JointTrajectorySpline::fromTrajectory(
+            traj_msg.trajectory.joint_trajectory, trajectory)) {
+      ROS_ERROR_NAMED(LOGNAME, "The planned trajectory is malformed.");
+      return 1;
+    }
+
+    // the controller runs on its own thread and reports its progress through
+    // shared memory, which the planner waits on. The control side creates the
+    // block, here that is this process, so it is named apart from the block
+    // that the JointPositionController creates.
+    std::string execution_monitor_name = "/tacbot_contact_plan_execution";
+    ros::NodeHandle("~").getParam("execution_monitor", execution_monitor_name);
+    ExecutionMonitor execution_monitor;
+    if (!execution_monitor.open(execution_monitor_name, true)) {
+      ROS_ERROR_NAMED(LOGNAME, "Could not open the execution monitor.");
+      return 1;
+    }
+    panda_interface.set_execution_monitor(&execution_monitor);
+    panda_interface.enable_contact_detection();
+    // record the control loop when a file is given, e.g.
+    // _control_log:=/tmp/control.csv
+    std::string control_log;
+    if (ros::NodeHandle("~").getParam("control_log", control_log) &&
+        !control_log.empty() &&
+        !panda_interface.start_control_log(control_log)) {
+      ROS_WARN_NAMED(LOGNAME, "Could not open the control log %s.",
+                     control_log.c_str());
+    }
+
+    std::thread executor([&]() {
+      try {
+        panda_interface.follow_joint_trajectory(panda_interface.robot_.get(),
+                                                trajectory);
+      } catch (const franka::Exception& ex) {
+        ROS_ERROR_NAMED(LOGNAME, "%s", ex.what());
+      }
+    });
+
+    // on a contact, back off along the planned path by this many seconds
+    // instead of pushing on to its end, e.g. _retreat_on_contact:=0.5
+    double retreat_on_contact = 0.0;
+    ros::NodeHandle("~").getParam("retreat_on_contact", retreat_on_contact);
+    bool retreated = false;
+    auto on_contact = [&](const ExecutionStatus& contact_status) {
+      if (retreat_on_contact <= 0.0) {
+        return;
+      }
+      std::size_t segment = 0;
+      JointTrajectorySpline::JointArray q, dq;
+      trajectory.sample(std::max(0.0, contact_status.time - retreat_on_contact),
+                        segment, q, dq);
+      ROS_WARN_NAMED(LOGNAME, "Contact on link %d, retreating by %f s.",
+                     contact_status.contact_link, retreat_on_contact);
+      panda_interface.set_online_target(q);
+      retreated = true;
+    };
+
+    ExecutionStatus status;
+    bool executed = planner->monitorExecution(
+        execution_monitor,
+        trajectory.getDuration() + retreat_on_contact + 5.0, status,
+        on_contact);
+    executor.join();
+    panda_interface.stop_control_log();
+    panda_interface.set_execution_monitor(nullptr);
+    if (!executed) {
+      ROS_ERROR_NAMED(LOGNAME, "The trajectory was not executed to its end.");
+      return 1;
+    }
+    if (retreated) {
+      ROS_INFO_NAMED(LOGNAME,
+                     "Retreated from the contact, which is now an obstacle.");
+    }
   }
 
   std::cout << "Finished!" << std::endl;
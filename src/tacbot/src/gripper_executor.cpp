@@ -0,0 +1,72 @@
+#include "gripper_executor.h"
+
+namespace tacbot {
+
+GripperExecutor::GripperExecutor(franka::Gripper* gripper)
+    : gripper_(gripper), worker_(&GripperExecutor::run, this) {}
+
+GripperExecutor::~GripperExecutor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  worker_.join();
+}
+
+std::future<bool> GripperExecutor::homing() {
+  return enqueue([this]() { return gripper_->homing(); });
+}
+
+std::future<bool> GripperExecutor::move(double width, double speed) {
+  return enqueue(
+      [this, width, speed]() { return gripper_->move(width, speed); });
+}
+
+std::future<bool> GripperExecutor::open(double speed) {
+  return enqueue([this, speed]() {
+    franka::GripperState gripper_state = gripper_->readOnce();
+    return gripper_->move(gripper_state.max_width, speed);
+  });
+}
+
+std::future<bool> GripperExecutor::grasp(double width, double speed,
+                                         double force, double epsilon_inner,
+                                         double epsilon_outer) {
+  return enqueue([=]() {
+    return gripper_->grasp(width, speed, force, epsilon_inner, epsilon_outer);
+  });
+}
+
+bool GripperExecutor::stop() { return gripper_->stop(); }
+
+std::future<bool> GripperExecutor::enqueue(std::function<bool()> command) {
+  std::packaged_task<bool()> task(std::move(command));
+  std::future<bool> result = task.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    commands_.emplace_back(std::move(task));
+  }
+  condition_.notify_one();
+  return result;
+}
+
+void GripperExecutor::run() {
+  while (true) {
+    std::packaged_task<bool()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock,
+                      [this]() { return stopping_ || !commands_.empty(); });
+      if (commands_.empty()) {
+        return;
+      }
+      task = std::move(commands_.front());
+      commands_.pop_front();
+    }
+    // an exception thrown by the gripper is passed on through the future
+    task();
+  }
+}
+
+}  // namespace tacbot
@@ -0,0 +1,119 @@
+#include <map>
+#include <string>
+#include <vector>
+
+#include "my_moveit_context.h"
+#include "perception_planner.h"
+#include "utilities.h"
+
+constexpr char LOGNAME[] = "headless_plan";
+
+using namespace tacbot;
+
+/** Plans with the PerceptionPlanner without a ROS master. The robot is loaded
+ * from files, e.g. generated with
+ *   xacro panda.urdf.xacro > panda.urdf
+ *   xacro panda.srdf.xacro > panda.srdf
+ * and nothing is published, so this can run in batch jobs and benchmarks.
+ * Without a parameter server, the private parameters of the nodes are given
+ * the way rosrun passes them, e.g. _field_max_pts:=400.
+ *
+ * usage: headless_plan <urdf> <srdf> [planner] [planning time] [_param:=value]
+ */
+int main(int argc, char** argv) {
+  std::vector<std::string> args;
+  std::map<std::string, std::string> params;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    std::size_t assign = arg.find(":=");
+    if (arg.size() > 1 && arg[0] == '_' && assign != std::string::npos) {
+      params[arg.substr(1, assign - 1)] = arg.substr(assign + 2);
+    } else {
+      args.emplace_back(arg);
+    }
+  }
+  if (args.size() < 2) {
+    std::cerr << "usage: " << argv[0]
+              << " <urdf> <srdf> [planner] [planning time] [_param:=value]"
+              << std::endl;
+    return 1;
+  }
+  const std::string urdf_path = args[0];
+  const std::string srdf_path = args[1];
+  const std::string planner_name = args.size() > 2 ? args[2] : "BITstar";
+  const double planning_time = args.size() > 3 ? std::stod(args[3]) : 30.0;
+
+  std::shared_ptr<PerceptionPlanner> planner =
+      std::make_shared<PerceptionPlanner>();
+  ROS_INFO_NAMED(LOGNAME, "planner->init()");
+  planner->init(urdf_path, srdf_path);
+  planner->setGoalState(1);
+  planner->setObstacleScene(2);
+
+  // bound the robot surface points per state, 0 for no bound
+  if (params.count("field_max_pts")) {
+    FieldEngine::Options surface_options;
+    surface_options.max_pts = std::stoul(params["field_max_pts"]);
+    planner->setSurfaceOptions(surface_options);
+  }
+
+  // interpolate the contact costs from a grid over the joint space where that
+  // is accurate
+  if (params.count("use_field_grid")) {
+    planner->setUseFieldGrid(params["use_field_grid"] == "true");
+  }
+
+  // bias the uniform samples away from singular configurations
+  if (params.count("use_manip_sampler")) {
+    planner->setUseManipulabilitySampler(params["use_manip_sampler"] ==
+                                         "true");
+  }
+
+  std::shared_ptr<MyMoveitContext> context = std::make_shared<MyMoveitContext>(
+      planner->getPlanningScene(), planner->getRobotModel());
+  context->setSimplifySolution(false);
+
+  planning_interface::MotionPlanRequest req;
+  planning_interface::MotionPlanResponse res;
+  planner->setCurToStartState(req);
+  req.goal_constraints.push_back(planner->createJointGoal());
+
+  req.group_name = planner->getGroupName();
+  req.allowed_planning_time = planning_time;
+  req.planner_id = context->getPlannerId();
+  req.max_acceleration_scaling_factor = 0.5;
+  req.max_velocity_scaling_factor = 0.5;
+
+  ROS_INFO_NAMED(LOGNAME, "createPlanningContext");
+  context->createPlanningContext(req);
+  if (!context->getPlanningContext()) {
+    ROS_ERROR_NAMED(LOGNAME, "Could not create the planning context.");
+    return 1;
+  }
+  planner->setPlanningContext(context->getPlanningContext());
+
+  planner->setPlannerName(planner_name);
+  planner->changePlanner();
+
+  ROS_INFO_NAMED(LOGNAME, "generatePlan");
+  planner->generatePlan(res);
+  if (res.error_code_.val != res.error_code_.SUCCESS) {
+    ROS_ERROR_NAMED(LOGNAME,
+                    "Could not compute plan successfully. Error code: %d",
+                    res.error_code_.val);
+    return 1;
+  }
+
+  if (!planner->shortcutPlan(res, 1.0)) {
+    return 1;
+  }
+  if (!planner->parameterizePlan(res)) {
+    return 1;
+  }
+  planner->compressPlan(res);
+
+  ROS_INFO_NAMED(LOGNAME, "Planning time: %f s, waypoints: %ld, duration: %f s",
+                 res.planning_time_, res.trajectory_->getWayPointCount(),
+                 res.trajectory_->getDuration());
+  return 0;
+}
@@ -17,44 +17,16 @@ constexpr char LOGNAME[] = "knot_plan";
 
 using namespace tacbot;
 
-void writeJointDataToJson(
-    const std::vector<std::array<double, 7>>& jointPoints,
-    const std::vector<std::array<double, 7>>& jointVelocities,
-    const std::string& filename) {
-  json data;  // Create a JSON object
-
-  // Convert and add joint points to the JSON object
-  json points;
-  for (const auto& point : jointPoints) {
-    json pointArray;
-    for (const auto& value : point) {
-      pointArray.push_back(value);
-    }
-    points.push_back(pointArray);
-  }
-  data["joint_states"] = points;
-
-  // Add joint velocities to the JSON object
-  json velocities;
-  for (const auto& point : jointVelocities) {
-    json pointArray;
-    for (const auto& value : point) {
-      pointArray.push_back(value);
-    }
-    velocities.push_back(pointArray);
-  }
-
-  data["joint_velocities"] = velocities;
-
+/** Write the trajectory to bags/ in the binary TrajectoryLog format and as
+ * NumPy arrays, which the scripts in scripts/ can load without parsing.*/
+void writeTrajectoryLog(const TrajectoryLog& trajectory_log,
+                        const std::string& name) {
   std::string package_path = ros::package::getPath("tacbot");
-  // std::cout << "package_path " << package_path << std::endl;
-
-  // Specify a relative file path within the package
-  std::string relative_path = package_path + "/bags/" + filename;
-
-  // Write the JSON data to a file
-  std::ofstream file(relative_path);
-  file << std::setw(4) << data << std::endl;
+  std::string relative_path = package_path + "/bags/" + name;
+  if (!trajectory_log.save(relative_path + ".tbt") ||
+      !trajectory_log.exportNpy(relative_path + "_")) {
+    ROS_ERROR_NAMED(LOGNAME, "Could not write %s", relative_path.c_str());
+  }
 }
 
 int main(int argc, char** argv) {
@@ -190,6 +162,11 @@ int main(int argc, char** argv) {
       return 1;
     }
 
+    ROS_INFO_NAMED(LOGNAME, "shortcutPlan");
+    if (!planner->shortcutPlan(res, 1.0)) {
+      return 1;
+    }
+
     if (!planner->parameterizePlan(res)) {
       return 1;
     }
@@ -233,22 +210,13 @@ int main(int argc, char** argv) {
 
   sleep(0.1);
 
-  std::vector<std::array<double, 7>> traj_waypoints;
-  std::vector<std::array<double, 7>> traj_velocities;
+  TrajectoryLog trajectory_log;
 
   for (std::size_t i = 0; i < responses.size(); i++) {
     planning_interface::MotionPlanResponse res = responses[i];
     moveit_msgs::MotionPlanResponse traj_msg;
     res.getMessage(traj_msg);
-    std::vector<std::array<double, 7>> joint_waypoints;
-    std::vector<std::array<double, 7>> joint_velocities;
-    utilities::toControlTrajectory(traj_msg, joint_waypoints, joint_velocities);
-
-    traj_waypoints.insert(traj_waypoints.end(), joint_waypoints.begin(),
-                          joint_waypoints.end());
-
-    traj_velocities.insert(traj_velocities.end(), joint_velocities.begin(),
-                           joint_velocities.end());
+    trajectory_log.addTrajectory(traj_msg.trajectory.joint_trajectory);
 
     // panda_interface.follow_joint_velocities(panda_interface.robot_.get(),
     //                                         joint_velocities);
@@ -261,7 +229,7 @@ int main(int argc, char** argv) {
     // }
   }
 
-  writeJointDataToJson(traj_waypoints, traj_velocities, "trajectory.json");
+  writeTrajectoryLog(trajectory_log, "trajectory");
 
   std::cout << "Finished!" << std::endl;
 
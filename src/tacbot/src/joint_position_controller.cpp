@@ -6,7 +6,10 @@
 #include <pluginlib/class_list_macros.h>
 #include <ros/ros.h>
 
+#include <algorithm>
 #include <cmath>
+#include <iterator>
+#include <utility>
 
 namespace tacbot {
 
@@ -101,170 +104,212 @@ bool JointPositionController::init(hardware_interface::RobotHW* robot_hardware,
   //     return false;
   //   }
   // }
-  double publish_rate(5.0);
+  double publish_rate(30.0);
   if (!node_handle.getParam("publish_rate", publish_rate)) {
-    ROS_INFO_STREAM("ContactController: publish_rate not found. Defaulting to "
+    ROS_INFO_STREAM("JointPositionController: publish_rate not found. "
+                    "Defaulting to "
                     << publish_rate);
   }
   rate_trigger_ = franka_hw::TriggerRate(publish_rate);
 
-  trajectory_monitor_pub_.init(node_handle, "trajectory_monitor", 1);
+  node_handle.param("start_tolerance", start_tolerance_, start_tolerance_);
+
+  // contacts are told by the momentum observer, whose thresholds are on the
+  // external torques rather than on the measured ones
+  ContactDetector::Options contact_options;
+  node_handle.param("contact_observer_gain", contact_options.gain,
+                    contact_options.gain);
+  std::vector<double> contact_thresholds;
+  if (node_handle.getParam("contact_thresholds", contact_thresholds)) {
+    if (contact_thresholds.size() != 7) {
+      ROS_ERROR("JointPositionController: contact_thresholds needs 7 values");
+      return false;
+    }
+    std::copy(contact_thresholds.begin(), contact_thresholds.end(),
+              contact_options.thresholds.begin());
+  }
+  int contact_min_cycles = static_cast<int>(contact_options.min_cycles);
+  node_handle.param("contact_min_cycles", contact_min_cycles,
+                    contact_min_cycles);
+  contact_options.min_cycles =
+      static_cast<std::size_t>(std::max(contact_min_cycles, 1));
+  contact_detector_.setOptions(contact_options);
+
+  std::string execution_monitor_name;
+  if (node_handle.getParam("execution_monitor", execution_monitor_name) &&
+      !execution_monitor_.open(execution_monitor_name, true)) {
+    ROS_ERROR_STREAM("JointPositionController: Could not open execution "
+                     "monitor "
+                     << execution_monitor_name);
+    return false;
+  }
 
-  trajectory_sub_ =
-      node_handle.subscribe("contact_trajectory", 1,
-                            &JointPositionController::trajectoryCallback, this);
+  // the message only has fixed size fields, so publishing it from the control
+  // loop does not allocate
+  trajectory_monitor_pub_.init(node_handle, "trajectory_monitor", 1);
 
-  // ros::spinOnce();
+  trajectory_buffer_.writeFromNonRT(TrajectoryPtr());
+  trajectory_sub_ = node_handle.subscribe(
+      "contact_trajectory", 1, &JointPositionController::trajectoryCallback,
+      this, ros::TransportHints().tcpNoDelay());
 
   return true;
 }
 
 void JointPositionController::starting(const ros::Time& /* time */) {
   for (size_t i = 0; i < 7; ++i) {
-    initial_pose_[i] = position_joint_handles_[i].getPosition();
+    hold_pose_[i] = position_joint_handles_[i].getPosition();
   }
+  // a trajectory that arrived while the controller was stopped is not run
+  last_trajectory_ = trajectory_buffer_.readFromRT()->get();
+  trajectory_.reset();
   elapsed_time_ = ros::Duration(0.0);
+  segment_ = 0;
+  status_ = ExecutionStatus();
+  contact_detector_.reset();
 }
 
-bool JointPositionController::isApproxEqual(const std::array<double, 7>& a,
-                                            const std::array<double, 7>& b,
-                                            double tolerance) {
-  for (size_t i = 0; i < 7; i++) {
-    double dif = a[i] - b[i];
-    if (std::abs(dif) > tolerance) {
-      return false;
-    }
-  }
-  return true;
+bool JointPositionController::updateContactDetection(
+    const franka::RobotState& robot_state, double period) {
+  // the handle evaluates the model at the state of the current cycle
+  return contact_detector_.update(
+      robot_state, model_handle_->getMass(), model_handle_->getCoriolis(),
+      model_handle_->getGravity(), period,
+      [this](franka::Frame frame) { return model_handle_->getPose(frame); });
 }
 
-int JointPositionController::isRobotStateValid(
-    const franka::RobotState& robot_state) {
-  const double tau_thresh = 50.0;
-  int status = 1;
+void JointPositionController::update(const ros::Time& time,
+                                     const ros::Duration& period) {
+  // nothing in here may allocate, lock or log, it runs at 1 kHz
+  franka::RobotState robot_state = state_handle_->getRobotState();
+  std::array<double, 7> current_pose{};
+  for (std::size_t i = 0; i < 7; i++) {
+    current_pose[i] = position_joint_handles_[i].getPosition();
+  }
+
+  pickUpTrajectory(current_pose);
+  // the observer runs while holding as well, so it has settled when a
+  // trajectory starts
+  bool contact = updateContactDetection(robot_state, period.toSec());
 
-  for (std::size_t i = 0; i < robot_state.q.size(); i++) {
-    double tau_J = robot_state.tau_J[i];
-    if (std::abs(tau_J) > tau_thresh) {
-      status = -1;
-      break;
+  if (!trajectory_) {
+    for (std::size_t i = 0; i < 7; i++) {
+      position_joint_handles_[i].setCommand(hold_pose_[i]);
     }
+    publishStatus(time, robot_state, false);
+    return;
   }
-  return status;
-}
 
-void JointPositionController::update(const ros::Time& /*time*/,
-                                     const ros::Duration& period) {
   elapsed_time_ += period;
 
-  std::size_t num_pts = joint_trajectory_.points.size();
-  if (num_pts == 0) {
-    elapsed_time_ = ros::Duration(0.0);
+  if (contact) {
+    const ContactDetector::Contact& detected = contact_detector_.getContact();
+    status_.contact_link = static_cast<std::int32_t>(detected.link);
+    status_.contact_point = detected.point;
+    status_.state = ExecutionStatus::FAILED;
+    hold_pose_ = current_pose;
+    trajectory_.reset();
+    for (std::size_t i = 0; i < 7; i++) {
+      position_joint_handles_[i].setCommand(hold_pose_[i]);
+    }
+    publishStatus(time, robot_state, true);
     return;
-  } else {
-    ROS_INFO_STREAM("Executing trajectory with pts: " << num_pts);
-    is_executing = true;
   }
 
-  franka::RobotState robot_state = state_handle_->getRobotState();
-  int is_valid = isRobotStateValid(robot_state);
-
-  if (trajectory_monitor_pub_.trylock()) {
-    franka_msgs::FrankaState franka_state_msg;
-    robotStateToMsg(robot_state, franka_state_msg);
-    trajectory_monitor_pub_.msg_.franka_state = franka_state_msg;
-
-    trajectory_monitor_pub_.msg_.header.stamp = ros::Time::now();
-    ROS_INFO_STREAM("pt_idx_: " << pt_idx_);
-    trajectory_monitor_pub_.msg_.pt_idx = pt_idx_;
-    trajectory_monitor_pub_.msg_.is_valid = is_valid;
-    trajectory_monitor_pub_.unlockAndPublish();
+  JointTrajectorySpline::JointArray position;
+  JointTrajectorySpline::JointArray velocity;
+  trajectory_->sample(elapsed_time_.toSec(), segment_, position, velocity);
+  for (std::size_t i = 0; i < 7; i++) {
+    position_joint_handles_[i].setCommand(position[i]);
   }
 
-  if (is_valid == -1) {
-    ROS_ERROR_STREAM("Robot state is invalid.");
-    // std::cout << "Robot State" << std::endl;
-    // std::cout << robot_state << std::endl;
-    reset();
+  status_.pt_idx = static_cast<std::uint32_t>(segment_);
+  status_.time = elapsed_time_.toSec();
+  if (elapsed_time_.toSec() >= trajectory_->getDuration()) {
+    status_.state = ExecutionStatus::FINISHED;
+    hold_pose_ = position;
+    trajectory_.reset();
+    publishStatus(time, robot_state, true);
     return;
   }
+  publishStatus(time, robot_state, false);
+}
 
-  std::array<double, 7> desired_pose{};
-  std::array<double, 7> current_pose{};
-
-  std::size_t i = pt_idx_;
-  for (; i < num_pts; i++) {
-    trajectory_msgs::JointTrajectoryPoint point = joint_trajectory_.points[i];
-    ros::Duration tm_from_start = point.time_from_start;
-
-    ROS_INFO_STREAM("i: " << i);
-    // ROS_INFO_STREAM("tm_from_start: " << tm_from_start.toSec());
-    // ROS_INFO_STREAM("elapsed_time_: " << elapsed_time_.toSec());
-    // ROS_INFO_STREAM("period: " << period.toSec());
-
-    for (std::size_t j = 0; j < 7; j++) {
-      current_pose[j] = position_joint_handles_[j].getPosition();
-      desired_pose[j] = point.positions[j];
+void JointPositionController::pickUpTrajectory(
+    const std::array<double, 7>& current_pose) {
+  const TrajectoryPtr& latest = *trajectory_buffer_.readFromRT();
+  if (!latest || latest.get() == last_trajectory_) {
+    return;
+  }
+  last_trajectory_ = latest.get();
+
+  // the trajectory has to start where the robot is
+  status_ = ExecutionStatus();
+  const JointTrajectorySpline::JointArray& start = latest->getPosition(0);
+  for (std::size_t i = 0; i < 7; i++) {
+    if (std::abs(start[i] - current_pose[i]) > start_tolerance_) {
+      status_.state = ExecutionStatus::FAILED;
+      trajectory_.reset();
+      return;
     }
+  }
 
-    if (isApproxEqual(desired_pose, current_pose)) {
-      pt_idx_++;
-      continue;
-    } else {
-      break;
-    }
+  status_.state = ExecutionStatus::RUNNING;
+  // a contact from before the trajectory does not stop it
+  contact_detector_.clearContact();
+  trajectory_ = latest;
+  elapsed_time_ = ros::Duration(0.0);
+  segment_ = 0;
+}
 
-    // if (elapsed_time_ <= tm_from_start) {
-    //   pt_idx = i;
-    //   for (std::size_t j = 0; j < 7; j++) {
-    //     double position = point.positions[pt_idx];
-    //     desired_pose[j] = position;
-    //   }
-    //   break;
-    // }
+void JointPositionController::publishStatus(
+    const ros::Time& time, const franka::RobotState& robot_state, bool force) {
+  status_.q = robot_state.q;
+  status_.tau_measured = robot_state.tau_J;
+  status_.tau_residual = contact_detector_.getResidual();
+  if (execution_monitor_.isOpen()) {
+    execution_monitor_.publish(status_);
   }
 
-  if (i >= num_pts) {
-    ROS_INFO_STREAM("Trajectory completed.");
-    reset();
+  if (!rate_trigger_() && !force) {
     return;
   }
-
-  std::array<double, 7> delta_angle{};
-  for (size_t i = 0; i < 7; ++i) {
-    delta_angle[i] = desired_pose[i] - current_pose[i];
-  }
-
-  double max_delta = 0.001;
-
-  for (size_t i = 0; i < 7; ++i) {
-    double delta = delta_angle[i];
-    ROS_INFO_STREAM("desired_pose[i]: " << desired_pose[i]);
-    ROS_INFO_STREAM("current_pose[i]: " << current_pose[i]);
-    ROS_INFO_STREAM("delta_angle[i]: " << delta_angle[i]);
-    if (std::abs(delta) > max_delta) {
-      double sign = (delta < 0) ? -1.0 : 1.0;
-      delta = max_delta * sign;
-      ROS_INFO_STREAM("delta: " << delta);
-    }
-    position_joint_handles_[i].setCommand(current_pose[i] + delta);
+  if (trajectory_monitor_pub_.trylock()) {
+    robotStateToMsg(robot_state, trajectory_monitor_pub_.msg_.franka_state);
+    trajectory_monitor_pub_.msg_.header.stamp = time;
+    trajectory_monitor_pub_.msg_.pt_idx = status_.pt_idx;
+    trajectory_monitor_pub_.msg_.is_valid =
+        status_.state == ExecutionStatus::FAILED ? -1 : 1;
+    trajectory_monitor_pub_.unlockAndPublish();
   }
 }
 
-void JointPositionController::reset() {
-  joint_trajectory_.points.clear();
-  elapsed_time_ = ros::Duration(0.0);
-  pt_idx_ = 0;
-  is_executing = false;
-}
-
 void JointPositionController::trajectoryCallback(
-    const trajectory_msgs::JointTrajectoryPtr& msg) {
-  if (is_executing == true) {
+    const trajectory_msgs::JointTrajectoryConstPtr& msg) {
+  if (msg->points.empty()) {
+    return;
+  }
+  JointTrajectorySpline spline;
+  if (!JointTrajectorySpline::fromTrajectory(*msg, spline)) {
+    ROS_ERROR(
+        "JointPositionController: Ignoring a trajectory whose points do not "
+        "have a position and a velocity for every joint");
     return;
   }
-  ROS_INFO_STREAM("JointPositionController::trajectoryCallback.");
-  joint_trajectory_ = *msg;
+  TrajectoryPtr trajectory =
+      std::make_shared<const JointTrajectorySpline>(std::move(spline));
+  handed_over_.push_back(trajectory);
+  trajectory_buffer_.writeFromNonRT(trajectory);
+
+  // free the trajectories the control loop no longer holds, here rather than
+  // in the control loop
+  for (auto it = handed_over_.begin(); it != std::prev(handed_over_.end());) {
+    if (it->use_count() == 1) {
+      it = handed_over_.erase(it);
+    } else {
+      it++;
+    }
+  }
 }
 
 void JointPositionController::robotStateToMsg(
@@ -0,0 +1,241 @@
+#include "joint_trajectory_spline.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace tacbot {
+
+bool JointTrajectorySpline::fromTrajectory(
+    const trajectory_msgs::JointTrajectory& trajectory,
+    JointTrajectorySpline& spline) {
+  spline = JointTrajectorySpline();
+  for (const trajectory_msgs::JointTrajectoryPoint& point :
+       trajectory.points) {
+    // a point without velocities is at rest, a partial one is malformed
+    if (point.positions.size() < 7 ||
+        (!point.velocities.empty() && point.velocities.size() < 7)) {
+      spline = JointTrajectorySpline();
+      return false;
+    }
+
+    JointArray position{};
+    JointArray velocity{};
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      position[jnt_idx] = point.positions[jnt_idx];
+      if (!point.velocities.empty()) {
+        velocity[jnt_idx] = point.velocities[jnt_idx];
+      }
+    }
+
+    double time = point.time_from_start.toSec();
+    // time parameterization can repeat the time of the first point
+    if (spline.size() > 0 && time <= spline.times_.back()) {
+      continue;
+    }
+    spline.addPoint(time, position, velocity);
+  }
+  return true;
+}
+
+JointTrajectorySpline JointTrajectorySpline::fromVelocities(
+    const std::vector<JointArray>& joint_velocities, double period) {
+  JointTrajectorySpline spline;
+  JointArray position{};
+  for (std::size_t i = 0; i < joint_velocities.size(); i++) {
+    if (i > 0) {
+      for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+        position[jnt_idx] += 0.5 * period *
+                             (joint_velocities[i - 1][jnt_idx] +
+                              joint_velocities[i][jnt_idx]);
+      }
+    }
+    spline.addPoint(double(i) * period, position, joint_velocities[i]);
+  }
+  return spline;
+}
+
+void JointTrajectorySpline::addPoint(double time, const JointArray& position,
+                                     const JointArray& velocity) {
+  if (!times_.empty() && time <= times_.back()) {
+    throw std::invalid_argument("waypoint times must be increasing");
+  }
+  times_.push_back(time);
+  positions_.push_back(position);
+  velocities_.push_back(velocity);
+}
+
+double JointTrajectorySpline::getDuration() const {
+  return times_.empty() ? 0.0 : times_.back();
+}
+
+JointTrajectorySpline::JointArray JointTrajectorySpline::velocityAt(
+    double time, std::size_t& segment) const {
+  JointArray position;
+  JointArray velocity;
+  sample(time, segment, position, velocity);
+  return velocity;
+}
+
+void JointTrajectorySpline::sample(double time, std::size_t& segment,
+                                   JointArray& position,
+                                   JointArray& velocity) const {
+  if (times_.empty()) {
+    position = JointArray{};
+    velocity = JointArray{};
+    return;
+  }
+  if (times_.size() == 1 || time <= times_.front()) {
+    segment = 0;
+    position = positions_.front();
+    velocity = velocities_.front();
+    return;
+  }
+  if (time >= times_.back()) {
+    segment = times_.size() - 2;
+    position = positions_.back();
+    velocity = velocities_.back();
+    return;
+  }
+
+  // the control loop only moves forward, search from the last segment
+  if (segment >= times_.size() - 1 || times_[segment] > time) {
+    segment = 0;
+  }
+  while (times_[segment + 1] < time) {
+    segment++;
+  }
+
+  evaluateSegment(positions_[segment], velocities_[segment],
+                  positions_[segment + 1], velocities_[segment + 1],
+                  times_[segment + 1] - times_[segment],
+                  time - times_[segment], position, velocity);
+}
+
+std::vector<std::size_t> JointTrajectorySpline::selectKnots(
+    double position_tolerance, double velocity_tolerance) const {
+  std::vector<std::size_t> knots;
+  if (times_.empty()) {
+    return knots;
+  }
+
+  const std::size_t end = times_.size() - 1;
+  std::size_t first = 0;
+  knots.push_back(first);
+  while (first < end) {
+    // double the span while it fits, then bisect between the longest span
+    // that fits and the shortest that does not, so that checking a segment
+    // of n waypoints takes O(n log n) rather than O(n^2)
+    std::size_t good = first + 1;
+    std::size_t bad = end + 1;
+    std::size_t span = 2;
+    while (first + span <= end) {
+      if (!fitsSegment(first, first + span, position_tolerance,
+                       velocity_tolerance)) {
+        bad = first + span;
+        break;
+      }
+      good = first + span;
+      span *= 2;
+    }
+    while (bad - good > 1) {
+      const std::size_t mid = good + (bad - good) / 2;
+      if (fitsSegment(first, mid, position_tolerance, velocity_tolerance)) {
+        good = mid;
+      } else {
+        bad = mid;
+      }
+    }
+    knots.push_back(good);
+    first = good;
+  }
+  return knots;
+}
+
+JointTrajectorySpline JointTrajectorySpline::compress(
+    double position_tolerance, double velocity_tolerance) const {
+  JointTrajectorySpline spline;
+  for (std::size_t i : selectKnots(position_tolerance, velocity_tolerance)) {
+    spline.addPoint(times_[i], positions_[i], velocities_[i]);
+  }
+  return spline;
+}
+
+bool JointTrajectorySpline::fitsSegment(std::size_t first, std::size_t last,
+                                        double position_tolerance,
+                                        double velocity_tolerance) const {
+  const double h = times_[last] - times_[first];
+  JointArray position;
+  JointArray velocity;
+  JointArray expected_position;
+  JointArray expected_velocity;
+
+  const auto within_tolerance = [&]() {
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      if (std::abs(position[jnt_idx] - expected_position[jnt_idx]) >
+              position_tolerance ||
+          std::abs(velocity[jnt_idx] - expected_velocity[jnt_idx]) >
+              velocity_tolerance) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  for (std::size_t i = first; i < last; i++) {
+    // the midpoint of every original segment, where the two splines are
+    // furthest apart
+    const double mid_time = 0.5 * (times_[i] + times_[i + 1]);
+    evaluateSegment(positions_[i], velocities_[i], positions_[i + 1],
+                    velocities_[i + 1], times_[i + 1] - times_[i],
+                    mid_time - times_[i], expected_position,
+                    expected_velocity);
+    evaluateSegment(positions_[first], velocities_[first], positions_[last],
+                    velocities_[last], h, mid_time - times_[first], position,
+                    velocity);
+    if (!within_tolerance()) {
+      return false;
+    }
+
+    if (i > first) {
+      expected_position = positions_[i];
+      expected_velocity = velocities_[i];
+      evaluateSegment(positions_[first], velocities_[first], positions_[last],
+                      velocities_[last], h, times_[i] - times_[first],
+                      position, velocity);
+      if (!within_tolerance()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void JointTrajectorySpline::evaluateSegment(
+    const JointArray& q0, const JointArray& v0, const JointArray& q1,
+    const JointArray& v1, double h, double t, JointArray& position,
+    JointArray& velocity) {
+  const double s = t / h;
+  const double s2 = s * s;
+  const double s3 = s2 * s;
+
+  // Hermite basis functions
+  const double h00 = 2.0 * s3 - 3.0 * s2 + 1.0;
+  const double h10 = s3 - 2.0 * s2 + s;
+  const double h01 = -2.0 * s3 + 3.0 * s2;
+  const double h11 = s3 - s2;
+
+  // and their derivatives, divided by h where they multiply a position
+  const double dh00 = (6.0 * s2 - 6.0 * s) / h;
+  const double dh10 = 3.0 * s2 - 4.0 * s + 1.0;
+  const double dh01 = -dh00;
+  const double dh11 = 3.0 * s2 - 2.0 * s;
+
+  for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+    position[jnt_idx] = h00 * q0[jnt_idx] + h10 * h * v0[jnt_idx] +
+                        h01 * q1[jnt_idx] + h11 * h * v1[jnt_idx];
+    velocity[jnt_idx] = dh00 * q0[jnt_idx] + dh10 * v0[jnt_idx] +
+                        dh01 * q1[jnt_idx] + dh11 * v1[jnt_idx];
+  }
+}
+
+}  // namespace tacbot
@@ -160,6 +160,7 @@ int main(int argc, char** argv) {
     if (!planner->parameterizePlan(res)) {
       return 1;
     }
+    planner->compressPlan(res);
 
     moveit_msgs::MotionPlanResponse msg;
     res.getMessage(msg);
@@ -186,6 +187,16 @@ int main(int argc, char** argv) {
   panda_interface.init();
   panda_interface.move_to_default_pose(panda_interface.robot_.get());
 
+  // record the control loop when a file is given, e.g.
+  // _control_log:=/tmp/control.csv
+  std::string control_log;
+  if (ros::NodeHandle("~").getParam("control_log", control_log) &&
+      !control_log.empty() &&
+      !panda_interface.start_control_log(control_log)) {
+    ROS_WARN_NAMED(LOGNAME, "Could not open the control log %s.",
+                   control_log.c_str());
+  }
+
   sleep(1.1);
 
   std::size_t counter = 1;
@@ -194,12 +205,15 @@ int main(int argc, char** argv) {
     planning_interface::MotionPlanResponse res = responses[i];
     moveit_msgs::MotionPlanResponse traj_msg;
     res.getMessage(traj_msg);
-    std::vector<std::array<double, 7>> joint_waypoints;
-    std::vector<std::array<double, 7>> joint_velocities;
-    utilities::toControlTrajectory(traj_msg, joint_waypoints, joint_velocities);
+    JointTrajectorySpline trajectory;
+    if (!JointTrajectorySpline::fromTrajectory(
+            traj_msg.trajectory.joint_trajectory, trajectory)) {
+      ROS_ERROR_NAMED(LOGNAME, "The planned trajectory is malformed.");
+      return 1;
+    }
 
-    panda_interface.follow_joint_velocities(panda_interface.robot_.get(),
-                                            joint_velocities);
+    panda_interface.follow_joint_trajectory(panda_interface.robot_.get(),
+                                            trajectory);
 
     if (i == counter) {
       sleep(3.0);
@@ -213,6 +227,7 @@ int main(int argc, char** argv) {
     //   return 0;
     // }
   }
+  panda_interface.stop_control_log();
 
   std::cout << "Finished!" << std::endl;
 
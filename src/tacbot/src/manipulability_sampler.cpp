@@ -0,0 +1,84 @@
+#include "manipulability_sampler.h"
+
+#include <ompl/base/spaces/RealVectorStateSpace.h>
+
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+
+namespace tacbot {
+
+ManipulabilitySampler::ManipulabilitySampler(
+    const ompl::base::StateSpace* space,
+    const moveit::core::RobotState& robot_state,
+    const moveit::core::JointModelGroup* joint_model_group,
+    const Options& options)
+    : ompl::base::StateSampler(space),
+      uniform_sampler_(space->allocDefaultStateSampler()),
+      robot_state_(robot_state),
+      joint_model_group_(joint_model_group),
+      tip_link_(joint_model_group->getLinkModels().back()),
+      options_(options),
+      dof_(joint_model_group->getVariableCount()),
+      joint_values_(dof_, 0.0) {}
+
+double ManipulabilitySampler::minSingularValue(
+    const ompl::base::State* state) {
+  const double* values =
+      state->as<ompl::base::RealVectorStateSpace::StateType>()->values;
+  joint_values_.assign(values, values + dof_);
+  robot_state_.setJointGroupPositions(joint_model_group_, joint_values_);
+  robot_state_.updateLinkTransforms();
+
+  if (!robot_state_.getJacobian(joint_model_group_, tip_link_,
+                                Eigen::Vector3d::Zero(), jacobian_)) {
+    return 0.0;
+  }
+
+  Eigen::Matrix3d jjt =
+      jacobian_.topRows<3>() * jacobian_.topRows<3>().transpose();
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+  solver.computeDirect(jjt, Eigen::EigenvaluesOnly);
+
+  // The eigenvalues are sorted in increasing order and may come out slightly
+  // negative at a singularity.
+  return std::sqrt(std::max(solver.eigenvalues()[0], 0.0));
+}
+
+void ManipulabilitySampler::sampleUniform(ompl::base::State* state) {
+  ompl::base::State* best = space_->allocState();
+  double best_value = -1.0;
+
+  for (std::size_t i = 0; i < options_.max_attempts; i++) {
+    uniform_sampler_->sampleUniform(state);
+    double value = minSingularValue(state);
+    if (value >= options_.min_singular_value ||
+        rng_.uniform01() * options_.min_singular_value < value) {
+      space_->freeState(best);
+      return;
+    }
+    if (value > best_value) {
+      best_value = value;
+      space_->copyState(best, state);
+    }
+  }
+
+  if (best_value >= 0.0) {
+    space_->copyState(state, best);
+  }
+  space_->freeState(best);
+}
+
+void ManipulabilitySampler::sampleUniformNear(ompl::base::State* state,
+                                              const ompl::base::State* near,
+                                              double distance) {
+  uniform_sampler_->sampleUniformNear(state, near, distance);
+}
+
+void ManipulabilitySampler::sampleGaussian(ompl::base::State* state,
+                                           const ompl::base::State* mean,
+                                           double std_dev) {
+  uniform_sampler_->sampleGaussian(state, mean, std_dev);
+}
+
+}  // namespace tacbot
@@ -12,6 +12,7 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <stdexcept>
 #include <kdl/chainiksolverpos_nr_jl.hpp>
 #include <kdl/chainiksolvervel_pinv.hpp>
 #include <kdl/frames.hpp>
@@ -36,6 +37,10 @@ ruckig::Ruckig<7> ruckig_7(0.001);
 
 void PandaInterface::init() {
   std::cout << "Initializing Controller!" << std::endl;
+  {
+    std::lock_guard<std::mutex> lock(kinematics_mutex_);
+    init_kinematics();
+  }
   robot_ = std::make_shared<franka::Robot>(franka_address_);
   robot_->setCollisionBehavior({{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}},
                                {{20.0, 20.0, 18.0, 18.0, 16.0, 14.0, 12.0}},
@@ -188,7 +193,13 @@ void PandaInterface::move_to_default_pose(franka::Robot *robot) {
   std::array<double, 7> q_default_goal = {0, -M_PI_4, 0,     -3 * M_PI_4,
                                           0, M_PI_2,  M_PI_4};
   MotionGenerator motion_generator(0.5, q_default_goal);  // speed factor, goal
-  robot->control(motion_generator);
+  cycle_timer_.reset();
+  robot->control([&](const franka::RobotState &robot_state,
+                     franka::Duration period) -> franka::JointPositions {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
+    return motion_generator(robot_state, period);
+  });
+  cycle_timer_.report("move_to_default_pose", std::cout);
 }
 
 void PandaInterface::move_to_joint_angles(franka::Robot *robot,
@@ -197,7 +208,13 @@ void PandaInterface::move_to_joint_angles(franka::Robot *robot,
   Moves the robot to the specified joint angles
   */
   MotionGenerator motion_generator(0.5, q_goal);  // speed factor, goal
-  robot->control(motion_generator);
+  cycle_timer_.reset();
+  robot->control([&](const franka::RobotState &robot_state,
+                     franka::Duration period) -> franka::JointPositions {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
+    return motion_generator(robot_state, period);
+  });
+  cycle_timer_.report("move_to_joint_angles", std::cout);
 }
 
 int PandaInterface::get_closest_time(float time,
@@ -216,45 +233,86 @@ int PandaInterface::get_closest_time(float time,
   return closest_time_index;
 }
 
+void PandaInterface::init_kinematics() {
+  if (kinematics_loaded_) {
+    return;
+  }
+  kinematics_loaded_ = true;
+
+  std::string name = "panda";
+  if (!kdl_parser::treeFromFile(URDF_PATH, tree_)) {
+    std::cout << "Failed to parse urdf " << URDF_PATH
+              << ", fk and ik are unavailable" << std::endl;
+    return;
+  }
+  if (!tree_.getChain(name + "_link0", name + "_hand", chain_)) {
+    std::cout << "Failed to extract the chain from " << URDF_PATH
+              << ", fk and ik are unavailable" << std::endl;
+    return;
+  }
+  kinematics_ok_ = true;
+
+  std::array<double, 7> lower_limits = {-0.400924, 1.23538, -2.8973, -3.0718,
+                                        -2.8973,   -0.0175, -2.8973};
+  std::array<double, 7> upper_limits = {-0.400924, 1.23538, 2.8973, -0.0698,
+                                        2.8973,    3.7525,  2.8973};
+
+  // set limits
+  ik_lower_limits_.resize(chain_.getNrOfJoints());
+  ik_upper_limits_.resize(chain_.getNrOfJoints());
+  for (int i = 0; i < chain_.getNrOfJoints(); i++) {
+    ik_lower_limits_(i) = lower_limits[i];
+    ik_upper_limits_(i) = upper_limits[i];
+  }
+}
+
+std::atomic<std::uint64_t> PandaInterface::next_kinematics_id_{0};
+
+std::shared_ptr<PandaInterface::KinematicSolvers>
+PandaInterface::get_solvers() {
+  // destroyed with the thread, so short lived workers leave nothing behind
+  thread_local std::map<std::uint64_t, std::shared_ptr<KinematicSolvers>>
+      thread_solvers;
+  auto it = thread_solvers.find(kinematics_id_);
+  if (it != thread_solvers.end()) {
+    return it->second;
+  }
+
+  std::lock_guard<std::mutex> lock(kinematics_mutex_);
+  init_kinematics();
+  if (!kinematics_ok_) {
+    return nullptr;
+  }
+  std::shared_ptr<KinematicSolvers> solvers =
+      std::make_shared<KinematicSolvers>();
+  solvers->chain = chain_;
+  solvers->fk_solver =
+      std::make_unique<KDL::ChainFkSolverPos_recursive>(solvers->chain);
+  solvers->ik_solver = std::make_unique<TRAC_IK::TRAC_IK>(
+      solvers->chain, ik_lower_limits_, ik_upper_limits_);
+  thread_solvers[kinematics_id_] = solvers;
+  return solvers;
+}
+
 successJointAngles PandaInterface::ik(std::array<double, 7> pose) {
   /*
    * Get the joint angles for a given pose using trac_ik
    * @param pose: 7 element array of doubles representing the pose of the end
    * effector in the form [x, y, z, qx, qy, qz, qw]
-   * @param urdf_path: path to urdf file
    * @return: a struct containing a bool representing whether the ik was
    * successful and a 7 element array of doubles representing the joint angles
    */
-  // load robot model from urdf
-  std::string name = "panda";
   successJointAngles s;
   bool success = true;
 
-  // create tree from urdf_string
-  KDL::Tree tree;
-  kdl_parser::treeFromFile(URDF_PATH, tree);
-
-  // create chain from tree
-  KDL::Chain chain;
-  tree.getChain(name + "_link0", name + "_hand", chain);
-  // std::cout << "Num Joints in chain: " << chain.getNrOfJoints() << std::endl;
-
-  std::array<double, 7> lower_limits = {-0.400924, 1.23538, -2.8973, -3.0718,
-                                        -2.8973,   -0.0175, -2.8973};
-  std::array<double, 7> upper_limits = {-0.400924, 1.23538, 2.8973, -0.0698,
-                                        2.8973,    3.7525,  2.8973};
-
-  // set limits
-  KDL::JntArray ll, ul;
-  ll.resize(chain.getNrOfJoints());
-  ul.resize(chain.getNrOfJoints());
-  for (int i = 0; i < chain.getNrOfJoints(); i++) {
-    ll(i) = lower_limits[i];
-    ul(i) = upper_limits[i];
+  // the solver of this thread, created once from the urdf loaded in init
+  std::shared_ptr<KinematicSolvers> solvers = get_solvers();
+  if (!solvers) {
+    s.joint_angles.fill(0.0);
+    s.success = false;
+    return s;
   }
-
-  // create ik solver
-  TRAC_IK::TRAC_IK tracik_solver(chain, ll, ul);
+  TRAC_IK::TRAC_IK &tracik_solver = *solvers->ik_solver;
   // create ik problem
   KDL::JntArray q(7);
   KDL::Frame frame;
@@ -288,16 +346,16 @@ successJointAngles PandaInterface::ik(std::array<double, 7> pose) {
 
 // ik using trac_ik
 successJointAngles PandaInterface::ik(std::array<double, 7> pose,
-                                      KDL::Tree tree) {
+                                      const KDL::Tree &tree) {
   /*
    * Get the joint angles for a given pose using trac_ik
    * @param pose: 7 element array of doubles representing the pose of the end
    * effector in the form [x, y, z, qx, qy, qz, qw]
-   * @param urdf_path: path to urdf file
+   * @param tree: the robot model to solve for, the solver is built from it on
+   * every call
    * @return: a struct containing a bool representing whether the ik was
    * successful and a 7 element array of doubles representing the joint angles
    */
-  // load robot model from urdf
   std::string name = "panda";
   successJointAngles s;
   bool success = true;
@@ -365,24 +423,21 @@ std::array<double, 7> PandaInterface::fk(std::array<double, 7> q) {
   /*
    * Calculate End Effector Pose from Joint Angles using KDL
    * @param q: joint angles
-   * @param urdf_path: path to urdf file
    * @return: end effector pose
    */
-  // instantiate kdl tree
-  KDL::Tree my_tree;
-  kdl_parser::treeFromFile(URDF_PATH, my_tree);
-  KDL::Chain chain;
-  // get chain from base to end effector
-  my_tree.getChain("panda_link0", "panda_hand", chain);
   // set joint positions
-  KDL::JntArray jointpositions = KDL::JntArray(chain.getNrOfJoints());
+  KDL::JntArray jointpositions = KDL::JntArray(7);
   for (int i = 0; i < 7; i++) {
     jointpositions(i) = q[i];
   }
   // instantiate frame
   KDL::Frame cartpos;
-  KDL::ChainFkSolverPos_recursive fksolver =
-      KDL::ChainFkSolverPos_recursive(chain);
+  std::shared_ptr<KinematicSolvers> solvers = get_solvers();
+  if (!solvers) {
+    std::cout << "Error: could not calculate forward kinematics" << std::endl;
+    return q;
+  }
+  KDL::ChainFkSolverPos_recursive &fksolver = *solvers->fk_solver;
   bool kinematics_status;
   // calculate forward kinematics
   kinematics_status = fksolver.JntToCart(jointpositions, cartpos);
@@ -403,21 +458,223 @@ std::array<double, 7> PandaInterface::fk(std::array<double, 7> q) {
   }
 }
 
-void PandaInterface::follow_joint_waypoints(
+bool PandaInterface::follow_joint_waypoints(
     franka::Robot *robot, std::vector<std::array<double, 7>> joint_waypoints,
-    double speed_factor) {
+    double speed_factor, double tolerance) {
+  if (joint_waypoints.empty()) {
+    return true;
+  }
+  move_to_joint_angles(robot, joint_waypoints[0]);
+  tacbot::FrankaBackend backend(robot);
+  return follow_joint_waypoints(backend, joint_waypoints, speed_factor,
+                                tolerance);
+}
+
+bool PandaInterface::follow_joint_waypoints(
+    franka::Robot *robot, const tacbot::JointTrajectorySpline &trajectory,
+    double speed_factor, double tolerance) {
+  if (trajectory.size() == 0) {
+    return true;
+  }
+  std::vector<std::array<double, 7>> joint_waypoints;
+  std::vector<std::array<double, 7>> joint_velocities;
+  joint_waypoints.reserve(trajectory.size());
+  joint_velocities.reserve(trajectory.size());
+  for (std::size_t i = 0; i < trajectory.size(); i++) {
+    joint_waypoints.push_back(trajectory.getPosition(i));
+    joint_velocities.push_back(trajectory.getVelocity(i));
+  }
   move_to_joint_angles(robot, joint_waypoints[0]);
-  for (int i = 1; i < joint_waypoints.size(); i++) {
-    move(robot, joint_waypoints[i - 1], joint_waypoints[i]);
+  tacbot::FrankaBackend backend(robot);
+  return follow_joint_waypoints(backend, joint_waypoints, joint_velocities,
+                                speed_factor, tolerance);
+}
+
+bool PandaInterface::plan_blended_waypoints(
+    const std::vector<std::array<double, 7>> &joint_waypoints,
+    double speed_factor, double tolerance,
+    std::vector<ruckig::Trajectory<7>> &segments) {
+  return plan_blended_waypoints(joint_waypoints, {}, speed_factor, tolerance,
+                                segments);
+}
+
+bool PandaInterface::plan_blended_waypoints(
+    const std::vector<std::array<double, 7>> &joint_waypoints,
+    const std::vector<std::array<double, 7>> &joint_velocities,
+    double speed_factor, double tolerance,
+    std::vector<ruckig::Trajectory<7>> &segments) {
+  segments.clear();
+  bool planned = !joint_velocities.empty();
+  if (planned && joint_velocities.size() != joint_waypoints.size()) {
+    std::cout << "Ruckig Trajectory::Got " << joint_velocities.size()
+              << " velocities for " << joint_waypoints.size() << " waypoints"
+              << std::endl;
+    return false;
+  }
+  if (joint_waypoints.size() < 2) {
+    return true;
+  }
+
+  MotionGenerator limits(speed_factor, joint_waypoints.back());
+  std::array<double, 7> dq_max = limits.getMaxVelocity();
+  std::array<double, 7> ddq_max = limits.getMaxAcceleration();
+
+  auto distance = [](const std::array<double, 7> &a,
+                     const std::array<double, 7> &b) {
+    double max_diff = 0;
+    for (int i = 0; i < 7; i++) {
+      max_diff = std::max(max_diff, std::abs(a[i] - b[i]));
+    }
+    return max_diff;
+  };
+
+  // dense paths have waypoints that are too close to be worth a segment
+  std::vector<std::array<double, 7>> waypoints = {joint_waypoints.front()};
+  std::vector<std::size_t> kept = {0};
+  for (std::size_t i = 1; i < joint_waypoints.size(); i++) {
+    bool is_last = i + 1 == joint_waypoints.size();
+    if (distance(joint_waypoints[i], waypoints.back()) > tolerance) {
+      waypoints.push_back(joint_waypoints[i]);
+      kept.push_back(i);
+    } else if (is_last && waypoints.size() > 1) {
+      waypoints.back() = joint_waypoints[i];
+      kept.back() = i;
+    }
+  }
+
+  std::vector<std::array<double, 7>> velocities(waypoints.size(),
+                                                {0, 0, 0, 0, 0, 0, 0});
+  for (std::size_t i = 1; i + 1 < waypoints.size(); i++) {
+    for (int j = 0; j < 7; j++) {
+      if (planned) {
+        // the plan already knows how fast to pass, within the limits
+        velocities[i][j] = std::max(
+            -dq_max[j], std::min(dq_max[j], joint_velocities[kept[i]][j]));
+        continue;
+      }
+      // a joint keeps moving through a waypoint if it moves the same way on
+      // both sides, with a velocity it can brake from within the shorter
+      // side
+      double before = waypoints[i][j] - waypoints[i - 1][j];
+      double after = waypoints[i + 1][j] - waypoints[i][j];
+      if (before * after <= 0) {
+        continue;
+      }
+      double shorter = std::min(std::abs(before), std::abs(after));
+      double speed = std::min(dq_max[j], std::sqrt(ddq_max[j] * shorter));
+      velocities[i][j] = std::copysign(speed, after);
+    }
   }
+
+  std::array<double, 7> zeros = {0, 0, 0, 0, 0, 0, 0};
+  segments.reserve(waypoints.size() - 1);
+  for (std::size_t i = 0; i + 1 < waypoints.size(); i++) {
+    ruckig::InputParameter<7> input =
+        get_ruckig_input(waypoints[i], velocities[i], zeros, waypoints[i + 1],
+                         velocities[i + 1], zeros);
+    input.max_velocity = dq_max;
+    input.max_acceleration = ddq_max;
+
+    ruckig::Trajectory<7> trajectory;
+    ruckig::Result result = ruckig_7.calculate(input, trajectory);
+    if (result != ruckig::Result::Working && i + 2 < waypoints.size()) {
+      // stop at the waypoint instead of passing through it, the next segment
+      // then starts from rest
+      std::cout << "Ruckig Trajectory::Failed to blend waypoint " << i + 1
+                << ", stopping at it" << std::endl;
+      velocities[i + 1] = zeros;
+      input.target_velocity = zeros;
+      result = ruckig_7.calculate(input, trajectory);
+    }
+    if (result != ruckig::Result::Working) {
+      std::cout << "Ruckig Trajectory::Failed to reach waypoint " << i + 1
+                << std::endl;
+      segments.clear();
+      return false;
+    }
+    segments.push_back(trajectory);
+  }
+  return true;
+}
+
+bool PandaInterface::follow_joint_waypoints(
+    tacbot::ControlBackend &robot,
+    const std::vector<std::array<double, 7>> &joint_waypoints,
+    double speed_factor, double tolerance) {
+  return follow_joint_waypoints(robot, joint_waypoints, {}, speed_factor,
+                                tolerance);
+}
+
+bool PandaInterface::follow_joint_waypoints(
+    tacbot::ControlBackend &robot,
+    const std::vector<std::array<double, 7>> &joint_waypoints,
+    const std::vector<std::array<double, 7>> &joint_velocities,
+    double speed_factor, double tolerance) {
+  std::vector<ruckig::Trajectory<7>> segments;
+  if (!plan_blended_waypoints(joint_waypoints, joint_velocities, speed_factor,
+                              tolerance, segments)) {
+    return false;
+  }
+  if (segments.empty()) {
+    return true;
+  }
+
+  double time = 0;
+  double segment_start = 0;
+  std::size_t segment = 0;
+  bool motion_finished = false;
+  std::array<double, 7> new_position;
+  std::array<double, 7> new_velocity;
+  std::array<double, 7> new_acceleration;
+
+  auto joint_velocity_call_back =
+      [&](const franka::RobotState &robot_state,
+          franka::Duration period) -> franka::JointVelocities {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
+    time += period.toSec();
+    while (segment < segments.size() &&
+           time - segment_start >= segments[segment].get_duration()) {
+      segment_start += segments[segment].get_duration();
+      segment++;
+    }
+
+    if (segment == segments.size() && motion_finished) {
+      return franka::MotionFinished(
+          franka::JointVelocities({0, 0, 0, 0, 0, 0, 0}));
+    } else if (segment == segments.size()) {
+      franka::JointVelocities output_velocities = {0, 0, 0, 0, 0, 0, 0};
+      log_control_sample(robot_state, time, period.toSec(),
+                         output_velocities.dq);
+      if (allCloseZero(robot_state.dq, 0.01)) {
+        motion_finished = true;
+      }
+      return output_velocities;
+    } else {
+      segments[segment].at_time(time - segment_start, new_position,
+                                new_velocity, new_acceleration);
+      franka::JointVelocities output_velocities = new_velocity;
+      log_control_sample(robot_state, time, period.toSec(), new_velocity);
+      return output_velocities;
+    }
+  };
+  cycle_timer_.reset();
+  robot.control(joint_velocity_call_back);
+  cycle_timer_.report("follow_joint_waypoints", std::cout);
+  return true;
 }
 
 void PandaInterface::follow_joint_velocities(
-    franka::Robot *robot, std::vector<std::array<double, 7>> joint_velocities) {
+    franka::Robot *robot,
+    const std::vector<std::array<double, 7>> &joint_velocities) {
   //    move_to_joint_angles(robot, [0]);
   move_with_velocity_control(robot, joint_velocities);
 }
 
+void PandaInterface::follow_joint_trajectory(
+    franka::Robot *robot, const tacbot::JointTrajectorySpline &trajectory) {
+  move_with_velocity_control(robot, trajectory);
+}
+
 std::tuple<ruckig::Trajectory<7>, bool> PandaInterface::generate_trajectory(
     ruckig::InputParameter<7> input) {
   ruckig::OutputParameter<7> output;  // Number DoFs
@@ -459,6 +716,7 @@ bool PandaInterface::execute_trajectory_cartesian(
   auto cartesian_velocity_call_back =
       [&](const franka::RobotState &robot_state,
           franka::Duration period) -> franka::CartesianVelocities {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
     time += period.toSec();
     if (time >= duration && motion_finished) {
       return franka::MotionFinished(
@@ -473,7 +731,9 @@ bool PandaInterface::execute_trajectory_cartesian(
       return output_velocities;
     }
   };
+  cycle_timer_.reset();
   robot->control(cartesian_velocity_call_back);
+  cycle_timer_.report("execute_trajectory_cartesian", std::cout);
   return true;
 }
 
@@ -528,25 +788,18 @@ void PandaInterface::move_failure(
     auto joint_velocity_call_back =
         [&](const franka::RobotState &robot_state,
             franka::Duration period) -> franka::JointVelocities {
+      tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
       fuck_time += period.toSec();
 
-      std::cout << "Time Left: " << duration - fuck_time
-                << ", period to sec: " << period.toSec() << std::endl;
-
-      // if (fuck_time < 0.3){
-      //     std::cout << "Time went backwards" << std::endl;
-      // }
-      std::cout << "----" << std::endl;
-      // if (period.toSec() < 0.001) {
-      //     std::cout <<" period.toSec() < 0.001 "<<period.toSec()<<std::endl;
-      // }
+      // no console output in here, it makes the loop miss its deadlines
       last_time = fuck_time;
-      timestamps[idx] = fuck_time;
-      joint_angles[idx] = robot_state.q;
-      joint_velocities[idx] = robot_state.dq;
-      joint_accelerations[idx] = robot_state.ddq_d;
-
-      idx++;
+      if (idx < NUM_STEPS) {
+        timestamps[idx] = fuck_time;
+        joint_angles[idx] = robot_state.q;
+        joint_velocities[idx] = robot_state.dq;
+        joint_accelerations[idx] = robot_state.ddq_d;
+        idx++;
+      }
 
       // if (fuck_time >= duration && motion_finished){
       //     std::cout << "Motion finished2" << std::endl;
@@ -554,8 +807,9 @@ void PandaInterface::move_failure(
       //     0, 0, 0}));
       // }
       if (fuck_time >= duration && !motion_finished) {
-        std::cout << "Motion finished1" << std::endl;
         franka::JointVelocities output_velocities = {0, 0, 0, 0, 0, 0, 0};
+        log_control_sample(robot_state, fuck_time, period.toSec(),
+                           output_velocities.dq);
         if (allCloseZero(robot_state.dq, 0.03)) {
           motion_finished = true;
           return franka::MotionFinished(
@@ -566,8 +820,6 @@ void PandaInterface::move_failure(
       } else {
         trajectory->at_time(fuck_time, new_position, new_velocity,
                             new_acceleration);
-        std::cout << "in main motion loop**************************************"
-                  << std::endl;
         std::array<double, 7> new_velocity_7;
         switch (failure_mode) {
           case 1:
@@ -596,11 +848,15 @@ void PandaInterface::move_failure(
         // "<<new_velocity_7[1]<<", "<<new_velocity_7[2]<<",
         // "<<new_velocity_7[3]<<", "<<new_velocity_7[4]<<",
         // "<<new_velocity_7[5]<<", "<<new_velocity_7[6]<<std::endl;
+        log_control_sample(robot_state, fuck_time, period.toSec(),
+                           new_velocity_7);
         franka::JointVelocities output_velocities = new_velocity_7;
         return output_velocities;
       }
     };
+    cycle_timer_.reset();
     robot->control(joint_velocity_call_back);
+    cycle_timer_.report("move_failure", std::cout);
 
     std::cout << "gg ixd: " << idx << std::endl;
     std::cout << "bytes of joint angles: " << sizeof(joint_angles) << std::endl;
@@ -619,6 +875,8 @@ void PandaInterface::move_failure(
     // std::exception_ptr p = std::current_exception();
 
     std::cout << ex.what() << std::endl;
+    // the cycles up to the fault are the interesting ones
+    cycle_timer_.report("move_failure", std::cout);
     robot->automaticErrorRecovery();
     *trajectory_data = std::make_tuple(
         std::array<std::array<double, 7>, NUM_STEPS>(),
@@ -660,31 +918,38 @@ bool PandaInterface::edges_to_npy(
   //     # q_trajs.extend(planar_eb_misc['q'])
   // # qddot_trajs
 
-  std::array<std::array<double, NUM_STEPS>, NUM_EDGES> t;
-  std::array<std::array<double, 2>, NUM_EDGES> edge_timestamp_range;
-  std::array<std::array<double, 7>, NUM_EDGES> traj_start_q;
-  std::array<std::array<std::array<double, 7>, NUM_STEPS>, NUM_EDGES> qdot;
-  std::array<std::array<std::array<double, 7>, NUM_STEPS>, NUM_EDGES> qddot;
-  std::array<std::array<std::array<double, 7>, NUM_STEPS>, NUM_EDGES> qtrajs;
-  std::array<int, NUM_EDGES> num_steps;
+  std::vector<double> t;
+  std::vector<double> edge_timestamp_range;
+  std::vector<double> traj_start_q;
+  std::vector<double> qdot;
+  std::vector<double> qddot;
+  std::vector<double> qtrajs;
+  std::vector<int> num_steps;
 
   for (int i = 0; i < NUM_EDGES; i++) {
-    std::array<double, NUM_STEPS> timestamps = std::get<3>(edges[i]);
-    std::array<std::array<double, 7>, NUM_STEPS> joint_angles =
+    const std::array<double, NUM_STEPS> &timestamps = std::get<3>(edges[i]);
+    const std::array<std::array<double, 7>, NUM_STEPS> &joint_angles =
         std::get<0>(edges[i]);
-    std::array<std::array<double, 7>, NUM_STEPS> joint_velocities =
+    const std::array<std::array<double, 7>, NUM_STEPS> &joint_velocities =
         std::get<1>(edges[i]);
-    std::array<std::array<double, 7>, NUM_STEPS> joint_acc =
+    const std::array<std::array<double, 7>, NUM_STEPS> &joint_acc =
         std::get<2>(edges[i]);
 
-    num_steps[i] = std::get<5>(edges[i]);
-    edge_timestamp_range[i] = std::get<4>(edges[i]);
-    traj_start_q[i] = joint_angles[0];
-
-    t[i] = timestamps;
-    qdot[i] = joint_velocities;
-    qtrajs[i] = joint_angles;
-    qddot[i] = joint_acc;
+    num_steps.push_back(std::get<5>(edges[i]));
+    edge_timestamp_range.insert(edge_timestamp_range.end(),
+                                std::get<4>(edges[i]).begin(),
+                                std::get<4>(edges[i]).end());
+    traj_start_q.insert(traj_start_q.end(), joint_angles[0].begin(),
+                        joint_angles[0].end());
+
+    t.insert(t.end(), timestamps.begin(), timestamps.end());
+    for (int step = 0; step < NUM_STEPS; step++) {
+      qdot.insert(qdot.end(), joint_velocities[step].begin(),
+                  joint_velocities[step].end());
+      qtrajs.insert(qtrajs.end(), joint_angles[step].begin(),
+                    joint_angles[step].end());
+      qddot.insert(qddot.end(), joint_acc[step].begin(), joint_acc[step].end());
+    }
   }
 
   auto t_ = std::time(nullptr);
@@ -694,28 +959,35 @@ bool PandaInterface::edges_to_npy(
   oss << std::put_time(&tm, "%d-%m-%Y %H-%M-%S");
   auto str = oss.str();
 
-  // cnpy::npz_save("eb_by_hand_" + str + ".npz", "num_steps", &num_steps[0],
-  //                {NUM_EDGES}, "w");
-  // cnpy::npz_save("eb_by_hand_" + str + ".npz", "edge_timestamp_range",
-  //                &edge_timestamp_range[0][0], {NUM_EDGES, 2}, "a");
-  // cnpy::npz_save("eb_by_hand_" + str + ".npz", "traj_start_q",
-  //                &traj_start_q[0][0], {NUM_EDGES, 7}, "a");
-  // cnpy::npz_save("eb_by_hand_" + str + ".npz", "t", &t[0][0],
-  //                {NUM_EDGES, NUM_STEPS}, "a");
-  // cnpy::npz_save("eb_by_hand_" + str + ".npz", "qdot", &qdot[0][0][0],
-  //                {NUM_EDGES, NUM_STEPS, 7}, "a");
-
-  // cnpy::npz_save("eb_by_hand_" + str + ".npz", "qddot", &qddot[0][0][0],
-  //                {NUM_EDGES, NUM_STEPS, 7}, "a");
-  // cnpy::npz_save("eb_by_hand_" + str + ".npz", "q", &qtrajs[0][0][0],
-  //                {NUM_EDGES, NUM_STEPS, 7}, "a");
-  // TODO: make it return false if the file is not saved
-  return true;
+  // one .npy file per array of the former npz archive
+  const std::string prefix = "eb_by_hand_" + str + "_";
+  std::size_t edges_n = NUM_EDGES;
+  std::size_t steps_n = NUM_STEPS;
+  return tacbot::saveNpy(prefix + "num_steps.npy", num_steps.data(),
+                         {edges_n}) &&
+         tacbot::saveNpy(prefix + "edge_timestamp_range.npy",
+                         edge_timestamp_range.data(), {edges_n, 2}) &&
+         tacbot::saveNpy(prefix + "traj_start_q.npy", traj_start_q.data(),
+                         {edges_n, 7}) &&
+         tacbot::saveNpy(prefix + "t.npy", t.data(), {edges_n, steps_n}) &&
+         tacbot::saveNpy(prefix + "qdot.npy", qdot.data(),
+                         {edges_n, steps_n, 7}) &&
+         tacbot::saveNpy(prefix + "qddot.npy", qddot.data(),
+                         {edges_n, steps_n, 7}) &&
+         tacbot::saveNpy(prefix + "q.npy", qtrajs.data(),
+                         {edges_n, steps_n, 7});
 }
 
 bool PandaInterface::move(franka::Robot *robot,
                           std::array<double, 7> current_joint_angles,
                           std::array<double, 7> target_joint_angles) {
+  tacbot::FrankaBackend backend(robot);
+  return move(backend, current_joint_angles, target_joint_angles);
+}
+
+bool PandaInterface::move(tacbot::ControlBackend &robot,
+                          std::array<double, 7> current_joint_angles,
+                          std::array<double, 7> target_joint_angles) {
   ROS_INFO("Moving to target joint angles");
   std::array<double, 7> initial_q_dot = {0, 0, 0, 0, 0, 0, 0};
   std::array<double, 7> initial_q_ddot = {0, 0, 0, 0, 0, 0, 0};
@@ -743,6 +1015,7 @@ bool PandaInterface::move(franka::Robot *robot,
   auto joint_velocity_call_back =
       [&](const franka::RobotState &robot_state,
           franka::Duration period) -> franka::JointVelocities {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
     time += period.toSec();
     if (time >= duration && motion_finished) {
       return franka::MotionFinished(
@@ -757,10 +1030,242 @@ bool PandaInterface::move(franka::Robot *robot,
       return output_velocities;
     }
   };
-  robot->control(joint_velocity_call_back);
+  cycle_timer_.reset();
+  robot.control(joint_velocity_call_back);
+  cycle_timer_.report("move", std::cout);
   return true;
 }
 
+bool PandaInterface::move_online(franka::Robot *robot,
+                                 std::array<double, 7> target_q) {
+  tacbot::FrankaBackend backend(robot);
+  return move_online(backend, target_q);
+}
+
+bool PandaInterface::move_online(tacbot::ControlBackend &robot,
+                                 std::array<double, 7> target_q) {
+  // targets that were set before this motion are stale
+  JointTarget target;
+  while (online_targets_.pop(target)) {
+  }
+
+  std::array<double, 7> zeros = {0, 0, 0, 0, 0, 0, 0};
+  franka::RobotState initial_state = robot.readOnce();
+  ruckig::InputParameter<7> input = get_ruckig_input(
+      initial_state.q_d, zeros, zeros, target_q, zeros, zeros);
+  if (!std::get<1>(generate_trajectory(input))) {
+    return false;
+  }
+  JointTarget valid_target;
+  valid_target.q = target_q;
+  ruckig::OutputParameter<7> output;
+  output.new_velocity = zeros;
+
+  ruckig::Ruckig<7> otg(0.001);
+  double time = 0;
+  bool target_reached = false;
+  bool stopping = false;
+  bool failed = false;
+
+  // bring the robot to rest wherever it is, for targets that are passed with
+  // a velocity and when no trajectory can be computed any more
+  auto begin_stop = [&]() {
+    input.control_interface = ruckig::ControlInterface::Velocity;
+    input.target_velocity = zeros;
+    input.target_acceleration = zeros;
+    stopping = true;
+  };
+
+  auto joint_velocity_call_back =
+      [&](const franka::RobotState &robot_state,
+          franka::Duration period) -> franka::JointVelocities {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
+    time += period.toSec();
+
+    JointTarget new_target;
+    bool target_changed = false;
+    while (online_targets_.pop(new_target)) {
+      target_changed = true;
+    }
+    if (target_changed && !failed) {
+      // start from the measured position, velocity and acceleration stay the
+      // commanded ones so that the command is continuous
+      input.control_interface = ruckig::ControlInterface::Position;
+      input.current_position = robot_state.q;
+      input.target_position = new_target.q;
+      input.target_velocity = new_target.dq;
+      stopping = false;
+      target_reached = false;
+    }
+
+    // one step per millisecond that has passed, missed cycles included
+    long steps = std::lround(period.toSec() * 1000.0);
+    for (long step = 0; step < steps && !target_reached; step++) {
+      ruckig::Result result = otg.update(input, output);
+      if (result != ruckig::Result::Working &&
+          result != ruckig::Result::Finished && !stopping) {
+        // go back to the last target a trajectory could be computed for
+        input.target_position = valid_target.q;
+        input.target_velocity = valid_target.dq;
+        result = otg.update(input, output);
+        if (result != ruckig::Result::Working &&
+            result != ruckig::Result::Finished) {
+          failed = true;
+          begin_stop();
+          result = otg.update(input, output);
+        }
+      } else if (!stopping) {
+        valid_target.q = input.target_position;
+        valid_target.dq = input.target_velocity;
+      }
+      if (result != ruckig::Result::Working &&
+          result != ruckig::Result::Finished) {
+        throw std::runtime_error(
+            "move_online: no trajectory to stop the robot");
+      }
+      output.pass_to_input(input);
+
+      if (result == ruckig::Result::Finished) {
+        if (stopping || allCloseZero(input.target_velocity, 1e-6)) {
+          target_reached = true;
+        } else {
+          // the target was passed at its velocity, come to rest after it
+          begin_stop();
+        }
+      }
+    }
+
+    franka::JointVelocities output_velocities = output.new_velocity;
+    log_control_sample(robot_state, time, period.toSec(),
+                       output_velocities.dq);
+    if (target_reached && allCloseZero(output.new_velocity, 1e-6)) {
+      return franka::MotionFinished(
+          franka::JointVelocities({0, 0, 0, 0, 0, 0, 0}));
+    }
+    return output_velocities;
+  };
+  cycle_timer_.reset();
+  robot.control(joint_velocity_call_back);
+  cycle_timer_.report("move_online", std::cout);
+  if (failed) {
+    std::cout << "move_online: no trajectory to the last valid target, "
+                 "stopped the robot"
+              << std::endl;
+  }
+  return !failed;
+}
+
+void PandaInterface::set_online_target(
+    const std::array<double, 7> &target_q,
+    const std::array<double, 7> &target_q_vel) {
+  JointTarget target;
+  target.q = target_q;
+  target.dq = target_q_vel;
+  if (!online_targets_.push(target)) {
+    std::cout << "Dropped online target, the control loop is not reading"
+              << std::endl;
+  }
+}
+
+bool PandaInterface::follow_trajectory_channel(franka::Robot *robot) {
+  tacbot::FrankaBackend backend(robot);
+  return follow_trajectory_channel(backend);
+}
+
+bool PandaInterface::follow_trajectory_channel(tacbot::ControlBackend &robot) {
+  trajectory_channel_.reset(robot.readOnce().q_d);
+  double time = 0;
+
+  auto joint_velocity_call_back =
+      [&](const franka::RobotState &robot_state,
+          franka::Duration period) -> franka::JointVelocities {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
+    time += period.toSec();
+    franka::JointVelocities output_velocities =
+        trajectory_channel_.update(period.toSec());
+    log_control_sample(robot_state, time, period.toSec(),
+                       output_velocities.dq);
+    if (trajectory_channel_.isFinished()) {
+      return franka::MotionFinished(
+          franka::JointVelocities({0, 0, 0, 0, 0, 0, 0}));
+    }
+    return output_velocities;
+  };
+  cycle_timer_.reset();
+  robot.control(joint_velocity_call_back);
+  cycle_timer_.report("follow_trajectory_channel", std::cout);
+  return true;
+}
+
+bool PandaInterface::start_control_log(const std::string &path) {
+  return control_logger_.start(path);
+}
+
+void PandaInterface::stop_control_log() {
+  control_logger_.stop();
+  if (control_logger_.getDropped() > 0) {
+    std::cout << "Control log dropped " << control_logger_.getDropped()
+              << " samples" << std::endl;
+  }
+}
+
+void PandaInterface::log_control_sample(const franka::RobotState &robot_state,
+                                        double time, double period,
+                                        const std::array<double, 7> &command) {
+  tacbot::ControlSample sample;
+  sample.time = time;
+  sample.period = period;
+  sample.q = robot_state.q;
+  sample.dq = robot_state.dq;
+  sample.ddq_d = robot_state.ddq_d;
+  sample.tau_J = robot_state.tau_J;
+  sample.command = command;
+  control_logger_.record(sample);
+}
+
+void PandaInterface::set_execution_monitor(tacbot::ExecutionMonitor *monitor) {
+  execution_monitor_ = monitor;
+}
+
+void PandaInterface::enable_contact_detection(
+    const tacbot::ContactDetector::Options &options) {
+  contact_detector_.setOptions(options);
+  contact_detector_.reset();
+  contact_detection_ = true;
+}
+
+void PandaInterface::disable_contact_detection() { contact_detection_ = false; }
+
+void PandaInterface::update_contact_detection(
+    const franka::RobotState &robot_state, double period,
+    tacbot::ExecutionStatus &status) {
+  if (!contact_detection_ || !robot_model_) {
+    return;
+  }
+  if (contact_detector_.update(robot_state, *robot_model_, period)) {
+    const tacbot::ContactDetector::Contact &contact =
+        contact_detector_.getContact();
+    status.contact_link = static_cast<std::int32_t>(contact.link);
+    status.contact_point = contact.point;
+  }
+}
+
+void PandaInterface::publish_execution_status(
+    tacbot::ExecutionStatus &status, const franka::RobotState &robot_state,
+    double time, std::size_t pt_idx, tacbot::ExecutionStatus::State state) {
+  if (execution_monitor_ == nullptr) {
+    return;
+  }
+  status.state = state;
+  status.pt_idx = static_cast<std::uint32_t>(pt_idx);
+  status.time = time;
+  status.q = robot_state.q;
+  status.tau_measured = robot_state.tau_J;
+  status.tau_residual = contact_detection_ ? contact_detector_.getResidual()
+                                           : robot_state.tau_ext_hat_filtered;
+  execution_monitor_->publish(status);
+}
+
 bool PandaInterface::allCloseZero(const std::array<double, 7> &arr,
                                   double tolerance) {
   auto withinTolerance = [&](double x) { return std::abs(x) <= tolerance; };
@@ -768,48 +1273,175 @@ bool PandaInterface::allCloseZero(const std::array<double, 7> &arr,
 }
 
 bool PandaInterface::move_with_velocity_control(
-    franka::Robot *robot, std::vector<std::array<double, 7>> joint_velocities) {
-  double duration = double(joint_velocities.size()) * 0.001 - 0.002;
+    franka::Robot *robot,
+    const std::vector<std::array<double, 7>> &joint_velocities) {
+  return move_with_velocity_control(
+      robot, tacbot::JointTrajectorySpline::fromVelocities(joint_velocities));
+}
+
+bool PandaInterface::move_with_velocity_control(
+    franka::Robot *robot, const tacbot::JointTrajectorySpline &trajectory) {
+  tacbot::FrankaBackend backend(robot);
+  return move_with_velocity_control(backend, trajectory);
+}
+
+bool PandaInterface::move_with_velocity_control(
+    tacbot::ControlBackend &robot,
+    const tacbot::JointTrajectorySpline &trajectory) {
+  double duration = trajectory.getDuration();
   double time = 0;
   bool motion_finished = false;
-  bool done = false;
-  int i = 0;
-  while (!done) {
-    std::array<double, 7> new_velocity = joint_velocities[i];
+  std::size_t segment = 0;
+  tacbot::ExecutionStatus execution_status;
 
-    auto joint_velocity_call_back =
-        [&](const franka::RobotState &robot_state,
-            franka::Duration period) -> franka::JointVelocities {
-      // std::cout << "period: " << period.toSec() << std::endl;
-      time += 0.001;
-      std::array<double, 7> new_velocity = joint_velocities[i];
-      i++;
-
-      if (time >= duration && motion_finished) {
-        done = true;
-        return franka::MotionFinished(
-            franka::JointVelocities({0, 0, 0, 0, 0, 0, 0}));
-      } else if (time >= duration && !motion_finished) {
-        franka::JointVelocities output_velocities = {0, 0, 0, 0, 0, 0, 0};
-        std::array<double, 7> dq = robot_state.dq;
-        if (allCloseZero(dq, 0.01)) {
-          motion_finished = true;
+  // targets that were set before this motion are stale
+  JointTarget target;
+  while (online_targets_.pop(target)) {
+  }
+
+  // a target set with set_online_target while the trajectory runs takes over
+  // from it, as in move_online, without stopping first
+  std::array<double, 7> zeros = {0, 0, 0, 0, 0, 0, 0};
+  std::array<double, 7> last_command = zeros;
+  std::array<double, 7> last_acceleration = zeros;
+  ruckig::Ruckig<7> otg(0.001);
+  ruckig::InputParameter<7> input;
+  ruckig::OutputParameter<7> output;
+  bool retargeted = false;
+  bool stopping = false;
+  bool target_reached = false;
+
+  auto begin_stop = [&]() {
+    input.control_interface = ruckig::ControlInterface::Velocity;
+    input.target_velocity = zeros;
+    input.target_acceleration = zeros;
+    stopping = true;
+  };
+
+  // the commanded velocity and acceleration, for a target to start from
+  auto remember_command = [&](const std::array<double, 7> &command,
+                              double period) {
+    if (period > 0.0) {
+      for (std::size_t i = 0; i < 7; i++) {
+        last_acceleration[i] = (command[i] - last_command[i]) / period;
+      }
+    }
+    last_command = command;
+  };
+
+  auto joint_velocity_call_back =
+      [&](const franka::RobotState &robot_state,
+          franka::Duration period) -> franka::JointVelocities {
+    tacbot::CycleTimer::Scope cycle(cycle_timer_, period.toSec());
+    // the period covers any cycles that were missed
+    time += period.toSec();
+    update_contact_detection(robot_state, period.toSec(), execution_status);
+
+    JointTarget new_target;
+    bool target_changed = false;
+    while (online_targets_.pop(new_target)) {
+      target_changed = true;
+    }
+    if (target_changed) {
+      if (!retargeted) {
+        // continue from the command of the last cycle, so that it stays
+        // continuous
+        input = get_ruckig_input(robot_state.q, last_command,
+                                 last_acceleration, new_target.q,
+                                 new_target.dq, zeros);
+        output.new_velocity = last_command;
+        retargeted = true;
+      }
+      input.control_interface = ruckig::ControlInterface::Position;
+      input.current_position = robot_state.q;
+      input.target_position = new_target.q;
+      input.target_velocity = new_target.dq;
+      input.target_acceleration = zeros;
+      stopping = false;
+      target_reached = false;
+    }
+
+    if (retargeted) {
+      long steps = std::lround(period.toSec() * 1000.0);
+      for (long step = 0; step < steps && !target_reached; step++) {
+        ruckig::Result result = otg.update(input, output);
+        if (result != ruckig::Result::Working &&
+            result != ruckig::Result::Finished && !stopping) {
+          // no trajectory to the target, come to rest where the robot is
+          begin_stop();
+          result = otg.update(input, output);
         }
-        return output_velocities;
-      } else {
-        franka::JointVelocities output_velocities = new_velocity;
+        if (result != ruckig::Result::Working &&
+            result != ruckig::Result::Finished) {
+          throw std::runtime_error(
+              "move_with_velocity_control: no trajectory to stop the robot");
+        }
+        output.pass_to_input(input);
+
+        if (result == ruckig::Result::Finished) {
+          if (stopping || allCloseZero(input.target_velocity, 1e-6)) {
+            target_reached = true;
+          } else {
+            begin_stop();
+          }
+        }
+      }
 
-        // std::cout << std::endl;
-        // for (auto vel : new_velocity) {
-        //   std::cout << vel << ", ";
-        // }
-        // std::cout << std::endl;
+      franka::JointVelocities output_velocities = output.new_velocity;
+      log_control_sample(robot_state, time, period.toSec(),
+                         output_velocities.dq);
+      if (target_reached && allCloseZero(output.new_velocity, 1e-6)) {
+        publish_execution_status(execution_status, robot_state, time, segment,
+                                 tacbot::ExecutionStatus::FINISHED);
+        return franka::MotionFinished(franka::JointVelocities(zeros));
+      }
+      publish_execution_status(execution_status, robot_state, time, segment,
+                               tacbot::ExecutionStatus::RUNNING);
+      return output_velocities;
+    }
 
-        return output_velocities;
+    if (time >= duration && motion_finished) {
+      publish_execution_status(execution_status, robot_state, time, segment,
+                               tacbot::ExecutionStatus::FINISHED);
+      return franka::MotionFinished(
+          franka::JointVelocities({0, 0, 0, 0, 0, 0, 0}));
+    } else if (time >= duration && !motion_finished) {
+      franka::JointVelocities output_velocities = {0, 0, 0, 0, 0, 0, 0};
+      log_control_sample(robot_state, time, period.toSec(),
+                         output_velocities.dq);
+      publish_execution_status(execution_status, robot_state, time, segment,
+                               tacbot::ExecutionStatus::RUNNING);
+      remember_command(output_velocities.dq, period.toSec());
+      std::array<double, 7> dq = robot_state.dq;
+      if (allCloseZero(dq, 0.01)) {
+        motion_finished = true;
       }
-    };
-    robot->control(joint_velocity_call_back);
+      return output_velocities;
+    } else {
+      franka::JointVelocities output_velocities =
+          trajectory.velocityAt(time, segment);
+      log_control_sample(robot_state, time, period.toSec(),
+                         output_velocities.dq);
+      publish_execution_status(execution_status, robot_state, time, segment,
+                               tacbot::ExecutionStatus::RUNNING);
+      remember_command(output_velocities.dq, period.toSec());
+      return output_velocities;
+    }
+  };
+  contact_detector_.reset();
+  cycle_timer_.reset();
+  try {
+    robot.control(joint_velocity_call_back);
+  } catch (const franka::Exception &ex) {
+    // tell the planner where the motion was aborted before handling the error
+    if (execution_monitor_ != nullptr) {
+      execution_status.state = tacbot::ExecutionStatus::FAILED;
+      execution_monitor_->publish(execution_status);
+    }
+    cycle_timer_.report("move_with_velocity_control", std::cout);
+    throw;
   }
+  cycle_timer_.report("move_with_velocity_control", std::cout);
 
   return true;
 }
@@ -831,7 +1463,7 @@ std::array<double, 3> PandaInterface::quaternion_to_euler(double x, double y,
   return euler;
 }
 
-void PandaInterface::move_down_and_interact(franka::Robot *robot,
+bool PandaInterface::move_down_and_interact(franka::Robot *robot,
                                             franka::Gripper *gripper,
                                             float height, double object_width,
                                             bool interaction) {
@@ -869,10 +1501,10 @@ void PandaInterface::move_down_and_interact(franka::Robot *robot,
   successJointAngles target = ik(goal_pose);
   // ROS_INFO("Opening Gripper");
   // gripper->homing();
-  if (interaction) {  // open gripper
-    // open gripper
-    franka::GripperState gripper_state = gripper->readOnce();
-    gripper->move(gripper_state.max_width, speed);
+  tacbot::GripperExecutor &gripper_executor = get_gripper_executor(gripper);
+  std::future<bool> opened;
+  if (interaction) {  // open the gripper while moving down
+    opened = gripper_executor.open(speed);
   }
   ROS_INFO("Moving Down");
   bool up_success = false;
@@ -897,19 +1529,52 @@ void PandaInterface::move_down_and_interact(franka::Robot *robot,
             << current_pose_euler[0] << ", " << current_pose_euler[1] << ", "
             << current_pose_euler[2] << std::endl;
 
+  bool gripper_success = true;
   if (interaction) {  // pick up object
-    ROS_INFO("Grasping");
-    gripper->grasp(object_width, speed, force, 0.02, 0.02);
-  } else {  // place object
-    gripper->stop();
-    franka::GripperState gripper_state = gripper->readOnce();
-    gripper->move(gripper_state.max_width, speed);
-    gripper->stop();
+    // the fingers have to be open before they close on the object, and the
+    // object has to be held before moving up
+    gripper_success = wait_for_gripper(opened, "Opening");
+    if (gripper_success) {
+      ROS_INFO("Grasping");
+      std::future<bool> grasped =
+          gripper_executor.grasp(object_width, speed, force, 0.02, 0.02);
+      gripper_success = wait_for_gripper(grasped, "Grasping");
+    }
+  } else {  // place object, the object is released as soon as the fingers
+            // start to open, so they can keep opening while moving up
+    gripper_executor.stop();
+    opened = gripper_executor.open(speed);
   }
   ROS_INFO("Moving Up");
   // bool down_success = move(robot, target.joint_angles, current_joint_angles);
   bool down_success =
       move_cartesian(robot, goal_pose_euler_array, current_pose_euler_array);
+  if (!interaction) {
+    gripper_success = wait_for_gripper(opened, "Opening");
+  }
+  return up_success && down_success && gripper_success;
+}
+
+tacbot::GripperExecutor &PandaInterface::get_gripper_executor(
+    franka::Gripper *gripper) {
+  if (!gripper_executor_ || gripper_executor_->getGripper() != gripper) {
+    gripper_executor_.reset();
+    gripper_executor_ = std::make_unique<tacbot::GripperExecutor>(gripper);
+  }
+  return *gripper_executor_;
+}
+
+bool PandaInterface::wait_for_gripper(std::future<bool> &result,
+                                      const std::string &action) {
+  try {
+    if (result.get()) {
+      return true;
+    }
+    ROS_ERROR("%s failed", action.c_str());
+  } catch (const franka::Exception &ex) {
+    ROS_ERROR("%s failed: %s", action.c_str(), ex.what());
+  }
+  return false;
 }
 
 void PandaInterface::cleanup(franka::Robot *robot, franka::Gripper *gripper) {
@@ -917,5 +1582,7 @@ void PandaInterface::cleanup(franka::Robot *robot, franka::Gripper *gripper) {
   delete &ruckig_6;
   delete &ruckig_7;
   delete robot;
+  // the executor finishes the gripper's commands before the gripper goes
+  gripper_executor_.reset();
   delete gripper;
 }
@@ -25,13 +25,30 @@ constexpr char LOGNAME[] = "perception_planner";
 namespace tacbot {
 
 PerceptionPlanner::PerceptionPlanner() : BasePlanner() {
-  ROS_INFO_NAMED(LOGNAME, "contact_perception_->init()");
-  contact_perception_ = std::make_shared<ContactPerception>();
+  // Contact depths are in meters and are zero away from the obstacles, where
+  // most cells are. The tolerance is tight enough that the simplices in which
+  // a depth starts or stops growing are evaluated exactly.
+  FieldGridCache::Options grid_options;
+  grid_options.tolerance = 0.005;
+  contact_cost_grid_.setOptions(grid_options);
+  contact_field_grid_.setOptions(grid_options);
 }
 
 void PerceptionPlanner::init() {
   BasePlanner::init();
+  ROS_INFO_NAMED(LOGNAME, "contact_perception_->init()");
+  contact_perception_ = std::make_shared<ContactPerception>();
   contact_perception_->init();
+  initScene();
+}
+
+void PerceptionPlanner::init(const std::string& urdf_path,
+                             const std::string& srdf_path) {
+  BasePlanner::init(urdf_path, srdf_path);
+  initScene();
+}
+
+void PerceptionPlanner::initScene() {
   setCollisionChecker("Bullet");
   setGoalState(2);
   setObstacleScene(3);
@@ -118,8 +135,16 @@ void PerceptionPlanner::setObstacleScene(std::size_t option) {
 
   for (auto& obstacle : obstacles_) {
     addPointObstacles(obstacle);
-    contact_perception_->addSphere(obstacle);
+    if (contact_perception_) {
+      contact_perception_->addSphere(obstacle);
+    } else {
+      addCollisionObject(ContactPerception::sphereToCollisionObject(obstacle));
+    }
   }
+
+  // The planner is allowed to move through the obstacles, their contact is
+  // measured separately through contact_acm_.
+  sphericalCollisionPermission(true);
 }
 
 void PerceptionPlanner::addPointObstacles(tacbot::ObstacleGroup& obstacle) {
@@ -136,233 +161,153 @@ void PerceptionPlanner::addPointObstacles(tacbot::ObstacleGroup& obstacle) {
   }
 }
 
+const PlannerRegistry<PerceptionPlanner>& PerceptionPlanner::registry() {
+  static const PlannerRegistry<PerceptionPlanner> registry = [] {
+    PlannerRegistry<PerceptionPlanner> r;
+
+    auto contact_objective = [](PerceptionPlanner& planner,
+                                const ompl::base::SpaceInformationPtr& si) {
+      std::function<double(const ompl::base::State*)> optFunc =
+          std::bind(&PerceptionPlanner::overlapMagnitude, &planner,
+                    std::placeholders::_1);
+      return std::make_shared<ompl::base::MinimizeContactObjective>(si,
+                                                                    optFunc);
+    };
+
+    FieldParams default_field;
+
+    r.addPlanner(
+        "BITstar",
+        {[contact_objective](PerceptionPlanner& planner,
+                             const ompl::geometric::SimpleSetupPtr& ss,
+                             const FieldFunctions&) {
+           ompl::base::SpaceInformationPtr si = ss->getSpaceInformation();
+           planner.optimization_objective_ = contact_objective(planner, si);
+           // simple_setup->setOptimizationObjective(optimization_objective_);
+           ss->setOptimizationObjective(
+               std::make_shared<ompl::base::PathLengthOptimizationObjective>(
+                   si));
+           return std::make_shared<ompl::geometric::BITstar>(si);
+         },
+         default_field});
+
+    r.addPlanner(
+        "RRTstar",
+        {[contact_objective](PerceptionPlanner& planner,
+                             const ompl::geometric::SimpleSetupPtr& ss,
+                             const FieldFunctions&) {
+           ompl::base::SpaceInformationPtr si = ss->getSpaceInformation();
+           planner.optimization_objective_ = contact_objective(planner, si);
+           ss->setOptimizationObjective(planner.optimization_objective_);
+           return std::make_shared<ompl::geometric::RRTstar>(si);
+         },
+         default_field});
+
+    r.addPlanner(
+        "QRRTStar",
+        {[contact_objective](PerceptionPlanner& planner,
+                             const ompl::geometric::SimpleSetupPtr& ss,
+                             const FieldFunctions&) {
+           ompl::base::SpaceInformationPtr si = ss->getSpaceInformation();
+           ROS_INFO_NAMED(LOGNAME, "createPandaBundleContext()");
+           planner.createPandaBundleContext();
+
+           std::vector<ompl::base::SpaceInformationPtr> siVec;
+           std::vector<ompl::multilevel::ProjectionPtr> projVec;
+           planner.getBundleSpaces(si, siVec, projVec);
+
+           planner.optimization_objective_ = contact_objective(planner, si);
+           ss->setOptimizationObjective(planner.optimization_objective_);
+
+           ROS_INFO_NAMED(LOGNAME, "ompl::multilevel::QRRTStar(siVec, projVec)");
+           return std::make_shared<ompl::multilevel::QRRTStar>(siVec, projVec);
+         },
+         default_field});
+
+    r.addPlanner(
+        "CAT-TRRT",
+        {[](PerceptionPlanner& planner,
+            const ompl::geometric::SimpleSetupPtr& ss, const FieldFunctions&) {
+           ompl::base::SpaceInformationPtr si = ss->getSpaceInformation();
+           // vFieldFuncDuo = std::bind(&PerceptionPlanner::obstacleFieldDuo,
+           //                           this, std::placeholders::_1,
+           //                           std::placeholders::_2);
+           std::function<Eigen::VectorXd(const ompl::base::State*,
+                                         const ompl::base::State*)>
+               vFieldFuncDuo =
+                   std::bind(&PerceptionPlanner::obstacleFieldCartesian,
+                             &planner, std::placeholders::_1,
+                             std::placeholders::_2);
+
+           std::function<Eigen::VectorXd(const ompl::base::State*)> vFieldFunc =
+               std::bind(&PerceptionPlanner::obstacleField, &planner,
+                         std::placeholders::_1);
+
+           planner.optimization_objective_ = std::make_shared<
+               ompl::base::VFUpstreamCriterionOptimizationObjective>(
+               si, vFieldFunc);
+
+           // optimization_objective_ =
+           //     std::make_shared<ompl::base::VFMagnitudeOptimizationObjective>(
+           //         si, vFieldFunc);
+
+           ss->setOptimizationObjective(planner.optimization_objective_);
+           return std::make_shared<ompl::geometric::ContactTRRT>(si,
+                                                                 vFieldFuncDuo);
+         },
+         default_field});
+
+    r.addPlanner("RRTConnect",
+                 {[](PerceptionPlanner&,
+                     const ompl::geometric::SimpleSetupPtr& ss,
+                     const FieldFunctions&) {
+                    return std::make_shared<ompl::geometric::RRTConnect>(
+                        ss->getSpaceInformation());
+                  },
+                  default_field});
+
+    return r;
+  }();
+  return registry;
+}
+
 void PerceptionPlanner::changePlanner() {
   ROS_INFO_NAMED(LOGNAME, "changePlanner()");
   ompl::geometric::SimpleSetupPtr simple_setup = context_->getOMPLSimpleSetup();
-  ompl::base::SpaceInformationPtr si = simple_setup->getSpaceInformation();
-  ompl::base::PlannerPtr planner;
-
-  ompl::geometric::PathSimplifierPtr simplifier =
-      simple_setup->getPathSimplifier();
 
-  std::function<Eigen::VectorXd(const ompl::base::State*,
-                                const ompl::base::State*)>
-      vFieldFuncDuo;
-
-  if (planner_name_ == "BITstar") {
-    std::function<double(const ompl::base::State*)> optFunc;
-
-    optFunc = std::bind(&PerceptionPlanner::overlapMagnitude, this,
-                        std::placeholders::_1);
-    optimization_objective_ =
-        std::make_shared<ompl::base::MinimizeContactObjective>(si, optFunc);
-
-    // simple_setup->setOptimizationObjective(optimization_objective_);
-
-    simple_setup->setOptimizationObjective(
-        std::make_shared<ompl::base::PathLengthOptimizationObjective>(si));
-
-    planner = std::make_shared<ompl::geometric::BITstar>(si);
-
-  } else if (planner_name_ == "RRTstar") {
-    std::function<double(const ompl::base::State*)> optFunc;
-
-    optFunc = std::bind(&PerceptionPlanner::overlapMagnitude, this,
-                        std::placeholders::_1);
-    optimization_objective_ =
-        std::make_shared<ompl::base::MinimizeContactObjective>(si, optFunc);
-    simple_setup->setOptimizationObjective(optimization_objective_);
-
-    planner = std::make_shared<ompl::geometric::RRTstar>(si);
-
-  } else if (planner_name_ == "QRRTStar") {
-    ROS_INFO_NAMED(LOGNAME, "createPandaBundleContext()");
-    createPandaBundleContext();
-
-    ROS_INFO_NAMED(LOGNAME, "setting siVec");
-    std::vector<ompl::base::SpaceInformationPtr> siVec;
-    ompl::base::SpaceInformationPtr BaseSi =
-        pandaBundleContext_->getPlanningContext()
-            ->getOMPLSimpleSetup()
-            ->getSpaceInformation();
-    ompl::base::SpaceInformationPtr BundleSi = si;
-    siVec.emplace_back(BaseSi);
-    siVec.emplace_back(BundleSi);
-
-    ROS_INFO_NAMED(LOGNAME, "setting projVec");
-    std::vector<ompl::multilevel::ProjectionPtr> projVec;
-    ompl::base::StateSpacePtr BaseSpace =
-        pandaBundleContext_->getPlanningContext()
-            ->getOMPLSimpleSetup()
-            ->getStateSpace();
-    ompl::base::StateSpacePtr BundleSpace = simple_setup->getStateSpace();
-    ompl::multilevel::ProjectionPtr projection =
-        std::make_shared<ompl::multilevel::Projection_ModelBased_RN_RM>(
-            BundleSpace, BaseSpace);
-    ROS_INFO_NAMED(LOGNAME, "FiberedProjection");
-    auto componentFiber =
-        std::dynamic_pointer_cast<ompl::multilevel::FiberedProjection>(
-            projection);
-    ROS_INFO_NAMED(LOGNAME, "makeFiberSpace()");
-    componentFiber->makeFiberSpace();
-    projVec.emplace_back(projection);
-
-    std::function<double(const ompl::base::State*)> optFunc;
-    optFunc = std::bind(&PerceptionPlanner::overlapMagnitude, this,
-                        std::placeholders::_1);
-    optimization_objective_ =
-        std::make_shared<ompl::base::MinimizeContactObjective>(si, optFunc);
-    simple_setup->setOptimizationObjective(optimization_objective_);
-
-    ROS_INFO_NAMED(LOGNAME, "ompl::multilevel::QRRTStar(siVec, projVec)");
-    planner = std::make_shared<ompl::multilevel::QRRTStar>(siVec, projVec);
-
-  } else if (planner_name_ == "CAT-TRRT") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: CAT-TRRT.");
-    std::function<Eigen::VectorXd(const ompl::base::State*,
-                                  const ompl::base::State*)>
-        vFieldFuncDuo;
-
-    // vFieldFuncDuo = std::bind(&PerceptionPlanner::obstacleFieldDuo, this,
-    //                           std::placeholders::_1, std::placeholders::_2);
-    vFieldFuncDuo = std::bind(&PerceptionPlanner::obstacleFieldCartesian, this,
-                              std::placeholders::_1, std::placeholders::_2);
-
-    std::function<Eigen::VectorXd(const ompl::base::State*)> vFieldFunc;
-    vFieldFunc = std::bind(&PerceptionPlanner::obstacleField, this,
-                           std::placeholders::_1);
-
-    optimization_objective_ =
-        std::make_shared<ompl::base::VFUpstreamCriterionOptimizationObjective>(
-            si, vFieldFunc);
-
-    // optimization_objective_ =
-    //     std::make_shared<ompl::base::VFMagnitudeOptimizationObjective>(
-    //         si, vFieldFunc);
-
-    simple_setup->setOptimizationObjective(optimization_objective_);
-    planner = std::make_shared<ompl::geometric::ContactTRRT>(si, vFieldFuncDuo);
-
-  } else if (planner_name_ == "RRTConnect") {
-    ROS_INFO_NAMED(LOGNAME, "Using planner: RRTConnect.");
-    planner = std::make_shared<ompl::geometric::RRTConnect>(si);
-  } else {
+  const auto* planner_entry = registry().findPlanner(planner_name_);
+  if (!planner_entry) {
     ROS_ERROR_NAMED(LOGNAME, "The following planner is not supported: %s",
                     planner_name_.c_str());
     throw std::invalid_argument(planner_name_);
   }
+  ROS_INFO_NAMED(LOGNAME, "Using planner: %s.", planner_name_.c_str());
+  field_engine_.setFieldParams(planner_entry->field_params);
+  contact_cost_grid_.clear();
+  contact_field_grid_.clear();
+  setStateSampler(simple_setup);
 
   // optimization_objective_->setCostToGoHeuristic(
   //     &ompl::base::goalRegionCostToGo);
-  simple_setup->setPlanner(planner);
-}
-
-void PerceptionPlanner::extractPtsFromModel(
-    const moveit::core::RobotStatePtr& robot_state,
-    const moveit::core::LinkModel* link_model,
-    std::vector<Eigen::Vector3d>& link_pts, std::size_t& num_pts) {
-  std::vector<shapes::ShapeConstPtr> shapes = link_model->getShapes();
-  std::size_t num_shapes = shapes.size();
-  for (std::size_t j = 0; j < num_shapes; ++j) {
-    Eigen::Isometry3d transform =
-        robot_state->getCollisionBodyTransform(link_model, j);
-
-    if (shapes[j]->type != shapes::MESH) {
-      // should somehow extract points from this as well
-      // ROS_ERROR_NAMED(LOGNAME, "Not a mesh shape");
-    } else {
-      shapes::Mesh* mesh = static_cast<shapes::Mesh*>(shapes[j]->clone());
-      mesh->mergeVertices(0.05);
-      // std::vector<Eigen::Vector3d> points(mesh->vertex_count);
-
-      // std::vector<Eigen::Vector3d> points(mesh->vertex_count);
-
-      for (unsigned int k = 0; k < mesh->vertex_count; ++k) {
-        Eigen::Vector3d mesh_pt(mesh->vertices[3 * k],
-                                mesh->vertices[3 * k + 1],
-                                mesh->vertices[3 * k + 2]);
-        // points[k] = transform * mesh_pt;
-        link_pts.emplace_back(transform * mesh_pt);
-        num_pts++;
-      }
-
-      // for (std::size_t p = 0; p < mesh->triangle_count; ++p) {
-      //   std::size_t i3 = p * 3;
-      //   Eigen::Vector3d s1(mesh->vertices[mesh->triangles[i3] * 3],
-      //                      mesh->vertices[mesh->triangles[i3] * 3 + 1],
-      //                      mesh->vertices[mesh->triangles[i3] * 3 + 2]);
-
-      //   Eigen::Vector3d s2(mesh->vertices[mesh->triangles[i3 + 1] * 3],
-      //                      mesh->vertices[mesh->triangles[i3 + 1] * 3 + 1],
-      //                      mesh->vertices[mesh->triangles[i3 + 1] * 3 +
-      //                      2]);
-
-      //   Eigen::Vector3d s3(mesh->vertices[mesh->triangles[i3 + 2] * 3],
-      //                      mesh->vertices[mesh->triangles[i3 + 2] * 3 + 1],
-      //                      mesh->vertices[mesh->triangles[i3 + 2] * 3 +
-      //                      2]);
-      //   points.emplace_back(transform * ((s1 + s2) / 2));
-      //   points.emplace_back(transform * ((s2 + s3) / 2));
-      //   points.emplace_back(transform * ((s3 + s1) / 2));
-      //   num_pts = num_pts + 3;
-      // }
-    }
-  }
+  simple_setup->setPlanner(
+      planner_entry->create(*this, simple_setup, FieldFunctions()));
 }
 
 std::size_t PerceptionPlanner::getPtsOnRobotSurface(
     const moveit::core::RobotStatePtr& robot_state,
-    std::vector<std::vector<Eigen::Vector3d>>& rob_pts) {
-  const std::vector<std::string> link_names =
-      joint_model_group_->getLinkModelNames();
-
-  rob_pts.clear();
-  std::size_t num_links = link_names.size();
-  std::size_t num_pts = 0;
-  // std::cout << "num_links " << num_links << std::endl;
-
-  for (std::size_t i = 0; i < num_links; i++) {
-    // std::cout << "i: " << i << ", " << link_names[i] << std::endl;
-
-    const moveit::core::LinkModel* link_model =
-        robot_state->getLinkModel(link_names[i]);
-
-    const moveit::core::LinkTransformMap fixed_links =
-        link_model->getAssociatedFixedTransforms();
-
-    // std::cout << "link_tf_map.size(): " << link_tf_map.size() << std::endl;
-
-    std::vector<shapes::ShapeConstPtr> shapes = link_model->getShapes();
-    std::size_t num_shapes = shapes.size();
-
-    std::vector<Eigen::Vector3d> link_pts;
-
-    // the last link does not have a mesh for some reason
-    if (i >= dof_ - 1 || (num_shapes == 0 && fixed_links.size() > 0)) {
-      // std::cout << "i: " << i << ", " << link_names[i] << std::endl;
-      for (const std::pair<const moveit::core::LinkModel* const,
-                           Eigen::Isometry3d>& fixed_link : fixed_links) {
-        extractPtsFromModel(robot_state, fixed_link.first, link_pts, num_pts);
-      }
-
-      if (i == num_links - 1) {
-        // std::cout << "i: " << i << ", " << link_names[i] << std::endl;
-        rob_pts.emplace_back(link_pts);
-      }
-      continue;
-    }
-
-    extractPtsFromModel(robot_state, link_model, link_pts, num_pts);
-    rob_pts.emplace_back(link_pts);
-  }
-  // std::cout << "rob_pts.size() " << rob_pts.size() << std::endl;
-  return num_pts;
+    std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+    std::vector<BoundingSphere>& link_spheres) {
+  // The engine reads the link transforms of a const state.
+  robot_state->update();
+  return field_engine_.getPtsOnRobotSurface(*robot_state, joint_model_group_,
+                                            dof_, rob_pts, link_spheres);
 }
 
 Eigen::VectorXd PerceptionPlanner::getRobtPtsVecDiffAvg(
     const std::vector<std::vector<Eigen::Vector3d>>& near_state_rob_pts,
     const std::vector<std::vector<Eigen::Vector3d>>& rand_state_rob_pts,
     const std::vector<Eigen::Vector3d>& link_to_obs_vec) {
+  const bool record_vis = vis_data_->isRecording(sample_state_count_);
   std::size_t num_links = near_state_rob_pts.size();
   Eigen::VectorXd mean_per_link = Eigen::VectorXd::Zero(num_links);
 
@@ -372,7 +317,10 @@ Eigen::VectorXd PerceptionPlanner::getRobtPtsVecDiffAvg(
     std::vector<Eigen::Vector3d> near_pts_on_link = near_state_rob_pts[i];
     std::vector<Eigen::Vector3d> rand_pts_on_link = rand_state_rob_pts[i];
 
-    std::size_t num_pts_on_link = near_pts_on_link.size();
+    // The two states may have placed the link at different levels of detail,
+    // the shorter prefix is the set of points they have in common.
+    std::size_t num_pts_on_link =
+        std::min(near_pts_on_link.size(), rand_pts_on_link.size());
     Eigen::MatrixXd diff_per_link = Eigen::MatrixXd::Zero(num_pts_on_link, 3);
 
     for (std::size_t j = 0; j < num_pts_on_link; j++) {
@@ -390,8 +338,10 @@ Eigen::VectorXd PerceptionPlanner::getRobtPtsVecDiffAvg(
       // std::cout << "sample_state_count_: " << sample_state_count_ <<
       // std::endl;
 
-      vis_data_->saveNearRandVec(near_pt_on_rob, nearrand_diff, pt_num,
-                                 sample_state_count_);
+      if (record_vis) {
+        vis_data_->saveNearRandVec(near_pt_on_rob, nearrand_diff, pt_num,
+                                   sample_state_count_);
+      }
 
       pt_num++;
     }
@@ -410,7 +360,9 @@ Eigen::VectorXd PerceptionPlanner::getRobtPtsVecDiffAvg(
 
     mean_per_link[i] = dot;
   }
-  vis_data_->saveNearRandDot(mean_per_link);
+  if (record_vis) {
+    vis_data_->saveNearRandDot(mean_per_link);
+  }
   return mean_per_link;
 }
 
@@ -424,11 +376,14 @@ Eigen::VectorXd PerceptionPlanner::obstacleFieldCartesian(
       std::make_shared<moveit::core::RobotState>(*robot_state_);
   robot_state1->setJointGroupPositions(joint_model_group_, joint_angles1);
   std::vector<std::vector<Eigen::Vector3d>> near_rob_pts;
-  std::size_t num_pts = getPtsOnRobotSurface(robot_state1, near_rob_pts);
+  std::vector<BoundingSphere> near_link_spheres;
+  std::size_t num_pts =
+      getPtsOnRobotSurface(robot_state1, near_rob_pts, near_link_spheres);
 
   // vis_data_->setTotalNumRepulsePts(num_pts);
   // std::cout << "num pts from near state: " << num_pts << std::endl;
-  std::vector<Eigen::Vector3d> link_to_obs_vec = getLinkToObsVec(near_rob_pts);
+  std::vector<Eigen::Vector3d> link_to_obs_vec =
+      getLinkToObsVec(near_rob_pts, near_link_spheres);
   // std::cout << "link_to_obs_vec.size(): " << link_to_obs_vec.size()
   //           << std::endl;
 
@@ -440,7 +395,8 @@ Eigen::VectorXd PerceptionPlanner::obstacleFieldCartesian(
       std::make_shared<moveit::core::RobotState>(*robot_state_);
   robot_state2->setJointGroupPositions(joint_model_group_, joint_angles2);
   std::vector<std::vector<Eigen::Vector3d>> rand_rob_pts;
-  num_pts = getPtsOnRobotSurface(robot_state2, rand_rob_pts);
+  std::vector<BoundingSphere> rand_link_spheres;
+  num_pts = getPtsOnRobotSurface(robot_state2, rand_rob_pts, rand_link_spheres);
   // std::cout << "num pts from rand state: " << num_pts << std::endl;
 
   Eigen::VectorXd vfield =
@@ -459,65 +415,38 @@ Eigen::Vector3d PerceptionPlanner::getAttractPt(std::size_t link_num,
 }
 
 Eigen::Vector3d PerceptionPlanner::scaleToDist(Eigen::Vector3d vec) {
-  double y_max = 3.0;
-  double D = 50.0;
-  // double dist_max = 1.0;
-  // std::cout << "vec.norm() " << vec.norm() << std::endl;
-  Eigen::Vector3d vec_out = Eigen::VectorXd::Zero(3);
-
-  // double norm = vec.norm();
-  // double norm_max = 0.1;
-  // if (norm < norm_max) {
-  //   vec_out[0] = 1;
-  //   vec_out[1] = 1;
-  //   vec_out[2] = 1;
-  // } else {
-  //   vec_out[0] = 0;
-  //   vec_out[1] = 0;
-  //   vec_out[2] = 0;
-  // }
-
-  double prox_radius = 0.02;
-  if (planner_name_ == "ContactTRRTDuo" || planner_name_ == "VFRRT") {
-    prox_radius = 0.2;
-  }
-
-  if (vec.squaredNorm() > prox_radius) {
-    return vec_out;
-  }
-
-  if (planner_name_ != "ContactTRRTDuo") {
-    vec.normalize();
-    return vec;
-  }
-
-  vec_out = (vec * y_max) / (D * vec.squaredNorm() + 1.0);
-
-  // std::cout << "vec.squaredNorm() " << vec.squaredNorm() << std::endl;
-  // std::cout << "before scale " << vec.transpose() << std::endl;
-  // std::cout << "vec_out " << vec_out.transpose() << std::endl;
-  return vec_out;
+  return field_engine_.getFieldParams().scale(vec);
 }
 
 std::vector<Eigen::Vector3d> PerceptionPlanner::getObstacles(
     const Eigen::Vector3d& pt_on_rob) {
+  const bool record_vis = vis_data_->isRecording(sample_state_count_);
   std::vector<Eigen::Vector3d> obstacles;
   if (use_sim_obstacles_) {
-    vis_data_->saveObstaclePos(sim_obstacle_pos_, sample_state_count_);
+    if (record_vis) {
+      vis_data_->saveObstaclePos(sim_obstacle_pos_, sample_state_count_);
+    }
     return sim_obstacle_pos_;
   }
 
-  bool status = contact_perception_->extractNearPts(pt_on_rob, obstacles);
+  // Without perception, e.g. in headless mode, the obstacles are only in the
+  // planning scene and there is no point cloud to search.
+  bool status = contact_perception_ &&
+                contact_perception_->extractNearPts(pt_on_rob, obstacles);
   if (status) {
-    vis_data_->saveObstaclePos(obstacles, sample_state_count_);
+    if (record_vis) {
+      vis_data_->saveObstaclePos(obstacles, sample_state_count_);
+    }
     return obstacles;
   }
 
   // Store an empty obstacle vector when no obstacles have been found in
   // proximity. This ensures that the size of the stored obstacles in an array
   // are equal to the number of states that we considered.
-  vis_data_->saveObstaclePos(std::vector<Eigen::Vector3d>{},
-                             sample_state_count_);
+  if (record_vis) {
+    vis_data_->saveObstaclePos(std::vector<Eigen::Vector3d>{},
+                               sample_state_count_);
+  }
 
   // This yields a zero repulsion vector and will mean no repulsion will be
   // applied by the vectors filed.
@@ -527,8 +456,11 @@ std::vector<Eigen::Vector3d> PerceptionPlanner::getObstacles(
 }
 
 std::vector<Eigen::Vector3d> PerceptionPlanner::getLinkToObsVec(
-    const std::vector<std::vector<Eigen::Vector3d>>& rob_pts) {
+    const std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+    const std::vector<BoundingSphere>& link_spheres) {
+  const bool record_vis = vis_data_->isRecording(sample_state_count_);
   std::size_t num_links = rob_pts.size();
+  const bool goal_attractor = field_engine_.getFieldParams().use_goal_attractor;
 
   std::vector<Eigen::Vector3d> link_to_obs_vec(num_links,
                                                Eigen::Vector3d::Zero(3));
@@ -536,15 +468,27 @@ std::vector<Eigen::Vector3d> PerceptionPlanner::getLinkToObsVec(
   std::size_t pt_num = 0;
 
   for (std::size_t i = 0; i < num_links; i++) {
-    std::vector<Eigen::Vector3d> pts_on_link = rob_pts[i];
+    const std::vector<Eigen::Vector3d>& pts_on_link = rob_pts[i];
     std::size_t num_pts_on_link = pts_on_link.size();
+    if (num_pts_on_link == 0) {
+      continue;
+    }
     // std::cout << "link_num: " << i << std::endl;
     // std::cout << "num_pts_on_link: " << num_pts_on_link << std::endl;
 
     Eigen::MatrixXd pts_link_vec = Eigen::MatrixXd::Zero(num_pts_on_link, 3);
 
     // std::cout << "getObstacles: " << std::endl;
-    std::vector<Eigen::Vector3d> obstacle_pos = getObstacles(pts_on_link[0]);
+    std::vector<Eigen::Vector3d> obstacle_pos =
+        getObstacles(pts_on_link[0]);
+
+    // A link whose bounding sphere is out of reach of every obstacle is not
+    // repelled, so its points are not visited.
+    if (use_sim_obstacles_ && i < link_spheres.size() &&
+        !field_engine_.isObstacleNear(link_spheres[i])) {
+      pt_num += num_pts_on_link;
+      continue;
+    }
 
     for (std::size_t j = 0; j < num_pts_on_link; j++) {
       // std::cout << "pt j: " << j << std::endl;
@@ -568,7 +512,7 @@ std::vector<Eigen::Vector3d> PerceptionPlanner::getLinkToObsVec(
         vec = scaleToDist(vec);
         // std::cout << "vec: " << vec.transpose() << std::endl;
 
-        if (planner_name_ == "ContactTRRTDuo") {
+        if (goal_attractor) {
           Eigen::Vector3d att_pt = getAttractPt(i, j);
 
           Eigen::Vector3d att_vec = att_pt - pt_on_rob;
@@ -610,8 +554,10 @@ std::vector<Eigen::Vector3d> PerceptionPlanner::getLinkToObsVec(
 
       // std::cout << "saveOriginVec: " << std::endl;
 
-      vis_data_->saveOriginVec(pt_on_rob, pt_to_obs_av, pt_num,
-                               sample_state_count_);
+      if (record_vis) {
+        vis_data_->saveOriginVec(pt_on_rob, pt_to_obs_av, pt_num,
+                                 sample_state_count_);
+      }
       pt_num++;
     }
     // std::cout << "pts_link_vec.rows(): " << pts_link_vec.rows() << std::endl;
@@ -624,7 +570,9 @@ std::vector<Eigen::Vector3d> PerceptionPlanner::getLinkToObsVec(
 
     link_to_obs_vec[i] = link_to_obs_avg;
   }
-  vis_data_->saveAvgRepulseVec(link_to_obs_vec);
+  if (record_vis) {
+    vis_data_->saveAvgRepulseVec(link_to_obs_vec);
+  }
 
   return link_to_obs_vec;
 }
@@ -637,67 +585,93 @@ Eigen::VectorXd PerceptionPlanner::obstacleFieldDuo(
 
 Eigen::VectorXd PerceptionPlanner::obstacleField(
     const ompl::base::State* rand_state) {
-  sphericalCollisionPermission(false);
   const ompl::base::RealVectorStateSpace::StateType& vec_state =
       *rand_state->as<ompl::base::RealVectorStateSpace::StateType>();
   std::vector<double> joint_angles = utilities::toStlVec(vec_state, dof_);
-  moveit::core::RobotState robot_state(*robot_state_);
-  robot_state.setJointGroupPositions(joint_model_group_, joint_angles);
-  Eigen::VectorXd vfield = getPerLinkContactDepth(robot_state);
-  sphericalCollisionPermission(true);
+
+  auto evaluate = [this](const std::vector<double>& q) {
+    moveit::core::RobotState robot_state(*robot_state_);
+    robot_state.setJointGroupPositions(joint_model_group_, q);
+    return getPerLinkContactDepth(robot_state);
+  };
+
+  Eigen::VectorXd vfield;
+  if (use_field_grid_) {
+    contact_field_grid_.setSceneVersion(scene_version_);
+    if (contact_field_grid_.interpolate(joint_angles, evaluate, vfield)) {
+      return vfield;
+    }
+  }
+  vfield = evaluate(joint_angles);
   return vfield;
 }
 
 double PerceptionPlanner::overlapMagnitude(const ompl::base::State* state) {
-  sphericalCollisionPermission(false);
-
   const ompl::base::RealVectorStateSpace::StateType& vec_state =
       *state->as<ompl::base::RealVectorStateSpace::StateType>();
   std::vector<double> joint_angles = utilities::toStlVec(vec_state, dof_);
-  moveit::core::RobotState robot_state(*robot_state_);
-  robot_state.setJointGroupPositions(joint_model_group_, joint_angles);
-  double cost = getContactDepth(robot_state);
 
-  sphericalCollisionPermission(true);
-  return cost;
+  auto evaluate = [this](const std::vector<double>& q) {
+    moveit::core::RobotState robot_state(*robot_state_);
+    robot_state.setJointGroupPositions(joint_model_group_, q);
+    Eigen::VectorXd cost(1);
+    cost[0] = getContactDepth(robot_state);
+    return cost;
+  };
+
+  Eigen::VectorXd cost;
+  if (use_field_grid_) {
+    contact_cost_grid_.setSceneVersion(scene_version_);
+    if (contact_cost_grid_.interpolate(joint_angles, evaluate, cost)) {
+      return cost[0];
+    }
+  }
+  cost = evaluate(joint_angles);
+  return cost[0];
 }
 
 void PerceptionPlanner::sphericalCollisionPermission(bool is_allowed) {
   // collision_detection::CollisionEnvConstPtr col_env =
   //     planning_scene_monitor::LockedPlanningSceneRW(psm_)->getCollisionEnv();
-  collision_detection::AllowedCollisionMatrix& acm =
-      planning_scene_monitor::LockedPlanningSceneRW(psm_)
-          ->getAllowedCollisionMatrixNonConst();
-
-  std::vector<std::string> sphere_names;
-  for (auto obstacle : obstacles_) {
-    sphere_names.emplace_back(obstacle.name);
+  {
+    PlanningSceneHandle::WriteLock scene = scene_handle_.write();
+    collision_detection::AllowedCollisionMatrix& acm =
+        scene->getAllowedCollisionMatrixNonConst();
+    for (const auto& obstacle : obstacles_) {
+      acm.setEntry(obstacle.name, is_allowed);
+    }
   }
+  updateContactAcm();
+}
 
-  for (auto name : sphere_names) {
-    acm.setEntry(name, is_allowed);
+void PerceptionPlanner::tableCollisionPermission() {
+  {
+    PlanningSceneHandle::WriteLock scene = scene_handle_.write();
+    collision_detection::AllowedCollisionMatrix& acm =
+        scene->getAllowedCollisionMatrixNonConst();
+    std::string name = "table";
+    std::vector<std::string> other_names{"panda_link0"};
+    acm.setEntry(name, other_names, true);
   }
+  updateContactAcm();
 }
 
-void PerceptionPlanner::tableCollisionPermission() {
-  collision_detection::AllowedCollisionMatrix& acm =
-      planning_scene_monitor::LockedPlanningSceneRW(psm_)
-          ->getAllowedCollisionMatrixNonConst();
-  std::string name = "table";
-  std::vector<std::string> other_names{"panda_link0"};
-  acm.setEntry(name, other_names, true);
+void PerceptionPlanner::updateContactAcm() {
+  contact_acm_ = scene_handle_.read()->getAllowedCollisionMatrix();
+  for (const auto& obstacle : obstacles_) {
+    contact_acm_.setEntry(obstacle.name, false);
+  }
+  scene_version_++;
 }
 
 void PerceptionPlanner::setCollisionChecker(
     std::string collision_checker_name) {
-  planning_scene_monitor::LockedPlanningSceneRW(psm_)->addCollisionDetector(
+  scene_handle_.write()->addCollisionDetector(
       collision_detection::CollisionDetectorAllocatorBullet::create());
-  planning_scene_monitor::LockedPlanningSceneRW(psm_)
-      ->setActiveCollisionDetector(collision_checker_name);
+  scene_handle_.write()->setActiveCollisionDetector(collision_checker_name);
 
   const std::string active_col_det =
-      planning_scene_monitor::LockedPlanningSceneRO(psm_)
-          ->getActiveCollisionDetectorName();
+      scene_handle_.read()->getActiveCollisionDetectorName();
   ROS_INFO_NAMED(LOGNAME, "ActiveCollisionDetectorName: %s",
                  active_col_det.c_str());
 
@@ -722,8 +696,8 @@ Eigen::VectorXd PerceptionPlanner::getPerLinkContactDepth(
   collision_request.verbose = false;
 
   collision_detection::CollisionResult collision_result;
-  planning_scene_monitor::LockedPlanningSceneRO(psm_)->checkCollisionUnpadded(
-      collision_request, collision_result, robot_state);
+  scene_handle_.read()->checkCollisionUnpadded(
+      collision_request, collision_result, robot_state, contact_acm_);
 
   bool collision = collision_result.collision;
   // ROS_INFO_NAMED(LOGNAME, "collision: %d", collision);
@@ -772,8 +746,8 @@ double PerceptionPlanner::getContactDepth(
   collision_request.verbose = false;
 
   collision_detection::CollisionResult collision_result;
-  planning_scene_monitor::LockedPlanningSceneRO(psm_)->checkCollisionUnpadded(
-      collision_request, collision_result, robot_state);
+  scene_handle_.read()->checkCollisionUnpadded(
+      collision_request, collision_result, robot_state, contact_acm_);
 
   bool collision = collision_result.collision;
   // ROS_INFO_NAMED(LOGNAME, "collision: %d", collision);
@@ -835,61 +809,100 @@ bool PerceptionPlanner::findObstacleByName(const std::string& name,
   }
 }
 
-void PerceptionPlanner::createPandaBundleContext() {
-  robot_model_loader::RobotModelLoaderPtr robot_model_loader;
-  robot_model_loader = std::make_shared<robot_model_loader::RobotModelLoader>(
-      "robot_description_5link");
-  moveit::core::RobotModelPtr robot_model = robot_model_loader->getModel();
-  const moveit::core::JointModelGroup* joint_model_group =
-      robot_model->getJointModelGroup(getGroupName());
-  planning_scene_monitor::PlanningSceneMonitorPtr psm;
-  psm = std::make_shared<planning_scene_monitor::PlanningSceneMonitor>(
-      robot_model_loader);
-  psm->publishDebugInformation(true);
-  psm->startWorldGeometryMonitor(planning_scene_monitor::PlanningSceneMonitor::
-                                     DEFAULT_COLLISION_OBJECT_TOPIC,
-                                 planning_scene_monitor::PlanningSceneMonitor::
-                                     DEFAULT_PLANNING_SCENE_WORLD_TOPIC,
-                                 false /* skip octomap monitor */);
-
-  pandaBundleContext_ = std::make_shared<MyMoveitContext>(psm, robot_model);
-  moveit::core::RobotStatePtr ready_state(new moveit::core::RobotState(
-      planning_scene_monitor::LockedPlanningSceneRO(psm)->getCurrentState()));
-  ready_state->setToDefaultValues(joint_model_group, "ready");
-  psm->updateSceneWithCurrentState();
+void PerceptionPlanner::setBundleHierarchy(
+    const std::vector<std::size_t>& bundle_dofs) {
+  for (std::size_t i = 0; i < bundle_dofs.size(); i++) {
+    if (bundle_dofs[i] == 0 || (dof_ > 0 && bundle_dofs[i] >= dof_) ||
+        (i > 0 && bundle_dofs[i] <= bundle_dofs[i - 1])) {
+      ROS_ERROR_NAMED(LOGNAME, "Invalid bundle hierarchy at level %zu.", i);
+      throw std::invalid_argument("bundle_dofs");
+    }
+  }
+
+  // levels that are still part of the hierarchy keep their loaders and
+  // monitors, their projections are rebuilt as the level above may differ
+  std::vector<BundleLevel> levels;
+  for (std::size_t dof : bundle_dofs) {
+    auto it = std::find_if(
+        bundle_levels_.begin(), bundle_levels_.end(),
+        [dof](const BundleLevel& level) { return level.dof == dof; });
+    if (it == bundle_levels_.end()) {
+      continue;
+    }
+    it->projection.reset();
+    it->bundle_space.reset();
+    it->base_space.reset();
+    levels.push_back(std::move(*it));
+  }
+  bundle_levels_ = std::move(levels);
+  bundle_dofs_ = bundle_dofs;
+}
+
+PerceptionPlanner::BundleLevel PerceptionPlanner::loadBundleLevel(
+    std::size_t dof) {
+  BundleLevel level;
+  level.dof = dof;
+  std::string description = "robot_description_" + std::to_string(dof) + "link";
+  ROS_INFO_NAMED(LOGNAME, "Loading bundle level %s.", description.c_str());
+  level.robot_model_loader =
+      std::make_shared<robot_model_loader::RobotModelLoader>(description);
+  moveit::core::RobotModelPtr robot_model =
+      level.robot_model_loader->getModel();
+  if (!robot_model) {
+    ROS_ERROR_NAMED(LOGNAME, "Could not load %s.", description.c_str());
+    throw std::runtime_error(description);
+  }
+  level.joint_model_group = robot_model->getJointModelGroup(getGroupName());
+
+  level.psm = std::make_shared<planning_scene_monitor::PlanningSceneMonitor>(
+      level.robot_model_loader);
+  level.psm->publishDebugInformation(true);
+  level.psm->startWorldGeometryMonitor(
+      planning_scene_monitor::PlanningSceneMonitor::
+          DEFAULT_COLLISION_OBJECT_TOPIC,
+      planning_scene_monitor::PlanningSceneMonitor::
+          DEFAULT_PLANNING_SCENE_WORLD_TOPIC,
+      false /* skip octomap monitor */);
+  level.psm->updateSceneWithCurrentState();
+
+  level.context = std::make_shared<MyMoveitContext>(level.psm, robot_model);
+  return level;
+}
 
+planning_interface::MotionPlanRequest PerceptionPlanner::createBundleRequest(
+    const BundleLevel& level) {
   planning_interface::MotionPlanRequest base_req;
   planning_interface::MotionPlanRequest bundle_req =
       context_->getMotionPlanRequest();
+  const std::size_t dof = level.dof;
 
   // setting start state
   base_req.start_state.joint_state.header.stamp = ros::Time::now();
-  base_req.start_state.joint_state.name = joint_model_group->getVariableNames();
+  base_req.start_state.joint_state.name =
+      level.joint_model_group->getVariableNames();
   sensor_msgs::JointState bundle_state = bundle_req.start_state.joint_state;
-  assert(bundle_state.position.size() >= 5);
-  std::vector<double> start_joint_values{
-      bundle_state.position[0], bundle_state.position[1],
-      bundle_state.position[2], bundle_state.position[3],
-      bundle_state.position[4]};
+  assert(bundle_state.position.size() >= dof);
+  std::vector<double> start_joint_values(bundle_state.position.begin(),
+                                         bundle_state.position.begin() + dof);
   base_req.start_state.joint_state.position = start_joint_values;
   std::fill(std::begin(start_joint_values), std::end(start_joint_values), 0);
   base_req.start_state.joint_state.velocity = start_joint_values;
   base_req.start_state.joint_state.effort = start_joint_values;
 
   // setting goal state
-  moveit::core::RobotStatePtr robot_state(new moveit::core::RobotState(
-      planning_scene_monitor::LockedPlanningSceneRO(psm)->getCurrentState()));
-  moveit::core::RobotState goal_state(*robot_state);
+  moveit::core::RobotState goal_state(
+      planning_scene_monitor::LockedPlanningSceneRO(level.psm)
+          ->getCurrentState());
 
   // the QRRT planner will do this internally
-  assert(joint_goal_pos_.size() >= 5);
+  assert(joint_goal_pos_.size() >= dof);
   std::vector<double> joint_goal_pos =
-      tacbot::utilities::slice(joint_goal_pos_, 0, 4);
-  goal_state.setJointGroupPositions(joint_model_group, joint_goal_pos);
+      tacbot::utilities::slice(joint_goal_pos_, 0, dof - 1);
+  goal_state.setJointGroupPositions(level.joint_model_group, joint_goal_pos);
   double tolerance = 0.001;
   moveit_msgs::Constraints joint_goal =
       kinematic_constraints::constructGoalConstraints(
-          goal_state, joint_model_group, tolerance);
+          goal_state, level.joint_model_group, tolerance);
   base_req.goal_constraints.push_back(joint_goal);
 
   // setting planning params
@@ -899,8 +912,71 @@ void PerceptionPlanner::createPandaBundleContext() {
   base_req.max_acceleration_scaling_factor =
       bundle_req.max_acceleration_scaling_factor;
   base_req.max_velocity_scaling_factor = bundle_req.max_velocity_scaling_factor;
+  return base_req;
+}
+
+void PerceptionPlanner::createPandaBundleContext() {
+  if (bundle_levels_.size() != bundle_dofs_.size()) {
+    std::vector<BundleLevel> levels;
+    for (std::size_t dof : bundle_dofs_) {
+      auto it = std::find_if(
+          bundle_levels_.begin(), bundle_levels_.end(),
+          [dof](const BundleLevel& level) { return level.dof == dof; });
+      levels.push_back(it == bundle_levels_.end() ? loadBundleLevel(dof)
+                                                  : std::move(*it));
+    }
+    bundle_levels_ = std::move(levels);
+  }
+
+  for (BundleLevel& level : bundle_levels_) {
+    // the monitor follows the obstacles, the robot state is the request's
+    level.psm->updateSceneWithCurrentState();
+    if (!level.context->updatePlanningContext(createBundleRequest(level))) {
+      ROS_ERROR_NAMED(LOGNAME, "Could not set up bundle level with %zu joints.",
+                      level.dof);
+      throw std::runtime_error("createPandaBundleContext");
+    }
+  }
+}
 
-  pandaBundleContext_->createPlanningContext(base_req);
+void PerceptionPlanner::getBundleSpaces(
+    const ompl::base::SpaceInformationPtr& si,
+    std::vector<ompl::base::SpaceInformationPtr>& si_vec,
+    std::vector<ompl::multilevel::ProjectionPtr>& proj_vec) {
+  si_vec.clear();
+  proj_vec.clear();
+  for (std::size_t i = 0; i < bundle_levels_.size(); i++) {
+    BundleLevel& level = bundle_levels_[i];
+    ompl::base::SpaceInformationPtr base_si =
+        level.context->getPlanningContext()
+            ->getOMPLSimpleSetup()
+            ->getSpaceInformation();
+    si_vec.emplace_back(base_si);
+  }
+  si_vec.emplace_back(si);
+
+  // the projection of level i maps the space above it onto its own
+  for (std::size_t i = 0; i < bundle_levels_.size(); i++) {
+    BundleLevel& level = bundle_levels_[i];
+    const ompl::base::StateSpacePtr& bundle_space =
+        si_vec[i + 1]->getStateSpace();
+    const ompl::base::StateSpacePtr& base_space = si_vec[i]->getStateSpace();
+    if (!level.projection || level.bundle_space != bundle_space ||
+        level.base_space != base_space) {
+      ROS_INFO_NAMED(LOGNAME, "Creating projection onto %zu joints.",
+                     level.dof);
+      level.projection =
+          std::make_shared<ompl::multilevel::Projection_ModelBased_RN_RM>(
+              bundle_space, base_space);
+      auto componentFiber =
+          std::dynamic_pointer_cast<ompl::multilevel::FiberedProjection>(
+              level.projection);
+      componentFiber->makeFiberSpace();
+      level.bundle_space = bundle_space;
+      level.base_space = base_space;
+    }
+    proj_vec.emplace_back(level.projection);
+  }
 }
 
 }  // namespace tacbot
\ No newline at end of file
@@ -80,9 +80,15 @@ int main(int argc, char** argv) {
     return 1;
   }
 
+  ROS_DEBUG_NAMED(LOGNAME, "shortcutPlan");
+  if (!planner->shortcutPlan(res, 1.0)) {
+    return 1;
+  }
+
   if (!planner->parameterizePlan(res)) {
     return 1;
   }
+  planner->compressPlan(res);
 
   moveit_msgs::MotionPlanResponse msg;
   res.getMessage(msg);
@@ -103,12 +109,38 @@ int main(int argc, char** argv) {
 
     moveit_msgs::MotionPlanResponse traj_msg;
     res.getMessage(traj_msg);
-    std::vector<std::array<double, 7>> joint_waypoints;
-    std::vector<std::array<double, 7>> joint_velocities;
-    utilities::toControlTrajectory(traj_msg, joint_waypoints, joint_velocities);
-
-    panda_interface.follow_joint_velocities(panda_interface.robot_.get(),
-                                            joint_velocities);
+    JointTrajectorySpline trajectory;
+    if (!JointTrajectorySpline::fromTrajectory(
+            traj_msg.trajectory.joint_trajectory, trajectory)) {
+      ROS_ERROR_NAMED(LOGNAME, "The planned trajectory is malformed.");
+      return 1;
+    }
+
+    // record the control loop when a file is given, e.g.
+    // _control_log:=/tmp/control.csv
+    std::string control_log;
+    if (ros::NodeHandle("~").getParam("control_log", control_log) &&
+        !control_log.empty() &&
+        !panda_interface.start_control_log(control_log)) {
+      ROS_WARN_NAMED(LOGNAME, "Could not open the control log %s.",
+                     control_log.c_str());
+    }
+    // _follow_waypoints:=true passes through the waypoints of the plan with
+    // their planned velocities on blended Ruckig segments, instead of
+    // following its timing
+    bool follow_waypoints = false;
+    ros::NodeHandle("~").getParam("follow_waypoints", follow_waypoints);
+    if (follow_waypoints) {
+      if (!panda_interface.follow_joint_waypoints(
+              panda_interface.robot_.get(), trajectory,
+              req.max_velocity_scaling_factor)) {
+        ROS_ERROR_NAMED(LOGNAME, "Could not blend the planned waypoints.");
+      }
+    } else {
+      panda_interface.follow_joint_trajectory(panda_interface.robot_.get(),
+                                              trajectory);
+    }
+    panda_interface.stop_control_log();
     sleep(0.5);
   }
 
@@ -0,0 +1,14 @@
+#include "planner_registry.h"
+
+namespace tacbot {
+
+Eigen::Vector3d FieldParams::normalizedKernel(const Eigen::Vector3d& vec) {
+  return vec.normalized();
+}
+
+Eigen::Vector3d FieldParams::inverseSquareKernel(
+    const Eigen::Vector3d& vec) const {
+  return (vec * y_max) / (falloff * vec.squaredNorm() + 1.0);
+}
+
+}  // namespace tacbot
@@ -0,0 +1,116 @@
+#include "simulated_robot.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+namespace tacbot {
+
+namespace {
+// limits from https://frankaemika.github.io/docs/control_parameters.html
+constexpr std::array<double, 7> MAX_ACCELERATION = {15.0, 7.5,  10.0, 12.5,
+                                                    15.0, 20.0, 20.0};
+}  // namespace
+
+SimulatedRobot::SimulatedRobot() : SimulatedRobot(Options()) {}
+
+SimulatedRobot::SimulatedRobot(const Options& options)
+    : options_(options), rng_(options.seed) {
+  setJointPositions(options_.initial_q);
+}
+
+void SimulatedRobot::setJointPositions(const std::array<double, 7>& q) {
+  state_ = franka::RobotState();
+  state_.q = q;
+  state_.q_d = q;
+}
+
+void SimulatedRobot::control(JointVelocityCallback callback) {
+  using clock = std::chrono::steady_clock;
+
+  stats_ = Stats();
+  compute_times_.clear();
+  compute_times_.reserve(options_.max_cycles);
+  std::bernoulli_distribution lose_cycle(options_.missed_cycle_probability);
+
+  // the first call reports no elapsed time, as on the real robot
+  std::uint64_t period_ms = 0;
+  std::array<double, 7> command{};
+  clock::time_point cycle_start = clock::now();
+
+  while (stats_.cycles < options_.max_cycles) {
+    const double dt = period_ms * 0.001;
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      state_.q[jnt_idx] += command[jnt_idx] * dt;
+    }
+    state_.q_d = state_.q;
+    state_.dq = command;
+    state_.dq_d = command;
+    state_.time = franka::Duration(state_.time.toMSec() + period_ms);
+
+    clock::time_point start = clock::now();
+    franka::JointVelocities output =
+        callback(state_, franka::Duration(period_ms));
+    double compute_time =
+        std::chrono::duration<double>(clock::now() - start).count();
+    compute_times_.push_back(compute_time);
+    stats_.cycles++;
+
+    if (dt > 0.0) {
+      bool violation = false;
+      for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+        double acceleration = (output.dq[jnt_idx] - command[jnt_idx]) / dt;
+        state_.ddq_d[jnt_idx] = acceleration;
+        violation |= std::abs(acceleration) > MAX_ACCELERATION[jnt_idx];
+      }
+      stats_.acceleration_violations += violation;
+    }
+    command = output.dq;
+
+    if (output.motion_finished) {
+      break;
+    }
+
+    period_ms = 1;
+    if (compute_time > options_.deadline) {
+      stats_.missed_deadlines++;
+      period_ms++;
+    }
+    for (std::size_t lost = 0;
+         lost < options_.max_missed_cycles && lose_cycle(rng_); lost++) {
+      stats_.missed_cycles++;
+      period_ms++;
+    }
+
+    if (options_.real_time) {
+      cycle_start += std::chrono::milliseconds(period_ms);
+      std::this_thread::sleep_until(cycle_start);
+    }
+  }
+
+  state_.dq = {};
+  state_.dq_d = {};
+  state_.ddq_d = {};
+}
+
+SimulatedRobot::Stats SimulatedRobot::getStats() const {
+  Stats stats = stats_;
+  if (compute_times_.empty()) {
+    return stats;
+  }
+  std::vector<double> sorted = compute_times_;
+  std::sort(sorted.begin(), sorted.end());
+  auto percentile = [&sorted](double p) {
+    std::size_t idx = static_cast<std::size_t>(p * (sorted.size() - 1));
+    return sorted[idx];
+  };
+  stats.p50 = percentile(0.5);
+  stats.p90 = percentile(0.9);
+  stats.p99 = percentile(0.99);
+  stats.max = sorted.back();
+  return stats;
+}
+
+}  // namespace tacbot
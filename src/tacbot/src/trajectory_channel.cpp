@@ -0,0 +1,165 @@
+#include "trajectory_channel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+namespace tacbot {
+
+TrajectoryChannel::TrajectoryChannel() : TrajectoryChannel(Options()) {}
+
+TrajectoryChannel::TrajectoryChannel(const Options& options)
+    : options_(options),
+      channel_(options.capacity),
+      pending_(options.capacity) {}
+
+bool TrajectoryChannel::send(const TrajectoryCommand& command) {
+  return channel_.push(command);
+}
+
+void TrajectoryChannel::sendTrajectory(const JointTrajectorySpline& trajectory,
+                                       bool replace) {
+  for (std::size_t i = 1; i < trajectory.size(); i++) {
+    TrajectoryCommand command;
+    command.type = (replace && i == 1) ? TrajectoryCommand::Type::REPLACE
+                                       : TrajectoryCommand::Type::APPEND;
+    command.duration = trajectory.getTime(i) - trajectory.getTime(i - 1);
+    command.q = trajectory.getPosition(i);
+    command.dq = trajectory.getVelocity(i);
+    while (!send(command)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+void TrajectoryChannel::reset(const JointArray& q) {
+  pending_head_ = 0;
+  pending_size_ = 0;
+  active_ = false;
+  elapsed_ = 0.0;
+  finish_requested_ = false;
+  position_ = q;
+  velocity_.fill(0.0);
+}
+
+const TrajectoryChannel::JointArray& TrajectoryChannel::update(double period) {
+  TrajectoryCommand command;
+  for (std::size_t i = 0; i < options_.max_commands_per_cycle; i++) {
+    // leave appended segments in the channel until there is room for them
+    if (pending_size_ == pending_.size() || !channel_.pop(command)) {
+      break;
+    }
+    handle(command);
+  }
+
+  elapsed_ += period;
+  while (active_ && elapsed_ >= segment_.duration) {
+    elapsed_ -= segment_.duration;
+    position_ = segment_.q1;
+    velocity_ = segment_.v1;
+    active_ = false;
+
+    if (pending_size_ > 0) {
+      const TrajectoryCommand& next = pending_[pending_head_];
+      pending_head_ = (pending_head_ + 1) % pending_.size();
+      pending_size_--;
+      // the time past the end of the segment belongs to the next one, or
+      // the robot would fall behind the plan by up to a cycle per segment
+      begin(next.q, next.dq, next.duration, elapsed_);
+    } else if (!allZero(velocity_)) {
+      // ran out of segments while moving
+      beginStop(elapsed_);
+    }
+  }
+
+  if (active_) {
+    JointTrajectorySpline::evaluateSegment(
+        segment_.q0, segment_.v0, segment_.q1, segment_.v1, segment_.duration,
+        elapsed_, position_, velocity_);
+  } else {
+    elapsed_ = 0.0;
+  }
+  return velocity_;
+}
+
+bool TrajectoryChannel::isFinished() const {
+  return finish_requested_ && !active_ && pending_size_ == 0 &&
+         allZero(velocity_);
+}
+
+void TrajectoryChannel::handle(const TrajectoryCommand& command) {
+  // a segment without duration cannot be started, and queued it would stall
+  // the segments behind it
+  bool is_segment = command.type == TrajectoryCommand::Type::APPEND ||
+                    command.type == TrajectoryCommand::Type::REPLACE;
+  if (is_segment && !(command.duration > 0.0)) {
+    return;
+  }
+
+  switch (command.type) {
+    case TrajectoryCommand::Type::APPEND:
+      if (!active_ && pending_size_ == 0) {
+        begin(command.q, command.dq, command.duration);
+      } else {
+        pending_[(pending_head_ + pending_size_) % pending_.size()] = command;
+        pending_size_++;
+      }
+      break;
+    case TrajectoryCommand::Type::REPLACE:
+      pending_size_ = 0;
+      begin(command.q, command.dq, command.duration);
+      break;
+    case TrajectoryCommand::Type::STOP:
+      pending_size_ = 0;
+      beginStop();
+      break;
+    case TrajectoryCommand::Type::FINISH:
+      finish_requested_ = true;
+      break;
+  }
+}
+
+void TrajectoryChannel::begin(const JointArray& q1, const JointArray& v1,
+                              double duration, double start_time) {
+  if (duration <= 0.0) {
+    return;
+  }
+  // position_ and velocity_ hold the state of the last cycle
+  segment_.q0 = position_;
+  segment_.v0 = velocity_;
+  segment_.q1 = q1;
+  segment_.v1 = v1;
+  segment_.duration = duration;
+  elapsed_ = start_time;
+  active_ = true;
+}
+
+void TrajectoryChannel::beginStop(double start_time) {
+  double max_velocity = 0.0;
+  for (double v : velocity_) {
+    max_velocity = std::max(max_velocity, std::abs(v));
+  }
+  if (max_velocity == 0.0) {
+    active_ = false;
+    return;
+  }
+
+  // the cubic that ends at rest, half as far as the initial velocity would
+  // carry the robot in the same time, slows down linearly: its deceleration
+  // is the constant velocity / duration
+  double duration =
+      std::max(0.01, max_velocity / options_.stop_acceleration);
+  JointArray q1;
+  for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+    q1[jnt_idx] = position_[jnt_idx] + 0.5 * duration * velocity_[jnt_idx];
+  }
+  begin(q1, JointArray{}, duration, start_time);
+}
+
+bool TrajectoryChannel::allZero(const JointArray& values) const {
+  return std::all_of(values.begin(), values.end(),
+                     [](double v) { return v == 0.0; });
+}
+
+}  // namespace tacbot
@@ -0,0 +1,214 @@
+#include "trajectory_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace tacbot {
+
+namespace {
+
+constexpr char MAGIC[8] = {'T', 'B', 'T', 'R', 'A', 'J', '0', '1'};
+
+bool isLittleEndian() {
+  const std::uint16_t one = 1;
+  unsigned char first_byte;
+  std::memcpy(&first_byte, &one, 1);
+  return first_byte == 1;
+}
+
+/** \brief Convert items between host and little endian order, in place. The
+ * conversion is its own inverse and does nothing on little endian hosts.*/
+void swapLittleEndian(void* data, std::size_t count, std::size_t item_size) {
+  if (isLittleEndian()) {
+    return;
+  }
+  char* bytes = static_cast<char*>(data);
+  for (std::size_t i = 0; i < count; i++) {
+    std::reverse(bytes + i * item_size, bytes + (i + 1) * item_size);
+  }
+}
+
+/** \brief Write items in little endian order. Only a big endian host pays
+ * for a converted copy.*/
+void writeLittleEndian(std::ostream& file, const void* data, std::size_t count,
+                       std::size_t item_size) {
+  const char* bytes = static_cast<const char*>(data);
+  if (isLittleEndian()) {
+    file.write(bytes, count * item_size);
+    return;
+  }
+  std::vector<char> converted(bytes, bytes + count * item_size);
+  swapLittleEndian(converted.data(), count, item_size);
+  file.write(converted.data(), converted.size());
+}
+
+bool writeNpy(const std::string& path, const char* descr, const void* data,
+              std::size_t item_size, const std::vector<std::size_t>& shape) {
+  std::size_t count = 1;
+  std::ostringstream shape_str;
+  shape_str << "(";
+  for (std::size_t i = 0; i < shape.size(); i++) {
+    count *= shape[i];
+    shape_str << (i > 0 ? ", " : "") << shape[i];
+  }
+  // a tuple of one element needs its trailing comma
+  shape_str << (shape.size() == 1 ? ",)" : ")");
+
+  std::string header = std::string("{'descr': '") + descr +
+                       "', 'fortran_order': False, 'shape': " +
+                       shape_str.str() + ", }";
+  // magic, version and header length take 10 bytes, the data has to start
+  // at a multiple of 64 and the header ends in a newline
+  std::size_t total = 10 + header.size() + 1;
+  header.append((64 - total % 64) % 64, ' ');
+  header.push_back('\n');
+
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+  const char magic[] = {'\x93', 'N', 'U', 'M', 'P', 'Y', '\x01', '\x00'};
+  file.write(magic, sizeof(magic));
+  const std::uint16_t header_len = static_cast<std::uint16_t>(header.size());
+  const char len_bytes[2] = {static_cast<char>(header_len & 0xff),
+                             static_cast<char>(header_len >> 8)};
+  file.write(len_bytes, 2);
+  file.write(header.data(), header.size());
+  writeLittleEndian(file, data, count, item_size);
+  return file.good();
+}
+
+}  // namespace
+
+void TrajectoryLog::reserve(std::size_t num_samples) {
+  time_.reserve(num_samples);
+  q_.reserve(num_samples * 7);
+  dq_.reserve(num_samples * 7);
+  ddq_.reserve(num_samples * 7);
+}
+
+void TrajectoryLog::addSample(double time, const JointArray& q,
+                              const JointArray& dq, const JointArray& ddq) {
+  time_.push_back(time);
+  q_.insert(q_.end(), q.begin(), q.end());
+  dq_.insert(dq_.end(), dq.begin(), dq.end());
+  ddq_.insert(ddq_.end(), ddq.begin(), ddq.end());
+}
+
+void TrajectoryLog::addTrajectory(
+    const trajectory_msgs::JointTrajectory& trajectory) {
+  reserve(size() + trajectory.points.size());
+  const bool append = !time_.empty();
+  const double offset = append ? time_.back() : 0.0;
+  for (const trajectory_msgs::JointTrajectoryPoint& point :
+       trajectory.points) {
+    // a trajectory that continues the log starts where the log ends
+    if (append && point.time_from_start.toSec() <= 0.0) {
+      continue;
+    }
+    JointArray q{};
+    JointArray dq{};
+    JointArray ddq{};
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      q[jnt_idx] = point.positions[jnt_idx];
+      if (jnt_idx < point.velocities.size()) {
+        dq[jnt_idx] = point.velocities[jnt_idx];
+      }
+      if (jnt_idx < point.accelerations.size()) {
+        ddq[jnt_idx] = point.accelerations[jnt_idx];
+      }
+    }
+    addSample(offset + point.time_from_start.toSec(), q, dq, ddq);
+  }
+}
+
+void TrajectoryLog::clear() {
+  time_.clear();
+  q_.clear();
+  dq_.clear();
+  ddq_.clear();
+}
+
+bool TrajectoryLog::save(const std::string& path) const {
+  const std::uint64_t num_samples = time_.size();
+  const std::uint64_t time_offset = HEADER_SIZE;
+  const std::uint64_t q_offset = time_offset + num_samples * sizeof(double);
+  const std::uint64_t dq_offset = q_offset + num_samples * 7 * sizeof(double);
+  const std::uint64_t ddq_offset = dq_offset + num_samples * 7 * sizeof(double);
+
+  char header[HEADER_SIZE] = {};
+  const std::uint64_t fields[] = {num_samples, 7,         time_offset,
+                                  q_offset,    dq_offset, ddq_offset};
+  std::memcpy(header, MAGIC, sizeof(MAGIC));
+  std::memcpy(header + sizeof(MAGIC), fields, sizeof(fields));
+  swapLittleEndian(header + sizeof(MAGIC), 6, sizeof(std::uint64_t));
+
+  std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+  file.write(header, HEADER_SIZE);
+  for (const std::vector<double>* column : {&time_, &q_, &dq_, &ddq_}) {
+    writeLittleEndian(file, column->data(), column->size(), sizeof(double));
+  }
+  return file.good();
+}
+
+bool TrajectoryLog::load(const std::string& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  char header[HEADER_SIZE];
+  if (!file.read(header, HEADER_SIZE) ||
+      std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+    return false;
+  }
+  std::uint64_t fields[6];
+  std::memcpy(fields, header + sizeof(MAGIC), sizeof(fields));
+  swapLittleEndian(fields, 6, sizeof(std::uint64_t));
+  const std::uint64_t num_samples = fields[0];
+  if (fields[1] != 7) {
+    return false;
+  }
+
+  clear();
+  time_.resize(num_samples);
+  q_.resize(num_samples * 7);
+  dq_.resize(num_samples * 7);
+  ddq_.resize(num_samples * 7);
+  std::vector<double>* columns[] = {&time_, &q_, &dq_, &ddq_};
+  for (std::size_t i = 0; i < 4; i++) {
+    file.seekg(fields[2 + i]);
+    if (!file.read(reinterpret_cast<char*>(columns[i]->data()),
+                   columns[i]->size() * sizeof(double))) {
+      clear();
+      return false;
+    }
+    swapLittleEndian(columns[i]->data(), columns[i]->size(), sizeof(double));
+  }
+  return true;
+}
+
+bool TrajectoryLog::exportNpy(const std::string& prefix) const {
+  const std::size_t n = time_.size();
+  return saveNpy(prefix + "time.npy", time_.data(), {n}) &&
+         saveNpy(prefix + "q.npy", q_.data(), {n, 7}) &&
+         saveNpy(prefix + "dq.npy", dq_.data(), {n, 7}) &&
+         saveNpy(prefix + "ddq.npy", ddq_.data(), {n, 7});
+}
+
+bool saveNpy(const std::string& path, const double* data,
+             const std::vector<std::size_t>& shape) {
+  return writeNpy(path, "<f8", data, sizeof(double), shape);
+}
+
+bool saveNpy(const std::string& path, const int* data,
+             const std::vector<std::size_t>& shape) {
+  static_assert(sizeof(int) == 4, "npy files are written with 4 byte ints");
+  return writeNpy(path, "<i4", data, sizeof(int), shape);
+}
+
+}  // namespace tacbot
@@ -1,6 +1,136 @@
 #include "visualizer_data.h"
 
+#include <algorithm>
+
 namespace tacbot {
+namespace {
+template <typename T>
+T& slotOf(std::vector<T>& series, std::size_t slot, const T& empty = T()) {
+  if (slot >= series.size()) {
+    series.resize(slot + 1, empty);
+  }
+  return series[slot];
+}
+}  // namespace
+
+void VisualizerData::setRecordingOptions(const RecordingOptions& options) {
+  recording_options_ = options;
+  recording_options_.capacity = std::max<std::size_t>(options.capacity, 1);
+  recording_options_.stride = std::max<std::size_t>(options.stride, 1);
+  reservoir_rng_.seed(options.seed);
+  clear();
+}
+
+void VisualizerData::clear() {
+  sample_state_idx_.clear();
+  sample_joint_angles_.clear();
+  sample_desired_angles_.clear();
+  sample_final_angles_.clear();
+  sample_obstacle_pos_.clear();
+  manipulability_.clear();
+  repulsed_vec_at_link_.clear();
+  repulsed_vec_avg_at_link_.clear();
+  repulsed_origin_at_link_.clear();
+  nearrand_vec_at_link_.clear();
+  nearrand_origin_at_link_.clear();
+  nearrand_dot_at_link.clear();
+  ee_path_pts_.clear();
+
+  cur_state_ = NOT_RECORDED;
+  cur_slot_ = NOT_RECORDED;
+  num_states_seen_ = 0;
+  num_states_recorded_ = 0;
+}
+
+std::size_t VisualizerData::getSlot(std::size_t sample_state_count) {
+#if !TACBOT_VISUALIZER_RECORDING
+  (void)sample_state_count;
+  return NOT_RECORDED;
+#else
+  if (sample_state_count == cur_state_) {
+    return cur_slot_;
+  }
+  cur_state_ = sample_state_count;
+  cur_slot_ = NOT_RECORDED;
+  std::size_t seen = num_states_seen_++;
+
+  switch (recording_options_.policy) {
+    case RecordingOptions::ALL:
+      cur_slot_ = num_states_recorded_++;
+      break;
+    case RecordingOptions::OFF:
+      break;
+    case RecordingOptions::EVERY_NTH:
+      if (seen % recording_options_.stride == 0) {
+        cur_slot_ = num_states_recorded_++;
+      }
+      break;
+    case RecordingOptions::RESERVOIR:
+      if (num_states_recorded_ < recording_options_.capacity) {
+        cur_slot_ = num_states_recorded_++;
+      } else {
+        // Algorithm R: the state replaces a recorded one with probability
+        // capacity / (seen + 1), which keeps every state seen so far in the
+        // reservoir with the same probability.
+        std::uniform_int_distribution<std::size_t> dist(0, seen);
+        std::size_t idx = dist(reservoir_rng_);
+        if (idx < recording_options_.capacity) {
+          cur_slot_ = idx;
+          resetSlot(cur_slot_);
+        }
+      }
+      break;
+  }
+
+  if (cur_slot_ != NOT_RECORDED) {
+    slotOf(sample_state_idx_, cur_slot_) = sample_state_count;
+  }
+  return cur_slot_;
+#endif
+}
+
+void VisualizerData::resetSlot(std::size_t slot) {
+  const Eigen::VectorXd zero =
+      Eigen::VectorXd::Zero(cur_total_num_repulse_pts_ * 3);
+  for (auto* series : {&repulsed_vec_at_link_, &repulsed_origin_at_link_,
+                       &nearrand_vec_at_link_, &nearrand_origin_at_link_}) {
+    if (slot < series->size()) {
+      (*series)[slot] = zero;
+    }
+  }
+  if (slot < sample_obstacle_pos_.size()) {
+    sample_obstacle_pos_[slot].clear();
+  }
+  if (slot < nearrand_dot_at_link.size()) {
+    nearrand_dot_at_link[slot].resize(0);
+  }
+  if (slot < repulsed_vec_avg_at_link_.size()) {
+    repulsed_vec_avg_at_link_[slot].clear();
+  }
+}
+
+void VisualizerData::saveEEPathPt(const Eigen::Vector3d& pt, std::size_t pt_idx,
+                                  std::size_t num_pts) {
+  std::size_t stride = 1;
+  switch (recording_options_.policy) {
+    case RecordingOptions::ALL:
+      break;
+    case RecordingOptions::OFF:
+      return;
+    case RecordingOptions::EVERY_NTH:
+      stride = recording_options_.stride;
+      break;
+    case RecordingOptions::RESERVOIR:
+      stride = (num_pts + recording_options_.capacity - 1) /
+               recording_options_.capacity;
+      break;
+  }
+  // The last point is always kept, so the path ends at the goal.
+  if (pt_idx % stride == 0 || pt_idx + 1 == num_pts) {
+    ee_path_pts_.emplace_back(pt);
+  }
+}
+
 void VisualizerData::setTotalNumRepulsePts(std::size_t num_pts) {
   cur_total_num_repulse_pts_ = num_pts;
 }
@@ -9,19 +139,19 @@ void VisualizerData::saveOriginVec(const Eigen::Vector3d& origin,
                                    const Eigen::Vector3d& vec,
                                    std::size_t pt_num,
                                    std::size_t sample_state_count) {
-  if (sample_state_count == repulsed_vec_at_link_.size()) {
-    repulsed_vec_at_link_.emplace_back(
-        Eigen::VectorXd::Zero(cur_total_num_repulse_pts_ * 3));
-    repulsed_origin_at_link_.emplace_back(
-        Eigen::VectorXd::Zero(cur_total_num_repulse_pts_ * 3));
+  std::size_t slot = getSlot(sample_state_count);
+  if (slot == NOT_RECORDED) {
+    return;
   }
+  const Eigen::VectorXd zero =
+      Eigen::VectorXd::Zero(cur_total_num_repulse_pts_ * 3);
 
-  Eigen::VectorXd& cur_repulsed = repulsed_vec_at_link_[sample_state_count];
+  Eigen::VectorXd& cur_repulsed = slotOf(repulsed_vec_at_link_, slot, zero);
   cur_repulsed[pt_num * 3] = vec[0];
   cur_repulsed[pt_num * 3 + 1] = vec[1];
   cur_repulsed[pt_num * 3 + 2] = vec[2];
 
-  Eigen::VectorXd& cur_origin = repulsed_origin_at_link_[sample_state_count];
+  Eigen::VectorXd& cur_origin = slotOf(repulsed_origin_at_link_, slot, zero);
   cur_origin[pt_num * 3] = origin[0];
   cur_origin[pt_num * 3 + 1] = origin[1];
   cur_origin[pt_num * 3 + 2] = origin[2];
@@ -31,63 +161,80 @@ void VisualizerData::saveNearRandVec(const Eigen::Vector3d& origin,
                                      const Eigen::Vector3d& vec,
                                      std::size_t pt_num,
                                      std::size_t sample_state_count) {
-  if (sample_state_count == nearrand_vec_at_link_.size()) {
-    nearrand_vec_at_link_.emplace_back(
-        Eigen::VectorXd::Zero(cur_total_num_repulse_pts_ * 3));
-    nearrand_origin_at_link_.emplace_back(
-        Eigen::VectorXd::Zero(cur_total_num_repulse_pts_ * 3));
+  std::size_t slot = getSlot(sample_state_count);
+  if (slot == NOT_RECORDED) {
+    return;
   }
+  const Eigen::VectorXd zero =
+      Eigen::VectorXd::Zero(cur_total_num_repulse_pts_ * 3);
 
-  Eigen::VectorXd& cur_repulsed = nearrand_vec_at_link_[sample_state_count];
+  Eigen::VectorXd& cur_repulsed = slotOf(nearrand_vec_at_link_, slot, zero);
   cur_repulsed[pt_num * 3] = vec[0];
   cur_repulsed[pt_num * 3 + 1] = vec[1];
   cur_repulsed[pt_num * 3 + 2] = vec[2];
 
-  Eigen::VectorXd& cur_origin = nearrand_origin_at_link_[sample_state_count];
+  Eigen::VectorXd& cur_origin = slotOf(nearrand_origin_at_link_, slot, zero);
   cur_origin[pt_num * 3] = origin[0];
   cur_origin[pt_num * 3 + 1] = origin[1];
   cur_origin[pt_num * 3 + 2] = origin[2];
 }
 
+void VisualizerData::saveNearRandDot(const Eigen::VectorXd& vec) {
+  if (cur_slot_ == NOT_RECORDED) {
+    return;
+  }
+  slotOf(nearrand_dot_at_link, cur_slot_) = vec;
+}
+
 void VisualizerData::saveJointAngles(const std::vector<double>& joint_angles) {
-  sample_joint_angles_.emplace_back(joint_angles);
+  if (cur_slot_ == NOT_RECORDED) {
+    return;
+  }
+  slotOf(sample_joint_angles_, cur_slot_) = joint_angles;
 }
 
 void VisualizerData::saveRepulseAngles(const std::vector<double>& joint_angles,
                                        const Eigen::VectorXd& d_q_out) {
+  if (cur_slot_ == NOT_RECORDED) {
+    return;
+  }
   saveJointAngles(joint_angles);
-  sample_desired_angles_.emplace_back(
-      utilities::toStlVec(utilities::toEigen(joint_angles) + d_q_out));
+  slotOf(sample_desired_angles_, cur_slot_) =
+      utilities::toStlVec(utilities::toEigen(joint_angles) + d_q_out);
 }
 
 void VisualizerData::saveRepulseAngles(
     const std::vector<double>& joint_angles1,
     const std::vector<double>& joint_angles2) {
-  sample_joint_angles_.emplace_back(joint_angles1);
-  sample_desired_angles_.emplace_back(joint_angles2);
+  if (cur_slot_ == NOT_RECORDED) {
+    return;
+  }
+  slotOf(sample_joint_angles_, cur_slot_) = joint_angles1;
+  slotOf(sample_desired_angles_, cur_slot_) = joint_angles2;
 }
 
 void VisualizerData::saveObstaclePos(
     const std::vector<Eigen::Vector3d>& obstacle_pos,
     std::size_t sample_state_count) {
-  std::size_t num_saved = sample_obstacle_pos_.size();
-  // std::cout << "num_saved: " << num_saved << std::endl;
+  std::size_t slot = getSlot(sample_state_count);
+  if (slot == NOT_RECORDED) {
+    return;
+  }
+  // std::cout << "slot: " << slot << std::endl;
   // std::cout << "sample_state_count: " << sample_state_count << std::endl;
   // std::cout << "obstacle_pos.size(): " << obstacle_pos.size() << std::endl;
 
-  if (num_saved == sample_state_count) {
-    sample_obstacle_pos_.emplace_back(obstacle_pos);
-  } else {
-    std::vector<Eigen::Vector3d>& cur_obs_vec =
-        sample_obstacle_pos_[sample_state_count];
-    cur_obs_vec.insert(std::end(cur_obs_vec), std::begin(obstacle_pos),
-                       std::end(obstacle_pos));
-  }
+  std::vector<Eigen::Vector3d>& cur_obs_vec = slotOf(sample_obstacle_pos_, slot);
+  cur_obs_vec.insert(std::end(cur_obs_vec), std::begin(obstacle_pos),
+                     std::end(obstacle_pos));
 }
 
 void VisualizerData::saveAvgRepulseVec(
     const std::vector<Eigen::Vector3d>& vec) {
-  repulsed_vec_avg_at_link_.emplace_back(vec);
+  if (cur_slot_ == NOT_RECORDED) {
+    return;
+  }
+  slotOf(repulsed_vec_avg_at_link_, cur_slot_) = vec;
 }
 
 }  // namespace tacbot
\ No newline at end of file
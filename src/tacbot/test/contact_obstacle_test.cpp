@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <ros/ros.h>
+
+#include <fstream>
+
+#include "contact_planner.h"
+#include "my_moveit_context.h"
+
+using namespace tacbot;
+
+namespace {
+
+/** \brief Write a robot description parameter to a file, since the planner
+ * is initialized from files without a planning scene monitor.*/
+std::string writeParam(const std::string& param, const std::string& name) {
+  std::string content;
+  if (!ros::param::get(param, content)) {
+    return "";
+  }
+  std::string path = ::testing::TempDir() + name;
+  std::ofstream file(path);
+  file << content;
+  return path;
+}
+
+}  // namespace
+
+/** A contact reported during the execution adds an obstacle, which the field
+ * costs of the next plan have to see even for states that were already
+ * evaluated before the contact.*/
+TEST(ContactPlanner, replanSeesContactObstacle) {
+  std::string urdf_path =
+      writeParam("robot_description", "contact_obstacle_test.urdf");
+  std::string srdf_path =
+      writeParam("robot_description_semantic", "contact_obstacle_test.srdf");
+  ASSERT_FALSE(urdf_path.empty());
+  ASSERT_FALSE(srdf_path.empty());
+
+  ContactPlanner planner;
+  planner.init(urdf_path, srdf_path);
+  planner.setGoalState(1);
+  // the obstacle of this scene is out of reach of the ready pose
+  planner.setObstacleScene(2);
+  planner.setObjectiveName("FieldMagnitude");
+
+  MyMoveitContext context(planner.getPlanningScene(), planner.getRobotModel());
+  planning_interface::MotionPlanRequest req;
+  planner.setCurToStartState(req);
+  req.goal_constraints.push_back(planner.createJointGoal());
+  req.group_name = planner.getGroupName();
+  req.allowed_planning_time = 1.0;
+  req.planner_id = context.getPlannerId();
+  context.createPlanningContext(req);
+  ASSERT_TRUE(context.getPlanningContext());
+  planner.setPlanningContext(context.getPlanningContext());
+  planner.setPlannerName("RRTstar");
+  planner.changePlanner();
+
+  ompl_interface::ModelBasedPlanningContextPtr planning_context =
+      context.getPlanningContext();
+  ompl::base::OptimizationObjectivePtr objective =
+      planning_context->getOMPLSimpleSetup()->getOptimizationObjective();
+  ASSERT_TRUE(objective);
+
+  // a short motion out of the ready pose
+  const moveit::core::JointModelGroup* joint_model_group =
+      planner.getRobotModel()->getJointModelGroup(planner.getGroupName());
+  moveit::core::RobotState robot_state(planner.getRobotModel());
+  robot_state.setToDefaultValues(joint_model_group, "ready");
+  robot_state.update();
+  ompl::base::ScopedState<> from(planning_context->getOMPLStateSpace());
+  ompl::base::ScopedState<> to(planning_context->getOMPLStateSpace());
+  planning_context->getOMPLStateSpace()->copyToOMPLState(from.get(),
+                                                         robot_state);
+  std::vector<double> joint_values;
+  robot_state.copyJointGroupPositions(joint_model_group, joint_values);
+  joint_values[0] += 0.05;
+  robot_state.setJointGroupPositions(joint_model_group, joint_values);
+  planning_context->getOMPLStateSpace()->copyToOMPLState(to.get(),
+                                                         robot_state);
+
+  double cost_before = objective->motionCost(from.get(), to.get()).value();
+
+  // a contact on the wrist, right where the robot is
+  robot_state.setToDefaultValues(joint_model_group, "ready");
+  robot_state.update();
+  Eigen::Vector3d wrist =
+      robot_state.getGlobalLinkTransform("panda_link7").translation();
+  ExecutionStatus status;
+  status.contact_link = 7;
+  status.contact_point = {wrist[0], wrist[1], wrist[2]};
+  planner.addContactObstacle(status);
+
+  double cost_after = objective->motionCost(from.get(), to.get()).value();
+  EXPECT_GT(cost_after, cost_before);
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "contact_obstacle_test");
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,300 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <random>
+
+#include "field_engine.h"
+
+using namespace tacbot;
+
+namespace {
+
+/** \brief Points scattered over a box, as the merged vertices of a link mesh
+ * would be.*/
+std::vector<Eigen::Vector3d> makeLinkPts(std::size_t num_pts,
+                                         const Eigen::Vector3d& size,
+                                         unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::vector<Eigen::Vector3d> pts;
+  for (std::size_t i = 0; i < num_pts; i++) {
+    pts.emplace_back(size[0] * unit(rng), size[1] * unit(rng),
+                     size[2] * unit(rng));
+  }
+  return pts;
+}
+
+double distanceToSet(const Eigen::Vector3d& pt,
+                     const std::vector<Eigen::Vector3d>& pts,
+                     std::size_t count) {
+  double dist = std::numeric_limits<double>::infinity();
+  for (std::size_t j = 0; j < count; j++) {
+    dist = std::min(dist, (pt - pts[j]).norm());
+  }
+  return dist;
+}
+
+/** \brief The repulsion of one state as the planner computes it: every point
+ * averages the scaled vectors to all obstacles, and each link averages its
+ * points.*/
+std::vector<Eigen::Vector3d> referenceLinkVecs(
+    const FieldParams& params,
+    const std::vector<std::vector<Eigen::Vector3d>>& rob_pts,
+    const std::vector<Eigen::Vector3d>& obstacles,
+    const std::vector<std::vector<Eigen::Vector3d>>& attractor_pts) {
+  std::vector<Eigen::Vector3d> link_vecs;
+  for (std::size_t i = 0; i < rob_pts.size(); i++) {
+    Eigen::Vector3d link_sum = Eigen::Vector3d::Zero();
+    for (std::size_t j = 0; j < rob_pts[i].size(); j++) {
+      const Eigen::Vector3d& pt = rob_pts[i][j];
+      Eigen::Vector3d pt_sum = Eigen::Vector3d::Zero();
+      for (const Eigen::Vector3d& obstacle : obstacles) {
+        Eigen::Vector3d vec = params.scale(pt - obstacle);
+        if (params.use_goal_attractor) {
+          Eigen::Vector3d att_vec = attractor_pts[i][j] - pt;
+          if (vec.norm() == 0.0) {
+            att_vec = Eigen::Vector3d::Zero();
+          } else {
+            att_vec.normalize();
+          }
+          if (att_vec.dot(vec) < -0.5) {
+            att_vec = Eigen::Vector3d::Zero();
+          }
+          vec = vec + 0.5 * att_vec;
+        }
+        pt_sum += vec;
+      }
+      link_sum += pt_sum / static_cast<double>(obstacles.size());
+    }
+    link_vecs.emplace_back(
+        rob_pts[i].empty()
+            ? Eigen::Vector3d::Zero()
+            : Eigen::Vector3d(link_sum / static_cast<double>(
+                                             rob_pts[i].size())));
+  }
+  return link_vecs;
+}
+
+}  // namespace
+
+/** Every level of detail is a prefix of the same ordered points: the points
+ * of a level are a spacing apart, and every point of the link is within a
+ * spacing of them, so a prefix covers the whole link.*/
+TEST(FieldEngine, levelsOfDetailArePrefixes) {
+  const std::vector<double> spacings = {0.005, 0.02, 0.04, 0.08};
+  std::vector<Eigen::Vector3d> pts =
+      makeLinkPts(600, Eigen::Vector3d(0.1, 0.1, 0.3), 3);
+  FieldEngine::LinkSurface surface =
+      FieldEngine::buildLinkSurface(pts, spacings);
+
+  ASSERT_EQ(surface.local_pts.size(), pts.size());
+  ASSERT_EQ(surface.level_counts.size(), spacings.size());
+  EXPECT_EQ(surface.level_counts[0], pts.size());
+
+  // the same points, reordered
+  auto less = [](const Eigen::Vector3d& a, const Eigen::Vector3d& b) {
+    return std::lexicographical_compare(a.data(), a.data() + 3, b.data(),
+                                        b.data() + 3);
+  };
+  std::vector<Eigen::Vector3d> sorted_pts = pts;
+  std::vector<Eigen::Vector3d> sorted_surface = surface.local_pts;
+  std::sort(sorted_pts.begin(), sorted_pts.end(), less);
+  std::sort(sorted_surface.begin(), sorted_surface.end(), less);
+  EXPECT_EQ(sorted_pts, sorted_surface);
+
+  for (std::size_t l = 1; l < spacings.size(); l++) {
+    std::size_t count = surface.level_counts[l];
+    ASSERT_GE(count, 1u);
+    EXPECT_LE(count, surface.level_counts[l - 1]) << "at level " << l;
+    for (std::size_t j = 1; j < count; j++) {
+      EXPECT_GE(distanceToSet(surface.local_pts[j], surface.local_pts, j),
+                spacings[l])
+          << "point " << j << " at level " << l;
+    }
+    for (const Eigen::Vector3d& pt : pts) {
+      EXPECT_LT(distanceToSet(pt, surface.local_pts, count), spacings[l])
+          << "at level " << l;
+    }
+  }
+
+  // the sphere encloses all points
+  for (const Eigen::Vector3d& pt : pts) {
+    EXPECT_LE((pt - surface.local_sphere.center).norm(),
+              surface.local_sphere.radius + 1e-12);
+  }
+}
+
+TEST(FieldEngine, emptyLinkSurface) {
+  FieldEngine::LinkSurface surface =
+      FieldEngine::buildLinkSurface({}, {0.05, 0.1});
+  EXPECT_TRUE(surface.local_pts.empty());
+  EXPECT_EQ(surface.level_counts, std::vector<std::size_t>({0, 0}));
+}
+
+/** The links in contact keep their dense points, the budget is met by
+ * coarsening the links that are farthest from the obstacles first, and when
+ * even the coarsest levels are over it every link is cut down.*/
+TEST(FieldEngine, choosePtCountsRespectsTheBudget) {
+  const std::vector<double> spacings = {0.005, 0.02, 0.04, 0.08};
+  const std::size_t num_links = 5;
+  std::vector<FieldEngine::LinkSurface> surfaces;
+  std::vector<const FieldEngine::LinkSurface*> surface_ptrs;
+  std::vector<BoundingSphere> spheres;
+  for (std::size_t i = 0; i < num_links; i++) {
+    surfaces.emplace_back(FieldEngine::buildLinkSurface(
+        makeLinkPts(400, Eigen::Vector3d(0.1, 0.1, 0.2), i), spacings));
+  }
+  for (std::size_t i = 0; i < num_links; i++) {
+    surface_ptrs.emplace_back(&surfaces[i]);
+    // the links are lined up along x, 0.5 m apart
+    BoundingSphere sphere = surfaces[i].local_sphere;
+    sphere.center += Eigen::Vector3d(0.5 * i, 0.0, 0.0);
+    spheres.emplace_back(sphere);
+  }
+
+  // an obstacle inside the first link's sphere
+  FieldEngine engine;
+  engine.setObstacles({spheres[0].center});
+
+  std::size_t dense_total = 0;
+  std::size_t coarsest_total = 0;
+  for (const FieldEngine::LinkSurface& surface : surfaces) {
+    dense_total += surface.level_counts.front();
+    coarsest_total += surface.level_counts.back();
+  }
+
+  // without a budget the link in contact is dense, the others are far away
+  std::vector<std::size_t> counts =
+      engine.choosePtCounts(surface_ptrs, spheres);
+  ASSERT_EQ(counts.size(), num_links);
+  EXPECT_EQ(counts[0], surfaces[0].level_counts.front());
+  for (std::size_t i = 1; i < num_links; i++) {
+    EXPECT_EQ(counts[i], surfaces[i].level_counts.back());
+  }
+
+  for (std::size_t max_pts :
+       {dense_total, coarsest_total + 100, coarsest_total, std::size_t{50},
+        std::size_t{7}, std::size_t{1}}) {
+    FieldEngine::Options options;
+    options.lod_spacings = spacings;
+    options.max_pts = max_pts;
+    engine.setOptions(options);
+    counts = engine.choosePtCounts(surface_ptrs, spheres);
+    ASSERT_EQ(counts.size(), num_links);
+
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < num_links; i++) {
+      EXPECT_GE(counts[i], 1u);
+      EXPECT_LE(counts[i], surfaces[i].level_counts.front());
+      total += counts[i];
+    }
+    // every link keeps at least one point
+    EXPECT_LE(total, std::max(max_pts, num_links)) << "for " << max_pts;
+
+    if (max_pts >= coarsest_total - surfaces[0].level_counts.back() +
+                       surfaces[0].level_counts.front()) {
+      // the far links can make up for the link in contact
+      EXPECT_EQ(counts[0], surfaces[0].level_counts.front())
+          << "for " << max_pts;
+    }
+  }
+}
+
+/** The batch gives every state the repulsion and cost of evaluating it on its
+ * own, whether its links are near the obstacles or not, with either kernel
+ * and with the goal attractor.*/
+TEST(FieldEngine, evaluatePtsBatchMatchesSingleStates) {
+  const std::size_t num_links = 3;
+  const std::size_t num_states = 21;
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> unit(-1.0, 1.0);
+
+  // A cloud of obstacle points around the origin.
+  std::vector<Eigen::Vector3d> obstacles;
+  for (std::size_t k = 0; k < 40; k++) {
+    obstacles.emplace_back(0.1 * unit(rng), 0.1 * unit(rng), 0.1 * unit(rng));
+  }
+
+  std::vector<std::vector<Eigen::Vector3d>> local_pts;
+  std::vector<std::vector<Eigen::Vector3d>> attractor_pts;
+  for (std::size_t i = 0; i < num_links; i++) {
+    local_pts.emplace_back(
+        makeLinkPts(20 + 5 * i, Eigen::Vector3d(0.05, 0.05, 0.1), i));
+    std::vector<Eigen::Vector3d> goal_pts;
+    for (const Eigen::Vector3d& pt : local_pts.back()) {
+      goal_pts.emplace_back(pt + Eigen::Vector3d(0.3, 0.2, 0.0));
+    }
+    attractor_pts.emplace_back(goal_pts);
+  }
+
+  // The links sweep past the obstacles, so some states are near them and
+  // some are far away. The last link has fewer points in every other state,
+  // as a coarser level of detail would give it.
+  std::vector<std::vector<std::vector<Eigen::Vector3d>>> rob_pts(num_states);
+  std::vector<std::vector<BoundingSphere>> link_spheres(num_states);
+  for (std::size_t s = 0; s < num_states; s++) {
+    double t = static_cast<double>(s) / (num_states - 1);
+    for (std::size_t i = 0; i < num_links; i++) {
+      Eigen::Vector3d offset(0.6 * t - 0.3, 0.05 * i - 0.05, 0.0);
+      std::size_t count = local_pts[i].size();
+      if (i == num_links - 1 && s % 2 == 1) {
+        count /= 2;
+      }
+      std::vector<Eigen::Vector3d> pts;
+      BoundingSphere sphere;
+      sphere.center = offset;
+      sphere.radius = 0.0;
+      for (std::size_t j = 0; j < count; j++) {
+        pts.emplace_back(local_pts[i][j] + offset);
+        sphere.radius =
+            std::max(sphere.radius, (pts.back() - sphere.center).norm());
+      }
+      rob_pts[s].emplace_back(pts);
+      link_spheres[s].emplace_back(sphere);
+    }
+  }
+
+  FieldEngine engine;
+  engine.setObstacles(obstacles);
+  engine.setAttractorPts(attractor_pts);
+  for (FieldParams::Kernel kernel :
+       {FieldParams::Kernel::NORMALIZED, FieldParams::Kernel::INVERSE_SQUARE}) {
+    for (bool goal_attractor : {false, true}) {
+      FieldParams params;
+      params.kernel = kernel;
+      params.use_goal_attractor = goal_attractor;
+      engine.setFieldParams(params);
+
+      FieldEngine::FieldBatch batch;
+      engine.evaluatePtsBatch(rob_pts, link_spheres, batch);
+      ASSERT_EQ(batch.numLinks(), num_links);
+      ASSERT_EQ(static_cast<std::size_t>(batch.costs.size()), num_states);
+
+      std::size_t repelled_states = 0;
+      for (std::size_t s = 0; s < num_states; s++) {
+        std::vector<Eigen::Vector3d> expected =
+            referenceLinkVecs(params, rob_pts[s], obstacles, attractor_pts);
+        double expected_cost = 0.0;
+        for (std::size_t i = 0; i < num_links; i++) {
+          EXPECT_LT((batch.linkVec(s, i) - expected[i]).norm(), 1e-12)
+              << "state " << s << " link " << i;
+          expected_cost += expected[i].norm();
+        }
+        EXPECT_NEAR(batch.costs[s], expected_cost, 1e-12) << "state " << s;
+        if (expected_cost > 0.0) {
+          repelled_states++;
+        }
+      }
+      EXPECT_GT(repelled_states, 0u);
+      EXPECT_LT(repelled_states, num_states);
+    }
+  }
+
+  // without obstacles nothing is repelled
+  engine.setObstacles({});
+  FieldEngine::FieldBatch batch;
+  engine.evaluatePtsBatch(rob_pts, link_spheres, batch);
+  EXPECT_EQ(batch.link_vecs.rows(), static_cast<Eigen::Index>(3 * num_links));
+  EXPECT_EQ(batch.costs, Eigen::VectorXd::Zero(num_states));
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "field_grid_cache.h"
+
+using namespace tacbot;
+
+namespace {
+
+const std::size_t DOF = 7;
+
+std::vector<double> randomConfiguration(std::mt19937& rng) {
+  std::uniform_real_distribution<double> angle(-1.0, 1.0);
+  std::vector<double> q(DOF);
+  for (double& value : q) {
+    value = angle(rng);
+  }
+  return q;
+}
+
+double maxError(const Eigen::VectorXd& a, const Eigen::VectorXd& b) {
+  return (a - b).cwiseAbs().maxCoeff();
+}
+
+}  // namespace
+
+/** A steep linear function is reproduced by the interpolation, so it is
+ * trusted however much the vertex values differ.*/
+TEST(FieldGridCache, steepLinearFunctionIsInterpolated) {
+  FieldGridCache::Evaluator linear = [](const std::vector<double>& q) {
+    Eigen::VectorXd value(2);
+    value[0] = 3.0;
+    value[1] = 1.0;
+    for (std::size_t i = 0; i < q.size(); i++) {
+      value[0] += 40.0 * q[i];
+      value[1] -= 25.0 * static_cast<double>(i) * q[i];
+    }
+    return value;
+  };
+
+  FieldGridCache grid;
+  std::mt19937 rng(1);
+  for (std::size_t n = 0; n < 200; n++) {
+    std::vector<double> q = randomConfiguration(rng);
+    Eigen::VectorXd value;
+    ASSERT_TRUE(grid.interpolate(q, linear, value));
+    EXPECT_LT(maxError(value, linear(q)), 1e-9);
+  }
+  EXPECT_EQ(grid.getStats().rejected, 0u);
+}
+
+/** A simplex that a step crosses has vertices on both sides, so the check at
+ * its centroid fails. Every accepted value is then exact.*/
+TEST(FieldGridCache, fallsBackWhereAStepCrossesTheSimplex) {
+  FieldGridCache::Evaluator step = [](const std::vector<double>& q) {
+    Eigen::VectorXd value(1);
+    value[0] = q[0] + 0.5 * q[1] - 0.3 * q[4] > 0.013 ? 1.0 : 0.0;
+    return value;
+  };
+
+  FieldGridCache::Options options;
+  options.tolerance = 0.1;
+  FieldGridCache grid(options);
+  std::mt19937 rng(2);
+  std::uniform_real_distribution<double> offset(-0.1, 0.1);
+  std::size_t accepted = 0;
+  std::size_t rejected = 0;
+  for (std::size_t n = 0; n < 2000; n++) {
+    // concentrate the queries around the step
+    std::vector<double> q = randomConfiguration(rng);
+    q[0] = 0.013 - 0.5 * q[1] + 0.3 * q[4] + offset(rng);
+    Eigen::VectorXd value;
+    if (grid.interpolate(q, step, value)) {
+      accepted++;
+      ASSERT_EQ(value[0], step(q)[0]) << "at query " << n;
+    } else {
+      rejected++;
+    }
+  }
+  EXPECT_GT(accepted, 0u);
+  EXPECT_GT(rejected, 0u);
+}
+
+/** Where the function is convex or concave, the accepted values are within
+ * the tolerance of the exact ones, and the simplices that are too curved for
+ * it are evaluated exactly.*/
+TEST(FieldGridCache, curvedFunctionStaysWithinTolerance) {
+  FieldGridCache::Evaluator curved = [](const std::vector<double>& q) {
+    Eigen::VectorXd value(3);
+    value[0] = 0.0;
+    for (std::size_t i = 0; i < q.size(); i++) {
+      value[0] += 0.2 * static_cast<double>(i + 1) * q[i] * q[i];
+    }
+    value[1] = std::exp(q[0] + 0.5 * q[1] - q[6]);
+    value[2] = -std::log(3.0 + q[2] + q[3]);
+    return value;
+  };
+
+  FieldGridCache::Options options;
+  options.resolution = 0.05;
+  options.tolerance = 1e-2;
+  FieldGridCache grid(options);
+  std::mt19937 rng(3);
+  for (std::size_t n = 0; n < 500; n++) {
+    std::vector<double> q = randomConfiguration(rng);
+    Eigen::VectorXd value;
+    if (grid.interpolate(q, curved, value)) {
+      EXPECT_LE(maxError(value, curved(q)), options.tolerance)
+          << "at query " << n;
+    }
+  }
+  FieldGridCache::Stats stats = grid.getStats();
+  EXPECT_GT(stats.interpolated, 0u);
+  EXPECT_GT(stats.rejected, 0u);
+}
+
+/** A simplex is checked once. A rejected one is remembered, so later queries
+ * in it do not evaluate its vertices again, until the scene changes.*/
+TEST(FieldGridCache, remembersTheCheckOfASimplex) {
+  std::size_t evaluations = 0;
+  FieldGridCache::Evaluator step = [&](const std::vector<double>& q) {
+    evaluations++;
+    Eigen::VectorXd value(1);
+    value[0] = q[0] > 0.02 ? 1.0 : 0.0;
+    return value;
+  };
+
+  FieldGridCache grid;
+  std::vector<double> q = {0.013, 0.012, 0.011, 0.01, 0.009, 0.008, 0.007};
+  Eigen::VectorXd value;
+  EXPECT_FALSE(grid.interpolate(q, step, value));
+  // dim + 1 vertices and the centroid
+  EXPECT_EQ(evaluations, DOF + 2);
+  EXPECT_FALSE(grid.interpolate(q, step, value));
+  EXPECT_EQ(evaluations, DOF + 2);
+
+  // the same simplex, farther from the step
+  std::vector<double> q2 = {0.011, 0.009, 0.008, 0.007, 0.006, 0.005, 0.004};
+  EXPECT_FALSE(grid.interpolate(q2, step, value));
+  EXPECT_EQ(evaluations, DOF + 2);
+  EXPECT_EQ(grid.getStats().simplex_checks, 1u);
+
+  grid.setSceneVersion(1);
+  EXPECT_FALSE(grid.interpolate(q, step, value));
+  EXPECT_EQ(evaluations, 2 * (DOF + 2));
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+
+#include "joint_trajectory_spline.h"
+
+using namespace tacbot;
+
+namespace {
+
+/** \brief A smooth trajectory sampled densely, each joint on its own sine,
+ * with exact velocities at the waypoints.*/
+JointTrajectorySpline makeSineTrajectory(double duration, double period) {
+  JointTrajectorySpline spline;
+  std::size_t num_pts = static_cast<std::size_t>(std::round(duration / period));
+  for (std::size_t i = 0; i <= num_pts; i++) {
+    double t = period * static_cast<double>(i);
+    JointTrajectorySpline::JointArray q;
+    JointTrajectorySpline::JointArray dq;
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      double amplitude = 0.2 + 0.1 * static_cast<double>(jnt_idx);
+      double frequency = 0.5 + 0.25 * static_cast<double>(jnt_idx);
+      q[jnt_idx] = amplitude * std::sin(frequency * t);
+      dq[jnt_idx] = amplitude * frequency * std::cos(frequency * t);
+    }
+    spline.addPoint(t, q, dq);
+  }
+  return spline;
+}
+
+double maxError(const JointTrajectorySpline::JointArray& a,
+                const JointTrajectorySpline::JointArray& b) {
+  double error = 0.0;
+  for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+    error = std::max(error, std::abs(a[jnt_idx] - b[jnt_idx]));
+  }
+  return error;
+}
+
+}  // namespace
+
+/** The compressed spline reproduces the dense one at every dropped waypoint
+ * and at the midpoints between the waypoints.*/
+TEST(JointTrajectorySpline, compressStaysWithinTolerance) {
+  const double position_tolerance = 1e-4;
+  const double velocity_tolerance = 1e-3;
+  JointTrajectorySpline dense = makeSineTrajectory(3.0, 0.001);
+  JointTrajectorySpline compressed =
+      dense.compress(position_tolerance, velocity_tolerance);
+
+  ASSERT_GE(compressed.size(), 2u);
+  EXPECT_LT(compressed.size(), dense.size() / 10);
+  EXPECT_EQ(compressed.getTime(0), dense.getTime(0));
+  EXPECT_EQ(compressed.getTime(compressed.size() - 1),
+            dense.getTime(dense.size() - 1));
+
+  std::size_t dense_segment = 0;
+  std::size_t compressed_segment = 0;
+  JointTrajectorySpline::JointArray dense_q, dense_dq, q, dq;
+  for (std::size_t i = 0; i + 1 < dense.size(); i++) {
+    for (double t : {dense.getTime(i),
+                     0.5 * (dense.getTime(i) + dense.getTime(i + 1))}) {
+      dense.sample(t, dense_segment, dense_q, dense_dq);
+      compressed.sample(t, compressed_segment, q, dq);
+      ASSERT_LE(maxError(q, dense_q), position_tolerance) << "at " << t;
+      ASSERT_LE(maxError(dq, dense_dq), velocity_tolerance) << "at " << t;
+    }
+  }
+}
+
+/** The knots are increasing and include both ends, also for the shortest
+ * trajectories and for ones that a single segment reproduces.*/
+TEST(JointTrajectorySpline, selectKnotsKeepsTheEnds) {
+  JointTrajectorySpline empty;
+  EXPECT_TRUE(empty.selectKnots(1e-4, 1e-3).empty());
+
+  JointTrajectorySpline single;
+  single.addPoint(0.0, JointTrajectorySpline::JointArray{},
+                  JointTrajectorySpline::JointArray{});
+  EXPECT_EQ(single.selectKnots(1e-4, 1e-3), std::vector<std::size_t>({0}));
+
+  // a constant velocity is a single cubic segment
+  JointTrajectorySpline line;
+  JointTrajectorySpline::JointArray velocity;
+  velocity.fill(0.3);
+  for (std::size_t i = 0; i <= 1000; i++) {
+    double t = 0.001 * static_cast<double>(i);
+    JointTrajectorySpline::JointArray q;
+    q.fill(0.3 * t);
+    line.addPoint(t, q, velocity);
+  }
+  EXPECT_EQ(line.selectKnots(1e-6, 1e-6), std::vector<std::size_t>({0, 1000}));
+
+  JointTrajectorySpline dense = makeSineTrajectory(1.0, 0.01);
+  std::vector<std::size_t> knots = dense.selectKnots(1e-5, 1e-4);
+  ASSERT_GE(knots.size(), 2u);
+  EXPECT_EQ(knots.front(), 0u);
+  EXPECT_EQ(knots.back(), dense.size() - 1);
+  for (std::size_t i = 1; i < knots.size(); i++) {
+    EXPECT_LT(knots[i - 1], knots[i]);
+  }
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+#include "cycle_timing.h"
+
+using namespace tacbot;
+
+TEST(LatencyHistogram, emptyHistogram) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.getCount(), 0u);
+  EXPECT_EQ(histogram.getValueAtPercentile(50.0), 0u);
+  EXPECT_EQ(histogram.getMean(), 0.0);
+}
+
+/** Small values get a bucket each, so they come back exactly.*/
+TEST(LatencyHistogram, smallValuesAreExact) {
+  for (std::uint64_t value = 0; value < 64; value++) {
+    LatencyHistogram histogram;
+    histogram.record(value);
+    EXPECT_EQ(histogram.getValueAtPercentile(50.0), value);
+  }
+}
+
+/** A single value comes back as the upper bound of its bucket, which is at
+ * most one 32nd above it, and never above the largest recorded value.*/
+TEST(LatencyHistogram, bucketsBoundTheRelativeError) {
+  LatencyHistogram histogram;
+  for (std::uint64_t value = 64; value < (1ull << 27); value = value * 9 / 8) {
+    histogram.reset();
+    histogram.record(value);
+    histogram.record(2 * value);
+    std::uint64_t reported = histogram.getValueAtPercentile(50.0);
+    EXPECT_GE(reported, value);
+    EXPECT_LE(reported, value + value / 32) << "for " << value;
+  }
+}
+
+TEST(LatencyHistogram, percentilesOfAUniformDistribution) {
+  LatencyHistogram histogram;
+  for (std::uint64_t value = 1; value <= 100000; value++) {
+    histogram.record(value);
+  }
+  EXPECT_EQ(histogram.getCount(), 100000u);
+  EXPECT_DOUBLE_EQ(histogram.getMean(), 50000.5);
+  for (double percentile : {1.0, 25.0, 50.0, 90.0, 99.0, 99.9}) {
+    double exact = percentile * 1000.0;
+    double reported =
+        static_cast<double>(histogram.getValueAtPercentile(percentile));
+    EXPECT_GE(reported, exact) << "at " << percentile;
+    EXPECT_LE(reported, exact * (1.0 + 1.0 / 32.0)) << "at " << percentile;
+  }
+  EXPECT_EQ(histogram.getValueAtPercentile(0.0), 1u);
+  EXPECT_EQ(histogram.getValueAtPercentile(100.0), 100000u);
+}
+
+/** Values past the last bucket are counted there and still set the maximum,
+ * which the percentiles do not exceed.*/
+TEST(LatencyHistogram, valuesPastTheLastBucket) {
+  LatencyHistogram histogram;
+  const std::uint64_t huge = 10ull << 30;
+  histogram.record(huge);
+  histogram.record(huge + 1);
+  EXPECT_EQ(histogram.getMax(), huge + 1);
+  std::uint64_t median = histogram.getValueAtPercentile(50.0);
+  EXPECT_GE(median, (1ull << 27) - 1);
+  EXPECT_LE(median, huge + 1);
+  EXPECT_EQ(histogram.getValueAtPercentile(100.0), huge + 1);
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "control_log.h"
+
+using namespace tacbot;
+
+TEST(SpscRingBuffer, roundsTheCapacityUpToAPowerOfTwo) {
+  EXPECT_EQ(SpscRingBuffer<int>(1).capacity(), 1u);
+  EXPECT_EQ(SpscRingBuffer<int>(5).capacity(), 8u);
+  EXPECT_EQ(SpscRingBuffer<int>(8).capacity(), 8u);
+  EXPECT_EQ(SpscRingBuffer<int>(1000).capacity(), 1024u);
+}
+
+/** Full and empty are told apart on every lap around the storage, in
+ * particular where the indices wrap past the mask.*/
+TEST(SpscRingBuffer, fullAndEmptyAcrossWraps) {
+  SpscRingBuffer<int> buffer(4);
+  int item = -1;
+  EXPECT_FALSE(buffer.pop(item));
+
+  int next_push = 0;
+  int next_pop = 0;
+  for (int lap = 0; lap < 5; lap++) {
+    // fill up from a different offset in the storage each lap
+    while (buffer.push(next_push)) {
+      next_push++;
+    }
+    EXPECT_EQ(next_push - next_pop, 4);
+    EXPECT_FALSE(buffer.push(-1));
+
+    // drain one less than the capacity, so the next lap starts elsewhere
+    for (int i = 0; i < 3; i++) {
+      ASSERT_TRUE(buffer.pop(item));
+      EXPECT_EQ(item, next_pop++);
+    }
+  }
+  while (buffer.pop(item)) {
+    EXPECT_EQ(item, next_pop++);
+  }
+  EXPECT_EQ(next_pop, next_push);
+  EXPECT_FALSE(buffer.pop(item));
+}
+
+/** A producer and a consumer thread see every item once and in order.*/
+TEST(SpscRingBuffer, keepsTheOrderBetweenThreads) {
+  const int num_items = 200000;
+  SpscRingBuffer<int> buffer(64);
+  std::thread producer([&]() {
+    for (int i = 0; i < num_items; i++) {
+      while (!buffer.push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int expected = 0;
+  int item = -1;
+  bool in_order = true;
+  while (expected < num_items) {
+    if (buffer.pop(item)) {
+      in_order = in_order && item == expected;
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(in_order);
+  EXPECT_FALSE(buffer.pop(item));
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "trajectory_channel.h"
+
+using namespace tacbot;
+
+namespace {
+
+/** \brief A segment that moves every joint to the position, at rest.*/
+TrajectoryCommand makeSegment(double q, double dq, double duration) {
+  TrajectoryCommand command;
+  command.type = TrajectoryCommand::Type::APPEND;
+  command.duration = duration;
+  command.q.fill(q);
+  command.dq.fill(dq);
+  return command;
+}
+
+}  // namespace
+
+/** Segments that end within a cycle hand the rest of the cycle to the next
+ * segment, so a chain of them takes its planned time also when the cycles are
+ * late or missed.*/
+TEST(TrajectoryChannel, chainedSegmentsKeepTheirTime) {
+  const std::size_t num_segments = 100;
+  const double segment_duration = 0.0075;
+  const double speed = 0.2;
+
+  TrajectoryChannel::Options options;
+  options.capacity = 256;
+  options.max_commands_per_cycle = num_segments + 1;
+  TrajectoryChannel channel(options);
+  TrajectoryChannel::JointArray start{};
+  channel.reset(start);
+
+  // a constant velocity, so the commanded position is known at any time
+  for (std::size_t i = 1; i <= num_segments; i++) {
+    double q = speed * segment_duration * static_cast<double>(i);
+    double dq = i < num_segments ? speed : 0.0;
+    ASSERT_TRUE(channel.send(makeSegment(q, dq, segment_duration)));
+  }
+  TrajectoryCommand finish;
+  finish.type = TrajectoryCommand::Type::FINISH;
+  ASSERT_TRUE(channel.send(finish));
+
+  // 1 ms cycles that arrive up to 0.3 ms late, and every 20th cycle missed
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> jitter(0.0, 0.0003);
+  double time = 0.0;
+  double prev_time = 0.0;
+  std::size_t cycle = 0;
+  const double total = num_segments * segment_duration;
+  while (!channel.isFinished() && time < 2.0 * total) {
+    cycle++;
+    double period = 0.001 + jitter(rng) + (cycle % 20 == 0 ? 0.001 : 0.0);
+    prev_time = time;
+    time += period;
+    channel.update(period);
+
+    if (time > segment_duration && time < total - segment_duration) {
+      // past the start from rest the segments are joined at the velocity of
+      // the line, so the commanded position stays on it
+      EXPECT_NEAR(channel.getPosition()[0], speed * time, 1e-9)
+          << "at cycle " << cycle;
+    }
+  }
+
+  EXPECT_TRUE(channel.isFinished());
+  // finished in the cycle in which the planned time ran out
+  EXPECT_GE(time, total);
+  EXPECT_LT(prev_time, total);
+  EXPECT_NEAR(channel.getPosition()[0], speed * total, 1e-12);
+}
+
+/** The segment that brings the robot to rest starts where the last segment
+ * ended, within the cycle.*/
+TEST(TrajectoryChannel, stopsWhenTheQueueRunsDry) {
+  TrajectoryChannel::Options options;
+  options.stop_acceleration = 2.0;
+  TrajectoryChannel channel(options);
+  TrajectoryChannel::JointArray start{};
+  channel.reset(start);
+
+  ASSERT_TRUE(channel.send(makeSegment(0.01, 0.2, 0.05)));
+  double time = 0.0;
+  while (time < 1.0) {
+    time += 0.003;
+    channel.update(0.003);
+    if (channel.isIdle()) {
+      break;
+    }
+  }
+  EXPECT_TRUE(channel.isIdle());
+  // 0.05 s to the end of the segment, 0.2 / 2.0 s to come to rest
+  EXPECT_GE(time, 0.15 - 1e-9);
+  EXPECT_LT(time, 0.15 + 0.003);
+  // the stop covers half the distance the velocity would have
+  EXPECT_NEAR(channel.getPosition()[0], 0.01 + 0.5 * 0.1 * 0.2, 1e-12);
+}
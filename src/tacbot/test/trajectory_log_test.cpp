@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "trajectory_log.h"
+
+using namespace tacbot;
+
+namespace {
+
+std::string readFile(const std::string& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+TrajectoryLog makeLog(std::size_t num_samples) {
+  TrajectoryLog log;
+  for (std::size_t i = 0; i < num_samples; i++) {
+    TrajectoryLog::JointArray q, dq, ddq;
+    for (std::size_t jnt_idx = 0; jnt_idx < 7; jnt_idx++) {
+      q[jnt_idx] = 0.1 * static_cast<double>(i) + static_cast<double>(jnt_idx);
+      dq[jnt_idx] = -q[jnt_idx];
+      ddq[jnt_idx] = 0.5 * q[jnt_idx];
+    }
+    log.addSample(0.001 * static_cast<double>(i), q, dq, ddq);
+  }
+  return log;
+}
+
+}  // namespace
+
+/** The header is what numpy.load parses: magic and version 1.0, a little
+ * endian length, a dict padded with spaces to end in a newline at a
+ * multiple of 64 bytes, then the data.*/
+TEST(TrajectoryLog, npyHeader) {
+  const std::vector<double> values = {1.5, -2.0, 3.25, 0.0, 1e-300, 7.0};
+  for (const std::vector<std::size_t>& shape :
+       std::vector<std::vector<std::size_t>>{{6}, {2, 3}, {6, 1}}) {
+    std::string path = ::testing::TempDir() + "trajectory_log_test.npy";
+    ASSERT_TRUE(saveNpy(path, values.data(), shape));
+    std::string content = readFile(path);
+
+    ASSERT_GE(content.size(), 10u);
+    EXPECT_EQ(content.substr(0, 8), std::string("\x93NUMPY\x01\x00", 8));
+    std::size_t header_len = static_cast<unsigned char>(content[8]) |
+                             static_cast<unsigned char>(content[9]) << 8;
+    std::size_t data_start = 10 + header_len;
+    EXPECT_EQ(data_start % 64, 0u);
+    ASSERT_EQ(content.size(), data_start + values.size() * sizeof(double));
+
+    std::string header = content.substr(10, header_len);
+    EXPECT_EQ(header.back(), '\n');
+    std::string dict = header.substr(0, header.find_last_not_of(" \n") + 1);
+    std::string shape_str = shape.size() == 1
+                                ? "(6,)"
+                                : "(" + std::to_string(shape[0]) + ", " +
+                                      std::to_string(shape[1]) + ")";
+    EXPECT_EQ(dict, "{'descr': '<f8', 'fortran_order': False, 'shape': " +
+                        shape_str + ", }");
+
+    // the tests run on little endian hosts, where the data is as in memory
+    EXPECT_EQ(std::memcmp(content.data() + data_start, values.data(),
+                          values.size() * sizeof(double)),
+              0);
+  }
+}
+
+TEST(TrajectoryLog, npyInts) {
+  const std::vector<int> values = {1, -2, 3};
+  std::string path = ::testing::TempDir() + "trajectory_log_test_int.npy";
+  ASSERT_TRUE(saveNpy(path, values.data(), {3}));
+  std::string content = readFile(path);
+  EXPECT_NE(content.find("'descr': '<i4'"), std::string::npos);
+  EXPECT_EQ(content.size() % 64, 12u);
+}
+
+TEST(TrajectoryLog, saveAndLoad) {
+  TrajectoryLog log = makeLog(101);
+  std::string path = ::testing::TempDir() + "trajectory_log_test.bin";
+  ASSERT_TRUE(log.save(path));
+
+  // the columns start at multiples of eight bytes after the header
+  std::string content = readFile(path);
+  EXPECT_EQ(content.substr(0, 8), "TBTRAJ01");
+  EXPECT_EQ(content.size(), TrajectoryLog::HEADER_SIZE + 101 * 8 * 22);
+
+  TrajectoryLog loaded;
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_EQ(loaded.getTime(), log.getTime());
+  EXPECT_EQ(loaded.getPositions(), log.getPositions());
+  EXPECT_EQ(loaded.getVelocities(), log.getVelocities());
+  EXPECT_EQ(loaded.getAccelerations(), log.getAccelerations());
+
+  // an empty log round trips as well
+  ASSERT_TRUE(TrajectoryLog().save(path));
+  ASSERT_TRUE(loaded.load(path));
+  EXPECT_EQ(loaded.size(), 0u);
+}
+
+TEST(TrajectoryLog, loadRejectsOtherFiles) {
+  TrajectoryLog log = makeLog(10);
+  std::string path = ::testing::TempDir() + "trajectory_log_test.bin";
+  ASSERT_TRUE(log.save(path));
+  std::string content = readFile(path);
+
+  TrajectoryLog loaded;
+  EXPECT_FALSE(loaded.load(::testing::TempDir() + "does_not_exist.bin"));
+
+  std::string bad_path = ::testing::TempDir() + "trajectory_log_test_bad.bin";
+  std::string bad_magic = content;
+  bad_magic[0] = 'X';
+  std::ofstream(bad_path, std::ios::binary | std::ios::trunc) << bad_magic;
+  EXPECT_FALSE(loaded.load(bad_path));
+
+  std::string truncated = content.substr(0, content.size() - 8);
+  std::ofstream(bad_path, std::ios::binary | std::ios::trunc) << truncated;
+  EXPECT_FALSE(loaded.load(bad_path));
+}